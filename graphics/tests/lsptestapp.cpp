@@ -50,8 +50,8 @@ int main(int argc, char **argv)
     QString content = in.readAll();
     lsp.didOpen(document, 0, QString(), content);
 
-    auto ds_h = [&q](const std::list<LSPSymbolInformation> &syms) {
-        std::cout << "symbol count: " << syms.size() << std::endl;
+    auto ds_h = [&q](const LSPSymbolTable &syms) {
+        std::cout << "symbol count: " << syms.symbols.size() << std::endl;
         q.quit();
     };
     lsp.documentSymbols(document, &app, ds_h);
@@ -65,8 +65,8 @@ int main(int argc, char **argv)
     lsp.documentDefinition(document, {position[0].toInt(), position[1].toInt()}, &app, def_h);
     q.exec();
 
-    auto comp_h = [&q](const QList<LSPCompletionItem> &completions) {
-        std::cout << "completion count: " << completions.length() << std::endl;
+    auto comp_h = [&q](const LSPCompletionList &completions) {
+        std::cout << "completion count: " << completions.items.length() << std::endl;
         q.quit();
     };
     lsp.documentCompletion(document, {position[0].toInt(), position[1].toInt()}, &app, comp_h);
@@ -0,0 +1,323 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: MIT
+*/
+
+#include "callhierarchy.h"
+
+#include "lspclientservermanager.h"
+
+#include <KLocalizedString>
+
+#include <QCache>
+#include <QSet>
+
+#include <algorithm>
+#include <utility>
+
+using Direction = CallHierarchyModel::Direction;
+
+struct CallHierarchyModel::Node {
+    LSPCallHierarchyItem item;
+    // where the calls are made, see LSPCallHierarchyCall
+    QList<LSPRange> fromRanges;
+    Node *parent = nullptr;
+    int row = 0;
+    std::vector<std::unique_ptr<Node>> children;
+    enum class State {
+        Unfetched,
+        Fetching,
+        Fetched,
+    } state = State::Unfetched;
+    // an ancestor is the same item, expanding it would only repeat that
+    bool recursive = false;
+    LSPClientServer::RequestHandle handle;
+};
+
+static bool sameItem(const LSPCallHierarchyItem &a, const LSPCallHierarchyItem &b)
+{
+    return a.uri == b.uri && a.selectionRange == b.selectionRange && a.name == b.name;
+}
+
+// the calls of an item, as known to a server at some workspace revision
+struct EdgeKey {
+    const LSPClientServer *server = nullptr;
+    Direction direction = Direction::Incoming;
+    QUrl uri;
+    LSPPosition position;
+    QString name;
+    quint64 revision = 0;
+
+    bool operator==(const EdgeKey &other) const = default;
+};
+
+static size_t qHash(const EdgeKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.server, int(key.direction), key.uri, key.position.line(), key.position.column(), key.name, key.revision);
+}
+
+// shared by all trees, entries of older revisions simply age out
+static QCache<EdgeKey, QList<LSPCallHierarchyCall>> &edgeCache()
+{
+    static QCache<EdgeKey, QList<LSPCallHierarchyCall>> cache(512);
+    return cache;
+}
+
+CallHierarchyModel::CallHierarchyModel(std::shared_ptr<LSPClientServerManager> serverManager,
+                                       std::shared_ptr<LSPClientServer> server,
+                                       Direction direction,
+                                       const QList<LSPCallHierarchyItem> &roots,
+                                       QObject *parent)
+    : QAbstractItemModel(parent)
+    , m_serverManager(std::move(serverManager))
+    , m_server(std::move(server))
+    , m_direction(direction)
+    , m_root(std::make_unique<Node>())
+{
+    m_root->state = Node::State::Fetched;
+    for (const auto &item : roots) {
+        auto n = std::make_unique<Node>();
+        n->item = item;
+        n->parent = m_root.get();
+        n->row = int(m_root->children.size());
+        m_root->children.push_back(std::move(n));
+    }
+
+    // replies are dropped without a word when the server goes away
+    if (m_server) {
+        connect(m_server.get(), &LSPClientServer::stateChanged, this, [this](LSPClientServer *server) {
+            if (server->state() != LSPClientServer::State::Running) {
+                cancel();
+            }
+        });
+    }
+}
+
+CallHierarchyModel::~CallHierarchyModel()
+{
+    cancel();
+}
+
+void CallHierarchyModel::cancel()
+{
+    for (auto n : std::exchange(m_pending, {})) {
+        n->handle.cancel();
+        n->state = Node::State::Unfetched;
+    }
+}
+
+CallHierarchyModel::Node *CallHierarchyModel::node(const QModelIndex &index) const
+{
+    return index.isValid() ? static_cast<Node *>(index.internalPointer()) : m_root.get();
+}
+
+QModelIndex CallHierarchyModel::indexOf(Node *node) const
+{
+    return node == m_root.get() ? QModelIndex() : createIndex(node->row, 0, node);
+}
+
+QModelIndex CallHierarchyModel::index(int row, int column, const QModelIndex &parent) const
+{
+    auto p = node(parent);
+    if (column != 0 || row < 0 || size_t(row) >= p->children.size()) {
+        return {};
+    }
+    return createIndex(row, column, p->children[row].get());
+}
+
+QModelIndex CallHierarchyModel::parent(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return {};
+    }
+    return indexOf(node(index)->parent);
+}
+
+int CallHierarchyModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) {
+        return 0;
+    }
+    return int(node(parent)->children.size());
+}
+
+int CallHierarchyModel::columnCount(const QModelIndex &) const
+{
+    return 1;
+}
+
+bool CallHierarchyModel::hasChildren(const QModelIndex &parent) const
+{
+    auto n = node(parent);
+    if (n->recursive) {
+        return false;
+    }
+    // not known before it is expanded
+    return n->state != Node::State::Fetched || !n->children.empty();
+}
+
+bool CallHierarchyModel::canFetchMore(const QModelIndex &parent) const
+{
+    auto n = node(parent);
+    return n->state == Node::State::Unfetched && !n->recursive;
+}
+
+void CallHierarchyModel::fetchMore(const QModelIndex &parent)
+{
+    auto n = node(parent);
+    if (n->state != Node::State::Unfetched || n->recursive || !m_server || m_server->state() != LSPClientServer::State::Running) {
+        return;
+    }
+
+    // let the server see all of the current text, which is what the revision stands for
+    m_serverManager->sync(m_server.get());
+
+    const EdgeKey key{.server = m_server.get(),
+                      .direction = m_direction,
+                      .uri = n->item.uri,
+                      .position = n->item.selectionRange.start(),
+                      .name = n->item.name,
+                      .revision = m_serverManager->workspaceRevision()};
+    if (auto calls = edgeCache().object(key)) {
+        setCalls(n, *calls);
+        return;
+    }
+
+    auto h = [this, n, key](const QList<LSPCallHierarchyCall> &calls) {
+        std::erase(m_pending, n);
+        if (m_serverManager->workspaceRevision() == key.revision) {
+            edgeCache().insert(key, new QList<LSPCallHierarchyCall>(calls));
+        }
+        setCalls(n, calls);
+    };
+    auto eh = [this, n](const LSPResponseError &) {
+        std::erase(m_pending, n);
+        // expanding it again tries again
+        n->state = Node::State::Unfetched;
+    };
+    n->state = Node::State::Fetching;
+    m_pending.push_back(n);
+    if (m_direction == Direction::Incoming) {
+        n->handle = m_server->callHierarchyIncomingCalls(n->item, this, h, eh);
+    } else {
+        n->handle = m_server->callHierarchyOutgoingCalls(n->item, this, h, eh);
+    }
+}
+
+void CallHierarchyModel::setCalls(Node *node, const QList<LSPCallHierarchyCall> &calls)
+{
+    node->state = Node::State::Fetched;
+    const auto parent = indexOf(node);
+    if (calls.isEmpty()) {
+        // no longer expandable
+        Q_EMIT dataChanged(parent, parent);
+        return;
+    }
+
+    beginInsertRows(parent, 0, int(calls.size()) - 1);
+    node->children.reserve(calls.size());
+    for (const auto &call : calls) {
+        auto child = std::make_unique<Node>();
+        child->item = call.item;
+        child->fromRanges = call.fromRanges;
+        child->parent = node;
+        child->row = int(node->children.size());
+        for (auto n = node; n != m_root.get(); n = n->parent) {
+            if (sameItem(n->item, call.item)) {
+                child->recursive = true;
+                break;
+            }
+        }
+        node->children.push_back(std::move(child));
+    }
+    endInsertRows();
+}
+
+QVariant CallHierarchyModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return {};
+    }
+
+    const auto n = node(index);
+    const auto &item = n->item;
+    switch (role) {
+    case Qt::DisplayRole:
+        return QStringLiteral("%1  %2:%3").arg(item.name, item.uri.fileName()).arg(item.selectionRange.start().line() + 1);
+    case Qt::ToolTipRole: {
+        QString tip = item.detail.isEmpty() ? item.name : item.detail;
+        tip += QLatin1Char('\n') + item.uri.toDisplayString(QUrl::PreferLocalFile);
+        if (!n->fromRanges.isEmpty()) {
+            tip += QLatin1Char('\n') + i18np("%1 call", "%1 calls", n->fromRanges.size());
+        }
+        if (n->recursive) {
+            tip += QLatin1Char('\n') + i18n("Recursive call");
+        }
+        return tip;
+    }
+    case FileUrlRole:
+        return item.uri;
+    case RangeRole:
+        // the call sites of incoming calls are in the caller, so show where it calls
+        if (m_direction == Direction::Incoming && !n->fromRanges.isEmpty()) {
+            return QVariant::fromValue(n->fromRanges.front());
+        }
+        return QVariant::fromValue(item.selectionRange);
+    }
+    return {};
+}
+
+static QString dotString(QString s)
+{
+    s.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+    s.replace(QLatin1Char('"'), QLatin1String("\\\""));
+    return QLatin1Char('"') + s + QLatin1Char('"');
+}
+
+static QString dotId(const LSPCallHierarchyItem &item)
+{
+    const auto pos = item.selectionRange.start();
+    return dotString(QStringLiteral("%1#%2:%3").arg(item.uri.toString()).arg(pos.line()).arg(pos.column()));
+}
+
+QString CallHierarchyModel::toDot() const
+{
+    QString nodes;
+    QString edges;
+    QSet<QString> seenNodes;
+    QSet<QString> seenEdges;
+
+    std::vector<const Node *> todo;
+    for (const auto &child : m_root->children) {
+        todo.push_back(child.get());
+    }
+    while (!todo.empty()) {
+        const auto n = todo.back();
+        todo.pop_back();
+
+        const auto id = dotId(n->item);
+        if (!seenNodes.contains(id)) {
+            seenNodes.insert(id);
+            const auto label = QStringLiteral("%1\n%2:%3").arg(n->item.name, n->item.uri.fileName()).arg(n->item.selectionRange.start().line() + 1);
+            nodes += QStringLiteral("    %1 [label=%2];\n").arg(id, dotString(label));
+        }
+        if (n->parent != m_root.get()) {
+            const auto parentId = dotId(n->parent->item);
+            // edges point from caller to callee
+            auto edge = m_direction == Direction::Incoming ? QStringLiteral("    %1 -> %2;\n").arg(id, parentId) : QStringLiteral("    %1 -> %2;\n").arg(parentId, id);
+            if (!seenEdges.contains(edge)) {
+                seenEdges.insert(edge);
+                edges += edge;
+            }
+        }
+        // keep the order of the tree
+        for (auto it = n->children.rbegin(); it != n->children.rend(); ++it) {
+            todo.push_back(it->get());
+        }
+    }
+
+    return QStringLiteral("digraph calls {\n    node [shape=box];\n") + nodes + edges + QStringLiteral("}\n");
+}
+
+#include "moc_callhierarchy.cpp"
@@ -0,0 +1,82 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include "lspclientprotocol.h"
+#include "lspclientserver.h"
+
+#include <QAbstractItemModel>
+
+#include <memory>
+#include <vector>
+
+class LSPClientServerManager;
+
+/**
+ * Callers or callees of the symbols found by prepareCallHierarchy, as a tree.
+ *
+ * A node only asks the server for the next level once it is expanded. Replies are
+ * kept per item and workspace revision, so expanding the same function again, in
+ * this tree or a later one, does not ask again until some document changed.
+ */
+class CallHierarchyModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum class Direction {
+        Incoming,
+        Outgoing,
+    };
+
+    enum Role {
+        // same values as the roles of the location trees, so clicking navigates the same way
+        FileUrlRole = Qt::UserRole + 1,
+        RangeRole,
+    };
+
+    CallHierarchyModel(std::shared_ptr<LSPClientServerManager> serverManager,
+                       std::shared_ptr<LSPClientServer> server,
+                       Direction direction,
+                       const QList<LSPCallHierarchyItem> &roots,
+                       QObject *parent = nullptr);
+    ~CallHierarchyModel() override;
+
+    Direction direction() const
+    {
+        return m_direction;
+    }
+
+    // drop all pending requests, the nodes can be expanded again later on
+    void cancel();
+
+    // the calls expanded so far, in Graphviz format
+    QString toDot() const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = {}) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = {}) const override;
+    int columnCount(const QModelIndex &parent = {}) const override;
+    bool hasChildren(const QModelIndex &parent = {}) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    struct Node;
+
+    Node *node(const QModelIndex &index) const;
+    QModelIndex indexOf(Node *node) const;
+    void setCalls(Node *node, const QList<LSPCallHierarchyCall> &calls);
+
+    std::shared_ptr<LSPClientServerManager> m_serverManager;
+    std::shared_ptr<LSPClientServer> m_server;
+    Direction m_direction;
+    // invisible root, its children are the prepared items
+    std::unique_ptr<Node> m_root;
+    std::vector<Node *> m_pending;
+};
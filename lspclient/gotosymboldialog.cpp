@@ -4,7 +4,9 @@
     SPDX-License-Identifier: LGPL-2.0-or-later
 */
 #include "gotosymboldialog.h"
+#include "fuzzyscorer.h"
 #include "lspclientserver.h"
+#include "workspacesymbolindex.h"
 
 #include <KLocalizedString>
 #include <KSyntaxHighlighting/Theme>
@@ -14,6 +16,7 @@
 
 #include <QFileInfo>
 #include <QPainter>
+#include <QSet>
 #include <QStandardItemModel>
 #include <QStyledItemDelegate>
 
@@ -23,6 +26,8 @@
 //#include <ktexteditor_utils.h>
 
 static constexpr int SymbolInfoRole = Qt::UserRole + 1;
+// more is of no use in a popup, and costly for a big workspace
+static constexpr int MaxSymbols = 1000;
 
 struct GotoSymbolItem {
     QUrl fileUrl;
@@ -150,11 +155,14 @@ private:
     QFont monoFont;
 };
 
-GotoSymbolHUDDialog::GotoSymbolHUDDialog(KTextEditor::MainWindow *mainWindow, std::shared_ptr<LSPClientServer> server)
+GotoSymbolHUDDialog::GotoSymbolHUDDialog(KTextEditor::MainWindow *mainWindow,
+                                         std::shared_ptr<LSPClientServer> server,
+                                         std::shared_ptr<WorkspaceSymbolIndex> symbolIndex)
     : HUDDialog(mainWindow->window())
     , model(new QStandardItemModel(this))
     , mainWindow(mainWindow)
     , server(std::move(server))
+    , symbolIndex(std::move(symbolIndex))
 {
     m_lineEdit.setPlaceholderText(i18n("Filter…"));
 
@@ -237,18 +245,73 @@ void GotoSymbolHUDDialog::slotTextChanged(const QString &text)
      *
      * Also, at least 2 characters must be there to start getting symbols from the server
      */
-    if (!server || text.isEmpty() || text.length() < 2) {
+    if (text.isEmpty() || text.length() < 2) {
         return;
     }
 
-    auto hh = [this](const std::vector<LSPSymbolInformation> &symbols) {
-        model->clear();
-        for (const auto &sym : symbols) {
-            auto item = new QStandardItem(iconForSymbolKind(sym.kind), sym.name);
-            item->setData(QVariant::fromValue(GotoSymbolItem{.fileUrl = sym.url, .pos = sym.range.start(), .kind = sym.kind}), SymbolInfoRole);
-            model->appendRow(item);
+    // the local index answers from a few more characters on
+    const bool local = symbolIndex && text.length() >= WorkspaceSymbolIndex::MinPatternLength;
+    localSymbols = local ? symbolIndex->find(text, MaxSymbols) : LSPSymbolTable();
+    if (local) {
+        showSymbols(text, localSymbols, {});
+    }
+
+    if (!server) {
+        return;
+    }
+    auto hh = [this, text](const LSPSymbolTable &table) {
+        // never mind if typed on since
+        if (text == m_lineEdit.text()) {
+            showSymbols(text, localSymbols, table);
         }
-        m_treeView.setCurrentIndex(model->index(0, 0));
     };
     server->workspaceSymbol(text, this, hh);
 }
+
+void GotoSymbolHUDDialog::showSymbols(const QString &text, const LSPSymbolTable &local, const LSPSymbolTable &remote)
+{
+    // server symbols first, they have more context, e.g. the container in the name
+    struct Entry {
+        const LSPSymbolTable *table;
+        const LSPSymbolTable::Symbol *symbol;
+    };
+    std::vector<Entry> entries;
+    QStringList names;
+    QSet<std::pair<QUrl, int>> seen;
+    for (const auto *table : {&remote, &local}) {
+        for (const auto &sym : table->roots()) {
+            if (!seen.contains({table->url(sym), sym.range.start().line()})) {
+                seen.insert({table->url(sym), sym.range.start().line()});
+                entries.push_back({table, &sym});
+                names.push_back(table->name(sym));
+            }
+        }
+    }
+
+    // servers return symbols in no particular order, best matches first,
+    // then whatever else the server considered a match
+    std::vector<int> order;
+    std::vector<bool> added(entries.size(), false);
+    for (const auto &m : FuzzyScorer::topMatches(text, names, MaxSymbols)) {
+        order.push_back(m.index);
+        added[m.index] = true;
+    }
+    for (size_t i = 0; i < entries.size() && order.size() < size_t(MaxSymbols); ++i) {
+        if (!added[i]) {
+            order.push_back(int(i));
+        }
+    }
+
+    QList<QStandardItem *> items;
+    items.reserve(order.size());
+    for (int i : order) {
+        const auto &table = *entries[i].table;
+        const auto &sym = *entries[i].symbol;
+        auto item = new QStandardItem(iconForSymbolKind(sym.kind), table.name(sym));
+        item->setData(QVariant::fromValue(GotoSymbolItem{.fileUrl = table.url(sym), .pos = sym.range.start(), .kind = sym.kind}), SymbolInfoRole);
+        items.push_back(item);
+    }
+    model->clear();
+    model->invisibleRootItem()->appendRows(items);
+    m_treeView.setCurrentIndex(model->index(0, 0));
+}
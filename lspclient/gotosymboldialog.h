@@ -11,6 +11,7 @@
 
 class QStandardItemModel;
 class LSPClientServer;
+class WorkspaceSymbolIndex;
 
 namespace KTextEditor
 {
@@ -20,19 +21,23 @@ class MainWindow;
 class GotoSymbolHUDDialog : public HUDDialog
 {
 public:
-    GotoSymbolHUDDialog(KTextEditor::MainWindow *mainWindow, std::shared_ptr<LSPClientServer> server);
+    GotoSymbolHUDDialog(KTextEditor::MainWindow *mainWindow, std::shared_ptr<LSPClientServer> server, std::shared_ptr<WorkspaceSymbolIndex> symbolIndex);
 
 protected Q_SLOTS:
     void slotReturnPressed(const QModelIndex &index) override final;
 
 private:
     void slotTextChanged(const QString &text);
+    void showSymbols(const QString &text, const LSPSymbolTable &local, const LSPSymbolTable &remote);
     QIcon iconForSymbolKind(LSPSymbolKind kind) const;
     void setPaletteToEditorColors();
 
     QStandardItemModel *model = nullptr;
     KTextEditor::MainWindow *mainWindow;
     std::shared_ptr<LSPClientServer> server;
+    // answers right away, the server results are merged in when they arrive
+    std::shared_ptr<WorkspaceSymbolIndex> symbolIndex;
+    LSPSymbolTable localSymbols;
 
     const QIcon m_icon_pkg = QIcon::fromTheme(QStringLiteral("code-block"));
     const QIcon m_icon_class = QIcon::fromTheme(QStringLiteral("code-class"));
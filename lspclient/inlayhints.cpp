@@ -4,65 +4,291 @@
 */
 #include "inlayhints.h"
 
+#include "ktexteditor_utils.h"
 #include "lspclientservermanager.h"
-//#include <ktexteditor_utils.h>
 
 #include <KSyntaxHighlighting/Theme>
 #include <KTextEditor/Document>
+#include <KTextEditor/Editor>
 #include <KTextEditor/InlineNote>
 
 #include <QApplication>
 #include <QPainter>
-#include <QSet>
+
+#include <climits>
 
 static constexpr int textChangedDelay = 1000; // 1s
+static constexpr int scrollDelay = 50;
+static constexpr int prefetchDelay = 500;
+
+static constexpr size_t maxPendingShifts = 16;
 
-static size_t qHash(const LSPInlayHint &s, size_t seed = 0)
+static auto findHint(const InlayHintIndex &index, KTextEditor::Cursor pos)
 {
-    return qHashMulti(seed, s.position, s.label);
+    const LSPInlayHint *ret = nullptr;
+    if (auto hints = index.hintsOnLine(pos.line())) {
+        auto it = std::lower_bound(hints->begin(), hints->end(), pos.column(), [](const LSPInlayHint &h, int c) {
+            return h.position.column() < c;
+        });
+        if (it != hints->end() && it->position.column() == pos.column()) {
+            ret = &*it;
+        }
+    }
+    return ret;
 }
 
-[[maybe_unused]] static bool operator==(const LSPInlayHint &l, const LSPInlayHint &r)
+/**
+ * Helpers for the sorted, disjoint line ranges of covered lines
+ */
+static void addCoveredLines(std::vector<KTextEditor::LineRange> &covered, KTextEditor::LineRange lines)
 {
-    return l.position == r.position && l.label == r.label;
+    std::vector<KTextEditor::LineRange> ret;
+    ret.reserve(covered.size() + 1);
+    bool inserted = false;
+    for (const auto &r : covered) {
+        if (r.end() + 1 < lines.start()) {
+            ret.push_back(r);
+        } else if (lines.end() + 1 < r.start()) {
+            if (!inserted) {
+                ret.push_back(lines);
+                inserted = true;
+            }
+            ret.push_back(r);
+        } else {
+            // overlapping or adjacent, merge
+            lines = KTextEditor::LineRange(std::min(r.start(), lines.start()), std::max(r.end(), lines.end()));
+        }
+    }
+    if (!inserted) {
+        ret.push_back(lines);
+    }
+    covered = std::move(ret);
 }
 
-template<typename T>
-static auto binaryFind(T &&hints, int line)
+static void removeCoveredLines(std::vector<KTextEditor::LineRange> &covered, KTextEditor::LineRange lines)
 {
-    auto it = std::lower_bound(hints.begin(), hints.end(), line, [](const LSPInlayHint &h, int l) {
-        return h.position.line() < l;
-    });
-    if (it != hints.end() && it->position.line() == line) {
-        return it;
+    std::vector<KTextEditor::LineRange> ret;
+    ret.reserve(covered.size() + 1);
+    for (const auto &r : covered) {
+        if (r.end() < lines.start() || r.start() > lines.end()) {
+            ret.push_back(r);
+            continue;
+        }
+        if (r.start() < lines.start()) {
+            ret.emplace_back(r.start(), lines.start() - 1);
+        }
+        if (r.end() > lines.end()) {
+            ret.emplace_back(lines.end() + 1, r.end());
+        }
     }
-    return hints.end();
+    covered = std::move(ret);
 }
 
-static auto binaryFind(const std::vector<LSPInlayHint> &hints, KTextEditor::Cursor pos)
+static void shiftCoveredLines(std::vector<KTextEditor::LineRange> &covered, int fromLine, int delta)
 {
-    auto it = std::lower_bound(hints.begin(), hints.end(), pos, [](const LSPInlayHint &h, KTextEditor::Cursor p) {
-        return h.position < p;
-    });
-    if (it != hints.end() && it->position == pos) {
-        return it;
+    std::vector<KTextEditor::LineRange> ret;
+    ret.reserve(covered.size());
+    for (const auto &r : covered) {
+        const int start = r.start() >= fromLine ? r.start() + delta : r.start();
+        const int end = r.end() >= fromLine ? r.end() + delta : r.end();
+        if (start <= end) {
+            ret.emplace_back(start, end);
+        }
+    }
+    covered = std::move(ret);
+}
+
+// the parts of @p lines not in @p covered
+static std::vector<KTextEditor::LineRange> uncoveredLines(const std::vector<KTextEditor::LineRange> &covered, KTextEditor::LineRange lines)
+{
+    std::vector<KTextEditor::LineRange> ret;
+    int start = lines.start();
+    for (const auto &r : covered) {
+        if (r.end() < start) {
+            continue;
+        }
+        if (r.start() > lines.end()) {
+            break;
+        }
+        if (r.start() > start) {
+            ret.emplace_back(start, r.start() - 1);
+        }
+        start = r.end() + 1;
+    }
+    if (start <= lines.end()) {
+        ret.emplace_back(start, lines.end());
     }
-    return hints.end();
+    return ret;
+}
+
+static bool byColumn(const LSPInlayHint &l, const LSPInlayHint &r)
+{
+    return l.position.column() < r.position.column();
+}
+
+int InlayHintIndex::lineOf(size_t bucket) const
+{
+    int line = m_buckets[bucket].line;
+    for (const auto &shift : m_pendingShifts) {
+        if (shift.from <= bucket) {
+            line += shift.delta;
+        }
+    }
+    return line;
+}
+
+size_t InlayHintIndex::lowerBound(int line) const
+{
+    size_t lo = 0;
+    size_t hi = m_buckets.size();
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (lineOf(mid) < line) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+const std::vector<LSPInlayHint> *InlayHintIndex::hintsOnLine(int line) const
+{
+    // unwrapping can leave an empty bucket on the same line as a shifted one
+    for (size_t i = lowerBound(line); i < m_buckets.size() && lineOf(i) == line; ++i) {
+        if (!m_buckets[i].hints.empty()) {
+            return &m_buckets[i].hints;
+        }
+    }
+    return nullptr;
 }
 
-static void removeInvalidRanges(std::vector<LSPInlayHint> &hints, std::vector<LSPInlayHint>::iterator begin, std::vector<LSPInlayHint>::iterator end)
+std::vector<LSPInlayHint> *InlayHintIndex::hintsOnLine(int line)
 {
-    hints.erase(std::remove_if(begin,
-                               end,
-                               [](const LSPInlayHint &h) {
-                                   return !h.position.isValid();
-                               }),
-                end);
+    return const_cast<std::vector<LSPInlayHint> *>(std::as_const(*this).hintsOnLine(line));
+}
+
+void InlayHintIndex::shiftLines(int fromLine, int delta)
+{
+    const size_t from = lowerBound(fromLine);
+    if (from == m_buckets.size() || delta == 0) {
+        return;
+    }
+    m_pendingShifts.push_back({from, delta});
+    if (m_pendingShifts.size() > maxPendingShifts) {
+        applyShifts();
+    }
+}
+
+void InlayHintIndex::applyShifts()
+{
+    if (m_pendingShifts.empty()) {
+        return;
+    }
+
+    std::vector<int> deltas(m_buckets.size(), 0);
+    for (const auto &shift : m_pendingShifts) {
+        deltas[shift.from] += shift.delta;
+    }
+    m_pendingShifts.clear();
+
+    int delta = 0;
+    for (size_t i = 0; i < m_buckets.size(); ++i) {
+        delta += deltas[i];
+        m_buckets[i].line += delta;
+    }
+
+    std::erase_if(m_buckets, [](const Bucket &b) {
+        return b.hints.empty();
+    });
+}
+
+QVarLengthArray<int, 16> InlayHintIndex::replace(KTextEditor::Range range, std::vector<LSPInlayHint> newHints)
+{
+    applyShifts();
+
+    if (!std::is_sorted(newHints.begin(), newHints.end(), [](const LSPInlayHint &l, const LSPInlayHint &r) {
+            return l.position < r.position;
+        })) {
+        std::sort(newHints.begin(), newHints.end(), [](const LSPInlayHint &l, const LSPInlayHint &r) {
+            return l.position < r.position;
+        });
+    }
+
+    const bool wholeDoc = !range.isValid();
+    const size_t first = wholeDoc ? 0 : lowerBound(range.start().line());
+    const size_t last = wholeDoc ? m_buckets.size() : lowerBound(range.end().line() + 1);
+    auto inRange = [range, wholeDoc](int line, const LSPInlayHint &h) {
+        return wholeDoc || range.contains(KTextEditor::Cursor(line, h.position.column()));
+    };
+
+    QVarLengthArray<int, 16> changedLines;
+    std::vector<Bucket> buckets;
+    size_t b = first;
+    auto newIt = newHints.begin();
+    while (b < last || newIt != newHints.end()) {
+        const int line = std::min(b < last ? m_buckets[b].line : INT_MAX, newIt != newHints.end() ? newIt->position.line() : INT_MAX);
+        const std::vector<LSPInlayHint> *old = b < last && m_buckets[b].line == line ? &m_buckets[b].hints : nullptr;
+        auto newEnd = std::find_if(newIt, newHints.end(), [line](const LSPInlayHint &h) {
+            return h.position.line() != line;
+        });
+
+        Bucket bucket{line, {}};
+        size_t oldInRange = 0;
+        if (old) {
+            for (const auto &h : *old) {
+                if (inRange(line, h)) {
+                    ++oldInRange;
+                } else {
+                    bucket.hints.push_back(h);
+                }
+            }
+        }
+
+        bool changed = false;
+        size_t reused = 0;
+        for (; newIt != newEnd; ++newIt) {
+            const LSPInlayHint *oldHint = nullptr;
+            if (old) {
+                auto it = std::find_if(old->begin(), old->end(), [&newIt](const LSPInlayHint &h) {
+                    return h.position.column() == newIt->position.column() && h.label == newIt->label;
+                });
+                if (it != old->end()) {
+                    oldHint = &*it;
+                }
+            }
+            if (oldHint) {
+                // unchanged
+                bucket.hints.push_back(*oldHint);
+                ++reused;
+            } else {
+                bucket.hints.push_back(std::move(*newIt));
+                changed = true;
+            }
+        }
+        changed = changed || reused != oldInRange;
+
+        std::sort(bucket.hints.begin(), bucket.hints.end(), byColumn);
+        if (changed) {
+            changedLines.push_back(line);
+        }
+        if (!bucket.hints.empty()) {
+            buckets.push_back(std::move(bucket));
+        }
+        if (old) {
+            ++b;
+        }
+    }
+
+    m_buckets.erase(m_buckets.begin() + first, m_buckets.begin() + last);
+    m_buckets.insert(m_buckets.begin() + first, std::make_move_iterator(buckets.begin()), std::make_move_iterator(buckets.end()));
+    return changedLines;
 }
 
 InlayHintNoteProvider::InlayHintNoteProvider(InlayHintsManager *mgr)
     : m_mgr(mgr)
 {
+    invalidateCache();
 }
 
 void InlayHintNoteProvider::viewChanged(KTextEditor::View *v)
@@ -73,9 +299,38 @@ void InlayHintNoteProvider::viewChanged(KTextEditor::View *v)
         m_noteBgColor.setAlphaF(0.1f);
         m_noteColor.setAlphaF(0.5f);
     }
+    invalidateCache();
 }
 
-const std::vector<LSPInlayHint> &InlayHintNoteProvider::hints() const
+void InlayHintNoteProvider::invalidateCache()
+{
+    m_font = qApp->font();
+    m_fontHeight = QFontMetricsF(m_font).height();
+    m_noteCache.clear();
+}
+
+const InlayHintNoteProvider::CachedNote &InlayHintNoteProvider::cachedNote(const QString &label) const
+{
+    auto it = m_noteCache.constFind(label);
+    if (it != m_noteCache.cend()) {
+        return *it;
+    }
+
+    // labels are mostly types and parameter names, this only grows large for huge projects
+    if (m_noteCache.size() > 4096) {
+        m_noteCache.clear();
+    }
+
+    CachedNote note;
+    note.width = QFontMetrics(m_font).horizontalAdvance(label);
+    note.text.setText(label);
+    note.text.setTextFormat(Qt::PlainText);
+    note.text.setPerformanceHint(QStaticText::AggressiveCaching);
+    note.text.prepare(QTransform(), m_font);
+    return *m_noteCache.insert(label, std::move(note));
+}
+
+const InlayHintIndex &InlayHintNoteProvider::hints() const
 {
     return m_mgr->hintsForActiveView();
 }
@@ -83,60 +338,50 @@ const std::vector<LSPInlayHint> &InlayHintNoteProvider::hints() const
 QList<int> InlayHintNoteProvider::inlineNotes(int line) const
 {
     QList<int> ret;
-    const auto &hints = this->hints();
-    auto it = binaryFind(hints, line);
-    while (it != hints.cend() && it->position.line() == line) {
-        ret.push_back(it->position.column());
-        ++it;
+    if (auto hints = this->hints().hintsOnLine(line)) {
+        ret.reserve(hints->size());
+        for (const auto &hint : *hints) {
+            ret.push_back(hint.position.column());
+        }
     }
     return ret;
 }
 
 QSize InlayHintNoteProvider::inlineNoteSize(const KTextEditor::InlineNote &note) const
 {
-    const auto &hints = this->hints();
-    auto it = binaryFind(hints, note.position());
-    if (it == hints.end()) {
+    auto it = findHint(hints(), note.position());
+    if (!it) {
         qWarning() << Q_FUNC_INFO << note.view()->document()->documentName() << "failed to find note in m_hints, Note.position:" << note.position();
         return {};
     }
 
-    const LSPInlayHint &hint = *it;
-    const int padding = (hint.paddingLeft || hint.paddingRight) ? 4 : 0;
-    if (hint.width == 0) {
-        const auto font = qApp->font();
-        const auto fm = QFontMetrics(font);
-        const_cast<LSPInlayHint &>(hint).width = fm.horizontalAdvance(hint.label) + padding;
-    }
-    return {hint.width, note.lineHeight()};
+    const int padding = (it->paddingLeft || it->paddingRight) ? 4 : 0;
+    return {cachedNote(it->label).width + padding, note.lineHeight()};
 }
 
 void InlayHintNoteProvider::paintInlineNote(const KTextEditor::InlineNote &note, QPainter &painter, Qt::LayoutDirection) const
 {
-    const auto &hints = this->hints();
-    auto it = binaryFind(hints, note.position());
-    if (it != hints.end()) {
-        const auto font = qApp->font();
-        painter.setFont(font);
-        QRectF r{0., 0., (qreal)it->width, (qreal)note.lineHeight()};
+    auto it = findHint(hints(), note.position());
+    if (it) {
+        const auto &cached = cachedNote(it->label);
+        const int padding = (it->paddingLeft || it->paddingRight) ? 4 : 0;
+        painter.setFont(m_font);
+        QRectF r{0., 0., (qreal)(cached.width + padding), (qreal)note.lineHeight()};
 
         // draw background rectangle
         painter.setRenderHint(QPainter::Antialiasing);
         painter.setBrush(m_noteBgColor);
         painter.setPen(Qt::NoPen);
         auto bgRect = r;
-        bgRect.setHeight(QFontMetricsF(font).height());
+        bgRect.setHeight(m_fontHeight);
         bgRect.moveTop((r.height() - bgRect.height()) / 2.);
         painter.drawRoundedRect(bgRect, 3., 3.);
 
-        // draw the hint
+        // draw the prepared hint text
         painter.setPen(m_noteColor);
-        if (it->paddingLeft) {
-            r.adjust(4., 0., 0., 0.);
-        } else if (it->paddingRight) {
-            r.adjust(0., 0., -4., 0.);
-        }
-        painter.drawText(r, Qt::AlignLeft | Qt::AlignVCenter, it->label);
+        const qreal x = it->paddingLeft ? 4. : 0.;
+        const qreal y = (r.height() - cached.text.size().height()) / 2.;
+        painter.drawStaticText(QPointF(x, y), cached.text);
     }
 }
 
@@ -147,6 +392,18 @@ InlayHintsManager::InlayHintsManager(const std::shared_ptr<LSPClientServerManage
 {
     m_requestTimer.setSingleShot(true);
     m_requestTimer.callOnTimeout(this, &InlayHintsManager::sendPendingRequests);
+    m_prefetchTimer.setSingleShot(true);
+    m_prefetchTimer.callOnTimeout(this, &InlayHintsManager::prefetch);
+
+    // cached note sizes and renderings depend on font and theme
+    connect(qApp, &QGuiApplication::fontChanged, this, [this] {
+        m_noteProvider.invalidateCache();
+        m_noteProvider.inlineNotesReset();
+    });
+    connect(KTextEditor::Editor::instance(), &KTextEditor::Editor::configChanged, this, [this] {
+        m_noteProvider.viewChanged(m_currentView);
+        m_noteProvider.inlineNotesReset();
+    });
 }
 
 InlayHintsManager::~InlayHintsManager()
@@ -169,23 +426,22 @@ void InlayHintsManager::registerView(KTextEditor::View *v)
         connect(d, &Document::textRemoved, this, &InlayHintsManager::onTextRemoved, Qt::UniqueConnection);
         connect(d, &Document::lineWrapped, this, &InlayHintsManager::onWrapped, Qt::UniqueConnection);
         connect(d, &Document::lineUnwrapped, this, &InlayHintsManager::onUnwrapped, Qt::UniqueConnection);
+        connect(v, &View::verticalScrollPositionChanged, this, &InlayHintsManager::onDisplayRangeChanged, Qt::UniqueConnection);
 
-        auto it = std::find_if(m_hintDataByDoc.begin(), m_hintDataByDoc.end(), [doc = v->document()](const HintData &hd) {
-            return hd.doc == doc;
-        });
+        auto hd = hintDataForDoc(d);
 
         // If the document was found and checksum hasn't changed
-        if (it != m_hintDataByDoc.end() && it->checksum == d->checksum() && !it->m_hints.empty() && !reloaded) {
+        if (hd && hd->checksum == d->checksum() && !hd->m_hints.empty() && !reloaded) {
             m_noteProvider.inlineNotesReset();
         } else {
-            if (it != m_hintDataByDoc.end()) {
-                m_hintDataByDoc.erase(it);
+            if (hd) {
+                m_hintDataByDoc.erase(d);
             }
             // clear hints from the inline note provider and reset it
             m_noteProvider.inlineNotesReset();
-            // Send delayed request for inlay hints
-            sendRequestDelayed(v->document()->documentRange(), 1);
         }
+        // Send delayed request for the visible lines, covered lines are skipped
+        sendRequestDelayed(Utils::getVisibleRange(v), 1);
     }
 
     clearHintsForDoc(nullptr);
@@ -196,14 +452,15 @@ void InlayHintsManager::unregisterView(KTextEditor::View *v)
     if (v) {
         v->disconnect(this);
         v->document()->disconnect(this);
+        cancelRequests();
+        pendingRanges.clear();
+        m_requestTimer.stop();
+        m_prefetchTimer.stop();
         m_currentView->unregisterInlineNoteProvider(&m_noteProvider);
-        auto it = std::find_if(m_hintDataByDoc.begin(), m_hintDataByDoc.end(), [doc = v->document()](const HintData &hd) {
-            return hd.doc == doc;
-        });
         // update checksum
         // we use it to check if doc was changed when restoring hints
-        if (it != m_hintDataByDoc.end()) {
-            it->checksum = v->document()->checksum();
+        if (auto hd = hintDataForDoc(v->document())) {
+            hd->checksum = v->document()->checksum();
         }
     }
     m_noteProvider.viewChanged(nullptr);
@@ -221,18 +478,29 @@ void InlayHintsManager::disable()
     m_currentView.clear();
 }
 
-const std::vector<LSPInlayHint> &InlayHintsManager::hintsForActiveView()
+InlayHintsManager::HintData *InlayHintsManager::hintDataForDoc(KTextEditor::Document *doc)
+{
+    auto it = m_hintDataByDoc.find(doc);
+    if (it == m_hintDataByDoc.end()) {
+        return nullptr;
+    }
+    if (!it->second.doc) {
+        // stale entry, doc was deleted and the address reused
+        m_hintDataByDoc.erase(it);
+        return nullptr;
+    }
+    return &it->second;
+}
+
+const InlayHintIndex &InlayHintsManager::hintsForActiveView()
 {
     if (auto v = m_currentView) {
-        auto doc = v->document();
-        for (const auto &e : m_hintDataByDoc) {
-            if (e.doc == doc) {
-                return e.m_hints;
-            }
+        if (auto hd = hintDataForDoc(v->document())) {
+            return hd->m_hints;
         }
     }
 
-    return m_emptyHintsArray;
+    return m_emptyHints;
 }
 
 void InlayHintsManager::sendRequestDelayed(KTextEditor::Range r, int delay)
@@ -251,18 +519,42 @@ void InlayHintsManager::sendRequestDelayed(KTextEditor::Range r, int delay)
 
 void InlayHintsManager::sendPendingRequests()
 {
-    if (pendingRanges.empty()) {
+    if (pendingRanges.empty() || !m_currentView) {
         return;
     }
 
-    KTextEditor::Range rangeToRequest = pendingRanges.first();
-    for (auto r : std::as_const(pendingRanges)) {
-        rangeToRequest.expandToRange(r);
+    // merge overlapping or adjacent ranges
+    std::vector<KTextEditor::LineRange> lines;
+    lines.reserve(pendingRanges.size());
+    for (const auto &r : std::as_const(pendingRanges)) {
+        if (r.isValid()) {
+            lines.emplace_back(r.start().line(), r.end().line());
+        }
     }
     pendingRanges.clear();
 
-    if (rangeToRequest.isValid()) {
-        sendRequest(rangeToRequest);
+    // lines we have up to date hints for or that are already requested don't need to be requested again
+    std::vector<KTextEditor::LineRange> skip;
+    if (auto hd = hintDataForDoc(m_currentView->document())) {
+        skip = hd->m_coveredLines;
+    }
+    for (const auto &req : m_inflightRequests) {
+        addCoveredLines(skip, req.lines);
+    }
+
+    std::vector<KTextEditor::LineRange> toRequest;
+    for (const auto &l : lines) {
+        for (const auto &uncovered : uncoveredLines(skip, l)) {
+            addCoveredLines(toRequest, uncovered);
+        }
+    }
+
+    const auto doc = m_currentView->document();
+    for (const auto &l : toRequest) {
+        const int end = std::min(l.end(), doc->lines() - 1);
+        if (l.start() <= end) {
+            sendRequest(KTextEditor::Range(l.start(), 0, end, doc->lineLength(end)));
+        }
     }
 }
 
@@ -277,19 +569,26 @@ void InlayHintsManager::sendRequest(KTextEditor::Range rangeToRequest)
     auto v = m_currentView;
     auto server = m_serverManager->findServer(v, false);
     if (server) {
-        server->documentInlayHint(url, rangeToRequest, this, [v = QPointer(m_currentView), rangeToRequest, this](std::vector<LSPInlayHint> hints) {
+        // a server going away drops its replies, and those requests would block their lines for good
+        connect(server.get(), &LSPClientServer::stateChanged, this, &InlayHintsManager::onServerStateChanged, Qt::UniqueConnection);
+        const int id = ++m_lastRequestId;
+        const auto revision = v->document()->revision();
+        auto h = [v = QPointer(m_currentView), rangeToRequest, revision, id, this](std::vector<LSPInlayHint> hints) {
+            std::erase_if(m_inflightRequests, [id](const InflightRequest &req) {
+                return req.id == id;
+            });
             if (!v || m_currentView != v) {
                 return;
             }
 
             // Some server e.g., dart-analyzer will just ignore the range we sent in the request
             // and send over inlay hints for the full document anyways. To avoid issues, we
-            // remove all the inlay hints that fall outside the range we requested hints for.
+            // remove all the inlay hints that fall outside the lines we requested hints for.
             if (rangeToRequest.isValid()) {
                 hints.erase(std::remove_if(hints.begin(),
                                            hints.end(),
                                            [rangeToRequest](const LSPInlayHint &h) {
-                                               return !rangeToRequest.contains(h.position);
+                                               return h.position.line() < rangeToRequest.start().line() || h.position.line() > rangeToRequest.end().line();
                                            }),
                             hints.end());
             }
@@ -303,24 +602,88 @@ void InlayHintsManager::sendRequest(KTextEditor::Range rangeToRequest)
                     m_noteProvider.inlineNotesChanged(line);
                 }
             }
-        });
+
+            // if the doc was edited meanwhile the edited lines are requested again anyways,
+            // but we can't tell which lines of the reply are still up to date
+            auto hd = hintDataForDoc(v->document());
+            if (hd && v->document()->revision() == revision) {
+                addCoveredLines(hd->m_coveredLines, KTextEditor::LineRange(rangeToRequest.start().line(), rangeToRequest.end().line()));
+            }
+
+            m_prefetchTimer.start(prefetchDelay);
+        };
+        auto eh = [id, this](const LSPResponseError &) {
+            std::erase_if(m_inflightRequests, [id](const InflightRequest &req) {
+                return req.id == id;
+            });
+        };
+        auto handle = server->documentInlayHint(url, rangeToRequest, this, h, eh);
+        m_inflightRequests.push_back({id, KTextEditor::LineRange(rangeToRequest.start().line(), rangeToRequest.end().line()), handle});
     }
 }
 
-void InlayHintsManager::onTextInserted(KTextEditor::Document *doc, KTextEditor::Cursor pos, const QString &text)
+void InlayHintsManager::cancelRequests(KTextEditor::LineRange keep)
 {
-    auto it = std::find_if(m_hintDataByDoc.begin(), m_hintDataByDoc.end(), [doc](const HintData &hd) {
-        return hd.doc == doc;
+    std::erase_if(m_inflightRequests, [keep](InflightRequest &req) {
+        if (keep.isValid() && req.lines.start() <= keep.end() && req.lines.end() >= keep.start()) {
+            return false;
+        }
+        req.handle.cancel();
+        return true;
     });
-    if (it != m_hintDataByDoc.end()) {
-        auto &list = it->m_hints;
-        auto bit = binaryFind(list, pos.line());
-        for (; bit != list.end(); ++bit) {
-            if (bit->position.line() > pos.line()) {
-                break;
-            }
-            if (bit->position > pos) {
-                bit->position.setColumn(bit->position.column() + text.size());
+}
+
+void InlayHintsManager::onServerStateChanged(LSPClientServer *server)
+{
+    if (server->state() != LSPClientServer::State::Running) {
+        cancelRequests();
+    }
+}
+
+void InlayHintsManager::onDisplayRangeChanged(KTextEditor::View *v)
+{
+    if (!v || v != m_currentView) {
+        return;
+    }
+
+    // whatever is in flight for lines far away from the new viewport is not needed anymore
+    const auto visible = Utils::getVisibleRange(v);
+    const int screen = visible.numberOfLines() + 1;
+    cancelRequests(KTextEditor::LineRange(std::max(0, visible.start().line() - screen), visible.end().line() + screen));
+
+    m_prefetchTimer.stop();
+    sendRequestDelayed(visible, scrollDelay);
+}
+
+void InlayHintsManager::prefetch()
+{
+    // only when idle
+    if (!m_currentView || !pendingRanges.isEmpty() || !m_inflightRequests.empty()) {
+        return;
+    }
+
+    // one screen above and below the viewport
+    const auto visible = Utils::getVisibleRange(m_currentView);
+    const int lastLine = m_currentView->document()->lines() - 1;
+    const int screen = visible.numberOfLines() + 1;
+    if (visible.start().line() > 0) {
+        pendingRanges.append(KTextEditor::Range(std::max(0, visible.start().line() - screen), 0, visible.start().line() - 1, 0));
+    }
+    if (visible.end().line() < lastLine) {
+        pendingRanges.append(KTextEditor::Range(visible.end().line() + 1, 0, std::min(lastLine, visible.end().line() + screen), 0));
+    }
+    sendPendingRequests();
+}
+
+void InlayHintsManager::onTextInserted(KTextEditor::Document *doc, KTextEditor::Cursor pos, const QString &text)
+{
+    if (auto hd = hintDataForDoc(doc)) {
+        removeCoveredLines(hd->m_coveredLines, KTextEditor::LineRange(pos.line(), pos.line()));
+        if (auto hints = hd->m_hints.hintsOnLine(pos.line())) {
+            for (auto &hint : *hints) {
+                if (hint.position.column() > pos.column()) {
+                    hint.position.setColumn(hint.position.column() + text.size());
+                }
             }
         }
     }
@@ -331,48 +694,31 @@ void InlayHintsManager::onTextInserted(KTextEditor::Document *doc, KTextEditor::
 
 void InlayHintsManager::onTextRemoved(KTextEditor::Document *doc, KTextEditor::Range range, const QString &t)
 {
+    auto hd = hintDataForDoc(doc);
     if (!range.onSingleLine()) {
+        if (hd) {
+            removeCoveredLines(hd->m_coveredLines, KTextEditor::LineRange(range.start().line(), range.start().line()));
+        }
         KTextEditor::Range r(range.start().line(), 0, range.end().line(), doc->lineLength(range.end().line()));
         sendRequestDelayed(r, textChangedDelay);
         return;
     }
 
-    auto it = std::find_if(m_hintDataByDoc.begin(), m_hintDataByDoc.end(), [doc](const HintData &hd) {
-        return hd.doc == doc;
-    });
-    if (it == m_hintDataByDoc.end()) {
+    if (!hd) {
         return;
     }
-    auto &list = it->m_hints;
-    auto bit = binaryFind(list, range.start().line());
-    auto lineStartIt = bit;
-    auto removeBegin = bit;
-    auto removeEnd = list.end();
-    bool changed = false;
-    bool resort = false;
-    for (; bit != list.end(); ++bit) {
-        if (bit->position.line() > range.start().line()) {
-            removeEnd = bit;
-            break;
-        }
-        if (range.contains(bit->position) && range.start() < bit->position) {
-            // was inside range? remove this note
-            bit->position = KTextEditor::Cursor::invalid();
-            changed = true;
-        } else if (bit->position > range.end()) {
-            // in front? => adjust position
-            bit->position.setColumn(bit->position.column() - t.size());
-            changed = true;
-            resort = true;
-        }
-    }
-    if (changed) {
-        removeInvalidRanges(list, removeBegin, removeEnd);
-        if (resort) {
-            // resort the hints on this line
-            std::sort(lineStartIt, removeEnd, [](const LSPInlayHint &l, const LSPInlayHint &r) {
-                return l.position < r.position;
-            });
+    removeCoveredLines(hd->m_coveredLines, KTextEditor::LineRange(range.start().line(), range.start().line()));
+    if (auto hints = hd->m_hints.hintsOnLine(range.start().line())) {
+        const int start = range.start().column();
+        const int end = range.end().column();
+        // remove the notes that were inside the range, move the ones in front of it
+        std::erase_if(*hints, [start, end](const LSPInlayHint &h) {
+            return h.position.column() > start && h.position.column() < end;
+        });
+        for (auto &hint : *hints) {
+            if (hint.position.column() >= end) {
+                hint.position.setColumn(hint.position.column() - t.size());
+            }
         }
     }
 
@@ -382,176 +728,68 @@ void InlayHintsManager::onTextRemoved(KTextEditor::Document *doc, KTextEditor::R
 
 void InlayHintsManager::onWrapped(KTextEditor::Document *doc, KTextEditor::Cursor position)
 {
-    auto it = std::find_if(m_hintDataByDoc.begin(), m_hintDataByDoc.end(), [doc](const HintData &hd) {
-        return hd.doc == doc;
-    });
-    if (it == m_hintDataByDoc.end()) {
+    auto hd = hintDataForDoc(doc);
+    if (!hd) {
         return;
     }
-    auto &hints = it->m_hints;
-    auto bit = std::lower_bound(hints.begin(), hints.end(), position.line(), [](const LSPInlayHint &h, int l) {
-        return h.position.line() < l;
-    });
-
-    // Invalidate the ranges on the line that are after @p position
-    auto removeBegin = bit;
-    auto removeEnd = hints.end();
-    bool changed = false;
-    while (bit != hints.end()) {
-        if (bit->position.line() > position.line()) {
-            removeEnd = bit;
-            break;
-        }
-        if (bit->position >= position) {
-            // invalidate
-            changed = true;
-            bit->position = KTextEditor::Cursor::invalid();
-        }
-        ++bit;
-    }
-    changed = changed || bit != hints.end();
-    while (bit != hints.end()) {
-        bit->position.setLine(bit->position.line() + 1);
-        ++bit;
-    }
 
-    // remove invalidated stuff
-    if (changed) {
-        removeInvalidRanges(hints, removeBegin, removeEnd);
+    // Remove the hints on the line that are after @p position
+    if (auto hints = hd->m_hints.hintsOnLine(position.line())) {
+        std::erase_if(*hints, [column = position.column()](const LSPInlayHint &h) {
+            return h.position.column() >= column;
+        });
     }
+    hd->m_hints.shiftLines(position.line() + 1, 1);
+    shiftCoveredLines(hd->m_coveredLines, position.line() + 1, 1);
+    removeCoveredLines(hd->m_coveredLines, KTextEditor::LineRange(position.line(), position.line() + 1));
 
-    KTextEditor::Range r(position.line(), 0, position.line(), doc->lineLength(position.line()));
+    KTextEditor::Range r(position.line(), 0, position.line() + 1, 0);
     sendRequestDelayed(r, textChangedDelay);
 }
 
 void InlayHintsManager::onUnwrapped(KTextEditor::Document *doc, int line)
 {
-    auto it = std::find_if(m_hintDataByDoc.begin(), m_hintDataByDoc.end(), [doc](const HintData &hd) {
-        return hd.doc == doc;
-    });
-    if (it == m_hintDataByDoc.end()) {
+    auto hd = hintDataForDoc(doc);
+    if (!hd) {
         return;
     }
 
-    auto &hints = it->m_hints;
-    auto bit = std::lower_bound(hints.begin(), hints.end(), line, [](const LSPInlayHint &h, int l) {
-        return h.position.line() < l;
-    });
-
-    auto removeBegin = bit;
-    auto removeEnd = hints.end();
-    bool changed = false;
-    while (bit != hints.end()) {
-        if (bit->position.line() > line) {
-            removeEnd = bit;
-            break;
-        }
-        // invalidate
-        changed = true;
-        bit->position = KTextEditor::Cursor::invalid();
-        ++bit;
+    if (auto hints = hd->m_hints.hintsOnLine(line)) {
+        hints->clear();
     }
+    hd->m_hints.shiftLines(line + 1, -1);
+    shiftCoveredLines(hd->m_coveredLines, line + 1, -1);
+    removeCoveredLines(hd->m_coveredLines, KTextEditor::LineRange(line - 1, line));
 
-    changed = changed || bit != hints.end();
-    while (bit != hints.end()) {
-        bit->position.setLine(bit->position.line() - 1);
-        ++bit;
-    }
-
-    // remove invalidated stuff
-    if (changed) {
-        removeInvalidRanges(hints, removeBegin, removeEnd);
-    }
-
-    KTextEditor::Range r(line - 1, 0, line - 1, doc->lineLength(line));
+    KTextEditor::Range r(line - 1, 0, line, 0);
     sendRequestDelayed(r, textChangedDelay);
 }
 
 void InlayHintsManager::clearHintsForDoc(KTextEditor::Document *doc)
 {
-    m_hintDataByDoc.erase(std::remove_if(m_hintDataByDoc.begin(),
-                                         m_hintDataByDoc.end(),
-                                         [doc](const HintData &hd) {
-                                             if (!doc) {
-                                                 // remove all null docs and docs where checksum doesn't match
-                                                 return !hd.doc || (hd.doc->checksum() != hd.checksum);
-                                             }
-                                             return hd.doc == doc;
-                                         }),
-                          m_hintDataByDoc.end());
+    if (doc) {
+        m_hintDataByDoc.erase(doc);
+        return;
+    }
+    // remove all null docs and docs where checksum doesn't match
+    std::erase_if(m_hintDataByDoc, [](const auto &e) {
+        const HintData &hd = e.second;
+        return !hd.doc || (hd.doc->checksum() != hd.checksum);
+    });
 }
 
 InlayHintsManager::InsertResult
 InlayHintsManager::insertHintsForDoc(KTextEditor::Document *doc, KTextEditor::Range requestedRange, const std::vector<LSPInlayHint> &newHints)
 {
-    auto it = std::find_if(m_hintDataByDoc.begin(), m_hintDataByDoc.end(), [doc](const HintData &hd) {
-        return hd.doc == doc;
-    });
+    auto hd = hintDataForDoc(doc);
     // New document
-    if (it == m_hintDataByDoc.end()) {
-        auto &r = m_hintDataByDoc.emplace_back();
-        r = HintData{.doc = doc, .checksum = doc->checksum(), .m_hints = newHints};
-        return {.newDoc = true, .changedLines = {}, .addedHints = r.m_hints};
+    if (!hd) {
+        auto &r = m_hintDataByDoc[doc];
+        r.doc = doc;
+        r.checksum = doc->checksum();
+        r.m_hints.replace(KTextEditor::Range::invalid(), newHints);
+        return {.newDoc = true, .changedLines = {}};
     }
     // Old
-    auto &existing = it->m_hints;
-    if (newHints.empty()) {
-        const auto r = requestedRange;
-        auto bit = std::lower_bound(existing.begin(), existing.end(), r.start().line(), [](const LSPInlayHint &h, int l) {
-            return h.position.line() < l;
-        });
-        if (bit != existing.end()) {
-            QSet<int> affectedLines;
-            existing.erase(std::remove_if(bit,
-                                          existing.end(),
-                                          [r, &affectedLines](const LSPInlayHint &h) {
-                                              bool contains = r.contains(h.position);
-                                              if (contains) {
-                                                  affectedLines.insert(h.position.line());
-                                                  return true;
-                                              }
-                                              return false;
-                                          }),
-                           existing.end());
-            return {.newDoc = false, .changedLines = {affectedLines.begin(), affectedLines.end()}, .addedHints = existing};
-        }
-        return {};
-    }
-
-    QSet<int> affectedLines;
-    for (const auto &newHint : newHints) {
-        affectedLines.insert(newHint.position.line());
-    }
-
-    QSet<LSPInlayHint> rangesToInsert(newHints.begin(), newHints.end());
-
-    auto pred = [&affectedLines, &rangesToInsert](const LSPInlayHint &h) {
-        if (affectedLines.contains(h.position.line())) {
-            auto i = rangesToInsert.find(h);
-            if (i != rangesToInsert.end()) {
-                // if this range already exists then it doesn't need to be reinserted
-                rangesToInsert.erase(i);
-                return false;
-            }
-            return true;
-        }
-        return false;
-    };
-    // remove existing hints that contain affectedLines
-    existing.erase(std::remove_if(existing.begin(), existing.end(), pred), existing.end());
-
-    // now add new ones
-    affectedLines.clear();
-    for (const auto &h : rangesToInsert) {
-        existing.push_back(h);
-        // update affectedLines with lines that are actually changed
-        affectedLines.insert(h.position.line());
-    }
-
-    //  and sort them
-    std::sort(existing.begin(), existing.end(), [](const LSPInlayHint &l, const LSPInlayHint &r) {
-        return l.position < r.position;
-    });
-
-    return {.newDoc = false, .changedLines = {affectedLines.begin(), affectedLines.end()}, .addedHints = existing};
+    return {.newDoc = false, .changedLines = hd->m_hints.replace(requestedRange, newHints)};
 }
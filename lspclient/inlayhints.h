@@ -6,15 +6,21 @@
 #pragma once
 
 #include "lspclientprotocol.h"
+#include "lspclientserver.h"
+#include <QFont>
+#include <QHash>
 #include <QObject>
 #include <QPointer>
+#include <QStaticText>
 #include <QString>
 #include <QTimer>
 
 #include <KTextEditor/InlineNoteProvider>
+#include <KTextEditor/LineRange>
 #include <KTextEditor/MovingRange>
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace KTextEditor
@@ -26,21 +32,91 @@ class Document;
 class LSPClientServerManager;
 class InlayHintsManager;
 
+/**
+ * Inlay hints of a single document, bucketed by line.
+ *
+ * Line shifts caused by wrapping and unwrapping lines are only recorded and
+ * folded into the buckets once a few of them accumulated or the buckets are
+ * replaced, so typing doesn't touch every hint of the document.
+ */
+class InlayHintIndex
+{
+public:
+    bool empty() const
+    {
+        return m_buckets.empty();
+    }
+
+    /**
+     * Hints on @p line sorted by column, nullptr if there are none.
+     * Only the column of the hint positions is meaningful, the line
+     * is tracked by the index.
+     */
+    const std::vector<LSPInlayHint> *hintsOnLine(int line) const;
+    std::vector<LSPInlayHint> *hintsOnLine(int line);
+
+    /**
+     * Replace the hints inside @p range with @p newHints.
+     * An invalid range means the whole document.
+     * @return lines whose hints changed
+     */
+    QVarLengthArray<int, 16> replace(KTextEditor::Range range, std::vector<LSPInlayHint> newHints);
+
+    /**
+     * Move hints on lines >= @p fromLine by @p delta lines
+     */
+    void shiftLines(int fromLine, int delta);
+
+private:
+    int lineOf(size_t bucket) const;
+    size_t lowerBound(int line) const;
+    void applyShifts();
+
+    struct Bucket {
+        int line;
+        std::vector<LSPInlayHint> hints;
+    };
+    std::vector<Bucket> m_buckets;
+
+    // buckets [from, end) are delta lines further than m_buckets says
+    struct Shift {
+        size_t from;
+        int delta;
+    };
+    std::vector<Shift> m_pendingShifts;
+};
+
 class InlayHintNoteProvider : public KTextEditor::InlineNoteProvider
 {
 public:
     InlayHintNoteProvider(InlayHintsManager *mgr);
     void viewChanged(KTextEditor::View *v);
+    /**
+     * Drop the cached note sizes and renderings, needed whenever the font changes
+     */
+    void invalidateCache();
 
-    const std::vector<LSPInlayHint> &hints() const;
+    const InlayHintIndex &hints() const;
     QList<int> inlineNotes(int line) const override;
     QSize inlineNoteSize(const KTextEditor::InlineNote &note) const override;
     void paintInlineNote(const KTextEditor::InlineNote &note, QPainter &painter, Qt::LayoutDirection) const override;
 
 private:
+    struct CachedNote {
+        int width = 0;
+        QStaticText text;
+    };
+    /**
+     * Measured and laid out label, shared by all hints with the same label
+     */
+    const CachedNote &cachedNote(const QString &label) const;
+
     QColor m_noteColor;
     QColor m_noteBgColor;
     InlayHintsManager *const m_mgr;
+    QFont m_font;
+    qreal m_fontHeight = 0;
+    mutable QHash<QString, CachedNote> m_noteCache;
 };
 
 class InlayHintsManager : public QObject
@@ -52,7 +128,7 @@ public:
     void setActiveView(KTextEditor::View *v);
     void disable();
 
-    const std::vector<LSPInlayHint> &hintsForActiveView();
+    const InlayHintIndex &hintsForActiveView();
 
 private:
     void registerView(KTextEditor::View *);
@@ -60,13 +136,16 @@ private:
     void sendRequestDelayed(KTextEditor::Range, int delay = 300);
     void sendPendingRequests();
     void sendRequest(KTextEditor::Range r);
+    void cancelRequests(KTextEditor::LineRange keep = KTextEditor::LineRange::invalid());
+    void onServerStateChanged(LSPClientServer *server);
+    void onDisplayRangeChanged(KTextEditor::View *v);
+    void prefetch();
 
     // if doc is null, it will clear hints for all invalid docs
     void clearHintsForDoc(KTextEditor::Document *);
     struct InsertResult {
         const bool newDoc = false;
         const QVarLengthArray<int, 16> changedLines;
-        const std::vector<LSPInlayHint> addedHints;
     };
     InsertResult insertHintsForDoc(KTextEditor::Document *doc, KTextEditor::Range requestedRange, const std::vector<LSPInlayHint> &newHints);
 
@@ -78,14 +157,27 @@ private:
     struct HintData {
         QPointer<KTextEditor::Document> doc;
         QByteArray checksum;
-        std::vector<LSPInlayHint> m_hints;
+        InlayHintIndex m_hints;
+        // sorted, disjoint line ranges for which we have up to date hints
+        std::vector<KTextEditor::LineRange> m_coveredLines;
     };
-    std::vector<HintData> m_hintDataByDoc;
+    // nullptr if there is no (live) data for doc
+    HintData *hintDataForDoc(KTextEditor::Document *doc);
+    std::unordered_map<KTextEditor::Document *, HintData> m_hintDataByDoc;
 
     QTimer m_requestTimer;
+    QTimer m_prefetchTimer;
     QPointer<KTextEditor::View> m_currentView;
     InlayHintNoteProvider m_noteProvider;
     std::shared_ptr<LSPClientServerManager> m_serverManager;
     QList<KTextEditor::Range> pendingRanges;
-    const std::vector<LSPInlayHint> m_emptyHintsArray;
+
+    struct InflightRequest {
+        int id;
+        KTextEditor::LineRange lines;
+        LSPClientServer::RequestHandle handle;
+    };
+    std::vector<InflightRequest> m_inflightRequests;
+    int m_lastRequestId = 0;
+    const InlayHintIndex m_emptyHints;
 };
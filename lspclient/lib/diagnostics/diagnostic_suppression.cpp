@@ -0,0 +1,224 @@
+/*
+    SPDX-FileCopyrightText: 2019 Mark Nauwelaerts <mark.nauwelaerts@gmail.com>
+    SPDX-FileCopyrightText: 2022 Waqar Ahmed <waqar.17a@gmail.com>
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+    SPDX-License-Identifier: MIT
+*/
+#include "diagnostic_suppression.h"
+
+#include "ktexteditor_utils.h"
+
+#include <QCache>
+#include <QJsonArray>
+#include <QSet>
+#include <QtConcurrentMap>
+
+#include <KLocalizedString>
+#include <KTextEditor/Document>
+
+// below this many new messages a thread pool only adds overhead
+static constexpr int ParallelMatchThreshold = 512;
+// keep the message cache from growing without bound
+static constexpr int MaxCachedMessages = 100000;
+
+// check regexp and report
+static bool checkRegExp(const QRegularExpression &regExp)
+{
+    auto valid = regExp.isValid();
+    if (!valid) {
+        auto error = regExp.errorString();
+        auto offset = regExp.patternErrorOffset();
+        auto msg = i18nc("@info", "Error in regular expression: %1\noffset %2: %3", regExp.pattern(), offset, error);
+        Utils::showMessage(msg, {}, QStringLiteral("LSP Client"), MessageType::Error);
+    }
+    return valid;
+}
+
+/**
+ * Suppressions are recreated for every document and whenever the configuration
+ * changes, but the patterns hardly ever change. Compile (and JIT) each only once.
+ * Invalid patterns are reported the first time they are seen.
+ */
+static QRegularExpression compiledRegExp(const QString &pattern, bool report = true)
+{
+    // user patterns only, a few hundred is plenty
+    static QCache<QString, QRegularExpression> cache(256);
+    if (auto re = cache.object(pattern)) {
+        return *re;
+    }
+    QRegularExpression re(pattern);
+    re.optimize();
+    if (report) {
+        checkRegExp(re);
+    }
+    cache.insert(pattern, new QRegularExpression(re));
+    return re;
+}
+
+// group numbers and names change or clash when combined, recursion would recurse into all of it
+static bool canCombine(const QRegularExpression &regExp)
+{
+    static const QRegularExpression groupRef(QStringLiteral(R"(\\[1-9gk]|\(\?(P[=>]|R\)|&|[+-]?\d))"));
+    return regExp.captureCount() == 0 && !groupRef.match(regExp.pattern()).hasMatch();
+}
+
+DiagnosticSuppression::DiagnosticSuppression(const QUrl &docUrl, const std::vector<QJsonObject> &serverConfigs, const std::vector<QString> &sessionSuppressions)
+{
+    QStringList combined;
+    const auto localPath = docUrl.toLocalFile();
+    for (const auto &serverConfig : serverConfigs) {
+        const auto supps = serverConfig.value(QStringLiteral("suppressions")).toObject();
+        for (const auto &entry : supps) {
+            // should be (array) tuple (last element optional)
+            // [url regexp, message regexp, code regexp]
+            const auto patterns = entry.toArray();
+            if (patterns.size() >= 2) {
+                const auto urlRegExp = compiledRegExp(patterns.at(0).toString(), false);
+                if (urlRegExp.isValid() && urlRegExp.match(localPath).hasMatch()) {
+                    const auto diagPattern = patterns.at(1).toString();
+                    const auto codePattern = patterns.size() >= 3 ? patterns.at(2).toString() : QString();
+                    auto diagRegExp = compiledRegExp(diagPattern);
+                    auto codeRegExp = compiledRegExp(codePattern);
+                    if (!diagRegExp.isValid() || !codeRegExp.isValid()) {
+                        continue;
+                    }
+                    if (codePattern.isEmpty() && canCombine(diagRegExp)) {
+                        combined.push_back(diagPattern);
+                    } else {
+                        m_suppressions.push_back({diagRegExp, codeRegExp});
+                    }
+                }
+            }
+        }
+    }
+
+    // also consider session suppressions
+    for (const auto &entry : sessionSuppressions) {
+        combined.push_back(QRegularExpression::escape(entry));
+    }
+
+    if (combined.isEmpty()) {
+        return;
+    }
+    QStringList parts;
+    parts.reserve(combined.size());
+    for (const auto &p : std::as_const(combined)) {
+        parts.push_back(QStringLiteral("(?:%1)").arg(p));
+    }
+    // differs per document and session, so not worth caching
+    m_messages.setPattern(parts.join(QLatin1Char('|')));
+    m_messages.optimize();
+    m_hasMessages = m_messages.isValid();
+    if (!m_hasMessages) {
+        // should not happen without groups, but rather match one by one than not at all
+        for (const auto &p : std::as_const(combined)) {
+            m_suppressions.push_back({compiledRegExp(p, false), QRegularExpression()});
+        }
+    }
+}
+
+DiagnosticSuppression::MessageMatch DiagnosticSuppression::matchMessage(const QString &text) const
+{
+    MessageMatch m;
+    if (m_hasMessages && m_messages.match(text).hasMatch()) {
+        m.suppressed = true;
+        return m;
+    }
+    for (size_t i = 0; i < m_suppressions.size() && i < 64; ++i) {
+        const auto &s = m_suppressions[i];
+        if (s.diag.match(text).hasMatch()) {
+            if (s.code.pattern().isEmpty()) {
+                m.suppressed = true;
+                return m;
+            }
+            m.rules |= quint64(1) << i;
+        }
+    }
+    return m;
+}
+
+bool DiagnosticSuppression::matchCode(const MessageMatch &m, const QString &text, KTextEditor::Range range, KTextEditor::Document *doc) const
+{
+    if (m.suppressed) {
+        return true;
+    }
+    QString code;
+    bool haveCode = false;
+    for (size_t i = 0; i < m_suppressions.size(); ++i) {
+        const auto &s = m_suppressions[i];
+        const bool diagMatch = i < 64 ? (m.rules & (quint64(1) << i)) : s.diag.match(text).hasMatch();
+        if (!diagMatch) {
+            continue;
+        }
+        // retrieve and check code text if we need to match the content as well
+        if (doc && !s.code.pattern().isEmpty()) {
+            if (!haveCode) {
+                code = doc->text(range);
+                haveCode = true;
+            }
+            if (!s.code.match(code).hasMatch()) {
+                continue;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool DiagnosticSuppression::match(const QString &text, KTextEditor::Range range, KTextEditor::Document *doc) const
+{
+    auto it = m_cache.constFind(text);
+    if (it == m_cache.cend()) {
+        if (m_cache.size() >= MaxCachedMessages) {
+            m_cache.clear();
+        }
+        it = m_cache.insert(text, matchMessage(text));
+    }
+    return matchCode(it.value(), text, range, doc);
+}
+
+std::vector<bool> DiagnosticSuppression::match(const std::vector<QString> &texts, const std::vector<KTextEditor::Range> &ranges, KTextEditor::Document *doc) const
+{
+    Q_ASSERT(texts.size() == ranges.size());
+    std::vector<bool> suppressed(texts.size(), false);
+    if (!m_hasMessages && m_suppressions.empty()) {
+        return suppressed;
+    }
+
+    // make room first, the texts seen before must stay in there
+    if (m_cache.size() + qsizetype(texts.size()) > MaxCachedMessages) {
+        m_cache.clear();
+    }
+
+    // messages we have not seen yet, each once
+    QList<QString> todo;
+    QSet<QString> seen;
+    for (const auto &text : texts) {
+        if (!m_cache.contains(text) && !seen.contains(text)) {
+            seen.insert(text);
+            todo.push_back(text);
+        }
+    }
+
+    // the regular expressions are compiled already and can be shared by the threads,
+    // the code rules need the document and stay on this thread
+    auto matchOne = [this](const QString &text) -> MessageMatch {
+        return matchMessage(text);
+    };
+    if (todo.size() >= ParallelMatchThreshold) {
+        const auto results = QtConcurrent::blockingMapped<QList<MessageMatch>>(todo, matchOne);
+        for (qsizetype i = 0; i < todo.size(); ++i) {
+            m_cache.insert(todo[i], results[i]);
+        }
+    } else {
+        for (const auto &text : todo) {
+            m_cache.insert(text, matchOne(text));
+        }
+    }
+
+    for (size_t i = 0; i < texts.size(); ++i) {
+        // either there before or added above, so all texts are in there
+        suppressed[i] = matchCode(m_cache.value(texts[i]), texts[i], ranges[i], doc);
+    }
+    return suppressed;
+}
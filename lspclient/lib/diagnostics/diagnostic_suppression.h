@@ -5,86 +5,54 @@
 */
 #pragma once
 
-#include "ktexteditor_utils.h"
-
-#include <QJsonArray>
+#include <QHash>
 #include <QJsonObject>
-#include <QPointer>
 #include <QRegularExpression>
-#include <QStandardItem>
 
-#include <KLocalizedString>
-#include <KTextEditor/Document>
+#include <KTextEditor/Range>
+
+#include <vector>
+
+namespace KTextEditor
+{
+class Document;
+}
 
 // helper data that holds diagnostics suppressions
 class DiagnosticSuppression
 {
+    // rules without code part, combined into one alternation
+    QRegularExpression m_messages;
+    bool m_hasMessages = false;
+
+    // rules that also match the code text or cannot be combined
     struct Suppression {
         QRegularExpression diag, code;
     };
     std::vector<Suppression> m_suppressions;
 
+    struct MessageMatch {
+        bool suppressed = false;
+        // bit i set if the message part of m_suppressions[i] matches,
+        // rules beyond the 64th are matched again when needed
+        quint64 rules = 0;
+    };
+    // by message, the same message is reported over and over
+    mutable QHash<QString, MessageMatch> m_cache;
+
+    MessageMatch matchMessage(const QString &text) const;
+    bool matchCode(const MessageMatch &m, const QString &text, KTextEditor::Range range, KTextEditor::Document *doc) const;
+
 public:
     // construct from configuration
-    DiagnosticSuppression(const QUrl &docUrl, const std::vector<QJsonObject> &serverConfigs, const std::vector<QString> &sessionSuppressions)
-    {
-        // check regexp and report
-        auto checkRegExp = [](const QRegularExpression &regExp) {
-            auto valid = regExp.isValid();
-            if (!valid) {
-                auto error = regExp.errorString();
-                auto offset = regExp.patternErrorOffset();
-                auto msg = i18nc("@info", "Error in regular expression: %1\noffset %2: %3", regExp.pattern(), offset, error);
-                Utils::showMessage(msg, {}, QStringLiteral("LSP Client"), MessageType::Error);
-            }
-            return valid;
-        };
-
-        const auto localPath = docUrl.toLocalFile();
-        for (const auto &serverConfig : serverConfigs) {
-            const auto supps = serverConfig.value(QStringLiteral("suppressions")).toObject();
-            for (const auto &entry : supps) {
-                // should be (array) tuple (last element optional)
-                // [url regexp, message regexp, code regexp]
-                const auto patterns = entry.toArray();
-                if (patterns.size() >= 2) {
-                    const auto urlRegExp = QRegularExpression(patterns.at(0).toString());
-                    if (urlRegExp.isValid() && urlRegExp.match(localPath).hasMatch()) {
-                        QRegularExpression diagRegExp, codeRegExp;
-                        diagRegExp = QRegularExpression(patterns.at(1).toString());
-                        if (patterns.size() >= 3) {
-                            codeRegExp = QRegularExpression(patterns.at(2).toString());
-                        }
-                        if (checkRegExp(diagRegExp) && checkRegExp(codeRegExp)) {
-                            m_suppressions.push_back({diagRegExp, codeRegExp});
-                        }
-                    }
-                }
-            }
-        }
+    DiagnosticSuppression(const QUrl &docUrl, const std::vector<QJsonObject> &serverConfigs, const std::vector<QString> &sessionSuppressions);
 
-        // also consider session suppressions
-        for (const auto &entry : sessionSuppressions) {
-            auto pattern = QRegularExpression::escape(entry);
-            m_suppressions.push_back({QRegularExpression(pattern), {}});
-        }
-    }
+    bool match(const QString &text, KTextEditor::Range range, KTextEditor::Document *doc) const;
 
-    bool match(const QStandardItem &item, KTextEditor::Document *doc) const
-    {
-        for (const auto &s : m_suppressions) {
-            if (s.diag.match(item.text()).hasMatch()) {
-                // retrieve and check code text if we need to match the content as well
-                if (doc && !s.code.pattern().isEmpty()) {
-                    auto range = item.data(/*RangeData::RangeRole*/).value<KTextEditor::Range>();
-                    auto code = doc->text(range);
-                    if (!s.code.match(code).hasMatch()) {
-                        continue;
-                    }
-                }
-                return true;
-            }
-        }
-        return false;
-    }
+    /**
+     * Match many diagnostics at once, @p texts and @p ranges have the same size.
+     * Every distinct message is matched once, large batches on all cores.
+     * @return true for every suppressed diagnostic
+     */
+    std::vector<bool> match(const std::vector<QString> &texts, const std::vector<KTextEditor::Range> &ranges, KTextEditor::Document *doc) const;
 };
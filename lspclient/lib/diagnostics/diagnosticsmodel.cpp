@@ -0,0 +1,792 @@
+/*
+    SPDX-FileCopyrightText: 2019 Mark Nauwelaerts <mark.nauwelaerts@gmail.com>
+    SPDX-FileCopyrightText: 2022 Waqar Ahmed <waqar.17a@gmail.com>
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+    SPDX-License-Identifier: MIT
+*/
+#include "diagnosticsmodel.h"
+
+#include "diagnosticview.h"
+
+#include <KLocalizedString>
+
+#include <QFileInfo>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <limits>
+
+QIcon diagnosticsIcon(DiagnosticSeverity severity)
+{
+    switch (severity) {
+    case DiagnosticSeverity::Error: {
+        static QIcon icon(QIcon::fromTheme(QStringLiteral("data-error"), QIcon::fromTheme(QStringLiteral("dialog-error"))));
+        return icon;
+    }
+    case DiagnosticSeverity::Warning: {
+        static QIcon icon(QIcon::fromTheme(QStringLiteral("data-warning"), QIcon::fromTheme(QStringLiteral("dialog-warning"))));
+        return icon;
+    }
+    case DiagnosticSeverity::Information:
+    case DiagnosticSeverity::Hint: {
+        static QIcon icon(QIcon::fromTheme(QStringLiteral("data-information"), QIcon::fromTheme(QStringLiteral("dialog-information"))));
+        return icon;
+    }
+    default:
+        break;
+    }
+    return QIcon();
+}
+
+static QString pathForUrl(const QUrl &url)
+{
+    return url.toString(QUrl::PreferLocalFile | QUrl::RemovePassword);
+}
+
+DiagnosticsModel::DiagnosticsModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+    m_strings.push_back(QString());
+}
+
+DiagnosticsModel::~DiagnosticsModel() = default;
+
+DiagnosticsModel::File *DiagnosticsModel::fileForUrl(const QUrl &url) const
+{
+    return m_filesByPath.value(pathForUrl(url));
+}
+
+DiagnosticsModel::File *DiagnosticsModel::addFile(const QUrl &url)
+{
+    auto file = std::make_unique<File>();
+    file->isFile = true;
+    file->row = (int)m_files.size();
+    file->url = url;
+    file->path = pathForUrl(url);
+
+    auto ret = file.get();
+    beginInsertRows({}, file->row, file->row);
+    m_filesByPath.insert(ret->path, ret);
+    m_files.push_back(std::move(file));
+    endInsertRows();
+    return ret;
+}
+
+void DiagnosticsModel::removeFiles(int row, int count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    beginRemoveRows({}, row, row + count - 1);
+    for (int i = row; i < row + count; ++i) {
+        m_entryCount -= (int)m_files[i]->diagnostics.size();
+        m_filesByPath.remove(m_files[i]->path);
+    }
+    m_files.erase(m_files.begin() + row, m_files.begin() + row + count);
+    for (int i = row; i < (int)m_files.size(); ++i) {
+        m_files[i]->row = i;
+    }
+    endRemoveRows();
+
+    compactStrings();
+}
+
+void DiagnosticsModel::clear()
+{
+    beginResetModel();
+    m_files.clear();
+    m_filesByPath.clear();
+    m_strings.clear();
+    m_strings.push_back(QString());
+    m_stringIds.clear();
+    m_entryCount = 0;
+    endResetModel();
+}
+
+void DiagnosticsModel::addProvider(File *file, DiagnosticsProvider *provider)
+{
+    if (!file->providers.contains(provider)) {
+        file->providers.push_back(provider);
+    }
+    // emit so that proxy can update
+    const auto index = indexForFile(file);
+    Q_EMIT dataChanged(index, index);
+}
+
+void DiagnosticsModel::appendDiagnostics(File *file, DiagnosticsProvider *provider, const QList<Diagnostic> &diagnostics)
+{
+    if (diagnostics.isEmpty()) {
+        return;
+    }
+
+    const int first = (int)file->diagnostics.size();
+    beginInsertRows(indexForFile(file), first, first + (int)diagnostics.size() - 1);
+    file->diagnostics.reserve(file->diagnostics.size() + diagnostics.size());
+    for (const auto &diag : diagnostics) {
+        Entry e;
+        e.range = diag.range;
+        e.provider = provider;
+        e.id = m_nextEntryId++;
+        e.severity = diag.severity;
+
+        QString source;
+        if (diag.source.length()) {
+            source = QStringLiteral("[%1] ").arg(diag.source);
+        }
+        if (diag.code.length()) {
+            source += QStringLiteral("(%1) ").arg(diag.code);
+        }
+        // rendering of lines with embedded newlines does not work so well
+        // so ... split message by lines, subsequent lines become child rows
+        const auto lines = QStringView(diag.message).split(u'\n', Qt::SkipEmptyParts);
+        e.text = intern(!lines.empty() ? source + lines[0].toString() : source);
+        e.message = intern(diag.message);
+        e.code = intern(diag.code);
+        e.source = intern(diag.source);
+        e.extraLines = quint16(std::clamp<qsizetype>(lines.size() - 1, 0, std::numeric_limits<quint16>::max()));
+
+        e.relatedBegin = quint32(file->related.size());
+        for (const auto &related : diag.relatedInformation) {
+            if (related.location.uri.isEmpty()) {
+                continue;
+            }
+            if (e.relatedCount == std::numeric_limits<quint16>::max()) {
+                break;
+            }
+            file->related.push_back(related);
+            e.relatedCount++;
+        }
+        file->diagnostics.push_back(e);
+    }
+    m_entryCount += (int)diagnostics.size();
+    endInsertRows();
+}
+
+int DiagnosticsModel::removeDiagnosticsForProvider(File *file, DiagnosticsProvider *provider)
+{
+    auto &providers = file->providers;
+    // If there is only 1 provider and its diagnostics are persistent, or
+    // we don't have any diagnostics from this provider, we have nothing to do here
+    if (providers.size() == 1 && (provider ? !providers.contains(provider) : providers.back()->persistentDiagnostics())) {
+        return 0;
+    }
+
+    std::vector<bool> remove(file->diagnostics.size(), false);
+    for (size_t i = 0; i < remove.size(); ++i) {
+        const auto &e = file->diagnostics[i];
+        remove[i] = provider ? e.provider == provider : !e.provider->persistentDiagnostics();
+    }
+    const auto removed = removeEntries(file, remove);
+
+    // remove the providers for which we don't have diagnostics
+    for (const auto &e : removed) {
+        providers.removeOne(e.provider);
+    }
+    return (int)removed.size();
+}
+
+namespace
+{
+struct DiagnosticKey {
+    KTextEditor::Range range;
+    DiagnosticSeverity severity;
+    quint32 code;
+    quint32 message;
+    quint32 source;
+
+    bool operator==(const DiagnosticKey &) const = default;
+};
+
+size_t qHash(const DiagnosticKey &key, size_t seed = 0)
+{
+    const auto &r = key.range;
+    return qHashMulti(seed, r.start().line(), r.start().column(), r.end().line(), r.end().column(), int(key.severity), key.code, key.message, key.source);
+}
+}
+
+std::vector<DiagnosticsModel::Entry>
+DiagnosticsModel::updateDiagnostics(File *file,
+                                    DiagnosticsProvider *provider,
+                                    const QList<Diagnostic> &diagnostics,
+                                    int &firstAdded,
+                                    std::vector<DiagnosticRelatedInformation> *removedRelated)
+{
+    // strings that are not in the pool can't belong to an existing entry
+    constexpr auto unknown = std::numeric_limits<quint32>::max();
+    auto lookup = [this](const QString &s) {
+        return s.isEmpty() ? 0 : m_stringIds.value(s, unknown);
+    };
+    auto sameRelated = [file](const Entry &e, const Diagnostic &diag) {
+        const auto &related = diag.relatedInformation;
+        qsizetype count = 0;
+        for (const auto &r : related) {
+            if (r.location.uri.isEmpty()) {
+                continue;
+            }
+            if (count == e.relatedCount) {
+                return false;
+            }
+            const auto &old = file->related[e.relatedBegin + count];
+            if (old.location.uri != r.location.uri || old.location.range != r.location.range || old.message != r.message) {
+                return false;
+            }
+            ++count;
+        }
+        return count == e.relatedCount;
+    };
+
+    auto &diags = file->diagnostics;
+    QMultiHash<DiagnosticKey, int> oldRows;
+    for (int row = 0; row < (int)diags.size(); ++row) {
+        const auto &e = diags[row];
+        if (e.provider == provider) {
+            oldRows.insert({e.range, e.severity, e.code, e.message, e.source}, row);
+        }
+    }
+
+    std::vector<bool> remove(diags.size(), false);
+    for (auto row : std::as_const(oldRows)) {
+        remove[row] = true;
+    }
+
+    QList<Diagnostic> added;
+    for (const auto &diag : diagnostics) {
+        const DiagnosticKey key{diag.range, diag.severity, lookup(diag.code), lookup(diag.message), lookup(diag.source)};
+        bool kept = false;
+        if (key.code != unknown && key.message != unknown && key.source != unknown) {
+            for (auto it = oldRows.find(key); it != oldRows.end() && it.key() == key; ++it) {
+                if (sameRelated(diags[it.value()], diag)) {
+                    remove[it.value()] = false;
+                    oldRows.erase(it);
+                    kept = true;
+                    break;
+                }
+            }
+        }
+        if (!kept) {
+            added.push_back(diag);
+        }
+    }
+
+    auto removed = removeEntries(file, remove, removedRelated);
+    firstAdded = (int)diags.size();
+    appendDiagnostics(file, provider, added);
+    return removed;
+}
+
+std::vector<DiagnosticsModel::Entry> DiagnosticsModel::removeEntries(File *file, const std::vector<bool> &remove, std::vector<DiagnosticRelatedInformation> *removedRelated)
+{
+    auto &diags = file->diagnostics;
+    Q_ASSERT(remove.size() == diags.size());
+
+    std::vector<Entry> removed;
+    const auto parent = indexForFile(file);
+    // remove runs of rows back to front, the rows before a run stay valid
+    int end = (int)diags.size();
+    while (end > 0) {
+        if (!remove[end - 1]) {
+            --end;
+            continue;
+        }
+        int start = end - 1;
+        while (start > 0 && remove[start - 1]) {
+            --start;
+        }
+
+        beginRemoveRows(parent, start, end - 1);
+        for (int i = start; i < end; ++i) {
+            file->children.erase(diags[i].id);
+            file->suppressedCount -= diags[i].enabled ? 0 : 1;
+        }
+        removed.insert(removed.end(), diags.begin() + start, diags.begin() + end);
+        diags.erase(diags.begin() + start, diags.begin() + end);
+        updateChildRows(file);
+        endRemoveRows();
+
+        end = start;
+    }
+
+    if (removed.empty()) {
+        return removed;
+    }
+
+    // drop the related information of removed diagnostics
+    if (!file->related.empty()) {
+        if (removedRelated) {
+            for (auto &e : removed) {
+                const auto begin = file->related.begin() + e.relatedBegin;
+                e.relatedBegin = quint32(removedRelated->size());
+                removedRelated->insert(removedRelated->end(), begin, begin + e.relatedCount);
+            }
+        }
+        std::vector<DiagnosticRelatedInformation> related;
+        for (auto &e : diags) {
+            const auto begin = file->related.begin() + e.relatedBegin;
+            e.relatedBegin = quint32(related.size());
+            related.insert(related.end(), begin, begin + e.relatedCount);
+        }
+        file->related = std::move(related);
+    }
+
+    const bool hadSuppressed = std::any_of(removed.begin(), removed.end(), [](const Entry &e) {
+        return !e.enabled;
+    });
+    if (hadSuppressed) {
+        Q_EMIT dataChanged(parent, parent);
+    }
+
+    m_entryCount -= (int)removed.size();
+    compactStrings();
+    return removed;
+}
+
+void DiagnosticsModel::setDiagnosticsEnabled(File *file, int firstRow, const std::vector<bool> &enabled)
+{
+    Q_ASSERT(size_t(firstRow) + enabled.size() <= file->diagnostics.size());
+
+    int first = -1;
+    int last = -1;
+    int suppressed = file->suppressedCount;
+    for (size_t i = 0; i < enabled.size(); ++i) {
+        auto &e = file->diagnostics[firstRow + i];
+        if (e.enabled != enabled[i]) {
+            e.enabled = enabled[i];
+            suppressed += e.enabled ? -1 : 1;
+            if (first == -1) {
+                first = firstRow + (int)i;
+            }
+            last = firstRow + (int)i;
+        }
+    }
+
+    const auto parent = indexForFile(file);
+    if (first != -1) {
+        Q_EMIT dataChanged(index(first, 0, parent), index(last, 0, parent));
+    }
+    if (suppressed != file->suppressedCount) {
+        file->suppressedCount = suppressed;
+        Q_EMIT dataChanged(parent, parent);
+    }
+}
+
+static KTextEditor::Cursor shifted(KTextEditor::Cursor c, int line, int delta)
+{
+    return c.line() >= line ? KTextEditor::Cursor(std::max(0, c.line() + delta), c.column()) : c;
+}
+
+static KTextEditor::Range shifted(KTextEditor::Range r, int line, int delta)
+{
+    return r.isValid() ? KTextEditor::Range(shifted(r.start(), line, delta), shifted(r.end(), line, delta)) : r;
+}
+
+void DiagnosticsModel::shiftLines(File *file, int line, int delta)
+{
+    // nothing shown depends on the lines, so no dataChanged
+    for (auto &e : file->diagnostics) {
+        e.range = shifted(e.range, line, delta);
+    }
+    for (auto &related : file->related) {
+        if (related.location.uri == file->url) {
+            related.location.range = shifted(related.location.range, line, delta);
+        }
+    }
+    for (auto &[id, children] : file->children) {
+        for (auto &child : children->rows) {
+            if (child.related && child.url == file->url) {
+                child.range = shifted(child.range, line, delta);
+            }
+        }
+    }
+}
+
+void DiagnosticsModel::setRange(File *file, int row, int related, KTextEditor::Range range)
+{
+    const auto &e = file->diagnostics[row];
+    if (related < 0) {
+        file->diagnostics[row].range = range;
+        return;
+    }
+
+    file->related[e.relatedBegin + related].location.range = range;
+    auto it = file->children.find(e.id);
+    if (it != file->children.end()) {
+        // the related rows follow the split message lines
+        auto &child = it->second->rows[e.extraLines + related];
+        child.range = range;
+    }
+}
+
+int DiagnosticsModel::rowOfEntry(const File *file, quint32 id) const
+{
+    // entries are only ever appended or removed, so they are sorted by id
+    const auto &diags = file->diagnostics;
+    auto it = std::lower_bound(diags.begin(), diags.end(), id, [](const Entry &e, quint32 id) {
+        return e.id < id;
+    });
+    return it == diags.end() || it->id != id ? -1 : int(it - diags.begin());
+}
+
+Diagnostic DiagnosticsModel::diagnostic(const File *file, int row) const
+{
+    const auto &e = file->diagnostics[row];
+    Diagnostic diag;
+    diag.range = e.range;
+    diag.severity = e.severity;
+    diag.code = string(e.code);
+    diag.source = string(e.source);
+    diag.message = string(e.message);
+    const auto begin = file->related.begin() + e.relatedBegin;
+    diag.relatedInformation = QList<DiagnosticRelatedInformation>(begin, begin + e.relatedCount);
+    return diag;
+}
+
+DiagnosticsModel::Children &DiagnosticsModel::childrenFor(File *file, int row) const
+{
+    const auto &e = file->diagnostics[row];
+    auto &children = file->children[e.id];
+    if (children) {
+        return *children;
+    }
+
+    children = std::make_unique<Children>();
+    children->file = file;
+    children->entryId = e.id;
+    children->row = row;
+    children->rows.reserve(e.extraLines + e.relatedCount);
+
+    if (e.extraLines > 0) {
+        const QString message = string(e.message);
+        const auto lines = QStringView(message).split(u'\n', Qt::SkipEmptyParts);
+        for (int l = 1; l <= e.extraLines; ++l) {
+            ChildRow child;
+            child.text = lines[l].toString();
+            children->rows.push_back(std::move(child));
+        }
+    }
+
+    for (quint32 i = e.relatedBegin; i < e.relatedBegin + e.relatedCount; ++i) {
+        const auto &related = file->related[i];
+        auto basename = QFileInfo(related.location.uri.toLocalFile()).fileName();
+        // display line number is 1-based (as opposed to internal 0-based)
+        auto location = QStringLiteral("%1:%2").arg(basename).arg(related.location.range.start().line() + 1);
+
+        ChildRow child;
+        child.text = QStringLiteral("[%1] %2").arg(location).arg(related.message);
+        child.url = related.location.uri;
+        child.range = related.location.range;
+        child.related = true;
+        children->rows.push_back(std::move(child));
+    }
+    return *children;
+}
+
+const std::vector<DiagnosticsModel::ChildRow> &DiagnosticsModel::children(File *file, int row) const
+{
+    return childrenFor(file, row).rows;
+}
+
+void DiagnosticsModel::addFixes(File *file, int row, const QList<DiagnosticFix> &fixes)
+{
+    const int count = (int)std::count_if(fixes.begin(), fixes.end(), [](const DiagnosticFix &fix) {
+        return bool(fix.fixCallback);
+    });
+    if (count == 0) {
+        return;
+    }
+
+    auto &rows = childrenFor(file, row).rows;
+    const int first = (int)rows.size();
+    beginInsertRows(indexForEntry(file, row), first, first + count - 1);
+    for (const auto &fix : fixes) {
+        if (!fix.fixCallback) {
+            continue;
+        }
+        ChildRow child;
+        child.text = fix.fixTitle;
+        child.fix = fix;
+        rows.push_back(std::move(child));
+    }
+    endInsertRows();
+}
+
+QList<DiagnosticFix> DiagnosticsModel::fixes(File *file, int row) const
+{
+    QList<DiagnosticFix> fixes;
+    // fixes are only ever added to materialized children
+    auto it = file->children.find(file->diagnostics[row].id);
+    if (it != file->children.end()) {
+        for (const auto &child : it->second->rows) {
+            if (child.fix) {
+                fixes << *child.fix;
+            }
+        }
+    }
+    return fixes;
+}
+
+void DiagnosticsModel::updateChildRows(File *file)
+{
+    if (file->children.empty()) {
+        return;
+    }
+    const auto &diags = file->diagnostics;
+    for (int row = 0; row < (int)diags.size(); ++row) {
+        auto it = file->children.find(diags[row].id);
+        if (it != file->children.end()) {
+            it->second->row = row;
+        }
+    }
+}
+
+quint32 DiagnosticsModel::intern(const QString &s)
+{
+    if (s.isEmpty()) {
+        return 0;
+    }
+    auto it = m_stringIds.constFind(s);
+    if (it != m_stringIds.cend()) {
+        return it.value();
+    }
+    const auto id = quint32(m_strings.size());
+    m_strings.push_back(s);
+    m_stringIds.insert(s, id);
+    return id;
+}
+
+void DiagnosticsModel::compactStrings()
+{
+    // an entry refers to at most 4 strings, if the pool is much larger
+    // than that, most of it belongs to diagnostics that are gone
+    if (m_strings.size() < 1024 || m_strings.size() < 8 * size_t(m_entryCount)) {
+        return;
+    }
+
+    constexpr auto unmapped = std::numeric_limits<quint32>::max();
+    std::vector<quint32> newIds(m_strings.size(), unmapped);
+    newIds[0] = 0;
+    std::vector<QString> strings{QString()};
+    QHash<QString, quint32> stringIds;
+    auto remap = [&](quint32 &id) {
+        if (newIds[id] == unmapped) {
+            newIds[id] = quint32(strings.size());
+            strings.push_back(m_strings[id]);
+            stringIds.insert(m_strings[id], newIds[id]);
+        }
+        id = newIds[id];
+    };
+
+    for (const auto &file : m_files) {
+        for (auto &e : file->diagnostics) {
+            remap(e.text);
+            remap(e.message);
+            remap(e.code);
+            remap(e.source);
+        }
+    }
+    m_strings = std::move(strings);
+    m_stringIds = std::move(stringIds);
+}
+
+DiagnosticsModel::ItemKind DiagnosticsModel::kind(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return ItemKind::Invalid;
+    }
+    auto node = static_cast<const Node *>(index.internalPointer());
+    if (!node) {
+        return ItemKind::File;
+    }
+    return node->isFile ? ItemKind::Diagnostic : ItemKind::Child;
+}
+
+DiagnosticsModel::File *DiagnosticsModel::fileForIndex(const QModelIndex &index) const
+{
+    switch (kind(index)) {
+    case ItemKind::Invalid:
+        return nullptr;
+    case ItemKind::File:
+        return index.row() < fileCount() ? fileAt(index.row()) : nullptr;
+    case ItemKind::Diagnostic:
+        return static_cast<File *>(static_cast<Node *>(index.internalPointer()));
+    case ItemKind::Child:
+        return static_cast<Children *>(static_cast<Node *>(index.internalPointer()))->file;
+    }
+    return nullptr;
+}
+
+int DiagnosticsModel::entryRowForIndex(const QModelIndex &index) const
+{
+    switch (kind(index)) {
+    case ItemKind::Diagnostic:
+        return index.row();
+    case ItemKind::Child:
+        return static_cast<Children *>(static_cast<Node *>(index.internalPointer()))->row;
+    default:
+        return -1;
+    }
+}
+
+QModelIndex DiagnosticsModel::indexForFile(const File *file) const
+{
+    return createIndex(file->row, 0, nullptr);
+}
+
+QModelIndex DiagnosticsModel::indexForEntry(const File *file, int row) const
+{
+    return createIndex(row, 0, static_cast<const Node *>(file));
+}
+
+QModelIndex DiagnosticsModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (column != 0 || row < 0) {
+        return {};
+    }
+
+    switch (kind(parent)) {
+    case ItemKind::Invalid:
+        if (row < fileCount()) {
+            return createIndex(row, 0, nullptr);
+        }
+        break;
+    case ItemKind::File: {
+        auto file = fileAt(parent.row());
+        if (row < (int)file->diagnostics.size()) {
+            return indexForEntry(file, row);
+        }
+        break;
+    }
+    case ItemKind::Diagnostic: {
+        auto file = fileForIndex(parent);
+        const auto &children = childrenFor(file, parent.row());
+        if (row < (int)children.rows.size()) {
+            return createIndex(row, 0, static_cast<const Node *>(&children));
+        }
+        break;
+    }
+    case ItemKind::Child:
+        break;
+    }
+    return {};
+}
+
+QModelIndex DiagnosticsModel::parent(const QModelIndex &index) const
+{
+    switch (kind(index)) {
+    case ItemKind::Diagnostic:
+        return indexForFile(fileForIndex(index));
+    case ItemKind::Child: {
+        auto children = static_cast<Children *>(static_cast<Node *>(index.internalPointer()));
+        return indexForEntry(children->file, children->row);
+    }
+    default:
+        return {};
+    }
+}
+
+int DiagnosticsModel::rowCount(const QModelIndex &parent) const
+{
+    switch (kind(parent)) {
+    case ItemKind::Invalid:
+        return fileCount();
+    case ItemKind::File:
+        return (int)fileAt(parent.row())->diagnostics.size();
+    case ItemKind::Diagnostic: {
+        // don't create the children just to count them
+        auto file = fileForIndex(parent);
+        const auto &e = file->diagnostics[parent.row()];
+        auto it = file->children.find(e.id);
+        if (it != file->children.end()) {
+            return (int)it->second->rows.size();
+        }
+        return e.extraLines + e.relatedCount;
+    }
+    case ItemKind::Child:
+        break;
+    }
+    return 0;
+}
+
+int DiagnosticsModel::columnCount(const QModelIndex &) const
+{
+    return 1;
+}
+
+QVariant DiagnosticsModel::data(const QModelIndex &index, int role) const
+{
+    switch (kind(index)) {
+    case ItemKind::Invalid:
+        break;
+    case ItemKind::File: {
+        const auto file = fileForIndex(index);
+        if (!file) {
+            break;
+        }
+        if (role == Qt::DisplayRole) {
+            return file->suppressedCount ? i18nc("@info", "%1 [suppressed: %2]", file->path, file->suppressedCount) : file->path;
+        } else if (role == Qt::UserRole) {
+            // local file, Qt::DisplayRole might have additional elements
+            return file->path;
+        }
+        break;
+    }
+    case ItemKind::Diagnostic: {
+        const auto file = fileForIndex(index);
+        const auto &e = file->diagnostics[index.row()];
+        switch (role) {
+        case Qt::DisplayRole:
+            return string(e.text);
+        case Qt::DecorationRole:
+            return diagnosticsIcon(e.severity);
+        case DiagnosticModelRole::FileUrlRole:
+            return file->url;
+        case DiagnosticModelRole::RangeRole:
+            return QVariant::fromValue(e.range);
+        case DiagnosticModelRole::KindRole:
+            return QVariant::fromValue(e.severity);
+        case DiagnosticModelRole::ProviderRole:
+            return QVariant::fromValue(e.provider);
+        }
+        break;
+    }
+    case ItemKind::Child: {
+        auto children = static_cast<Children *>(static_cast<Node *>(index.internalPointer()));
+        const auto &child = children->rows[index.row()];
+        if (role == Qt::DisplayRole) {
+            return child.text;
+        }
+        // split message lines and fixes have no data,
+        // it can be taken from the parent (for marks and ranges)
+        if (!child.related) {
+            break;
+        }
+        switch (role) {
+        case Qt::DecorationRole:
+            return diagnosticsIcon(DiagnosticSeverity::Information);
+        case DiagnosticModelRole::FileUrlRole:
+            return child.url;
+        case DiagnosticModelRole::RangeRole:
+            return QVariant::fromValue(child.range);
+        case DiagnosticModelRole::KindRole:
+            return QVariant::fromValue(DiagnosticSeverity::Information);
+        }
+        break;
+    }
+    }
+    return {};
+}
+
+Qt::ItemFlags DiagnosticsModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    Qt::ItemFlags flags = Qt::ItemIsSelectable;
+    if (kind(index) == ItemKind::Diagnostic) {
+        // suppressed diagnostics are disabled
+        flags.setFlag(Qt::ItemIsEnabled, fileForIndex(index)->diagnostics[index.row()].enabled);
+    } else {
+        flags |= Qt::ItemIsEnabled;
+    }
+    return flags;
+}
@@ -0,0 +1,218 @@
+/*
+    SPDX-FileCopyrightText: 2019 Mark Nauwelaerts <mark.nauwelaerts@gmail.com>
+    SPDX-FileCopyrightText: 2022 Waqar Ahmed <waqar.17a@gmail.com>
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+    SPDX-License-Identifier: MIT
+*/
+#pragma once
+
+#include "diagnostic_suppression.h"
+#include "diagnostic_types.h"
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QIcon>
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+class DiagnosticsProvider;
+
+namespace DiagnosticModelRole
+{
+enum {
+    // preserve UserRole for generic use where needed
+    FileUrlRole = Qt::UserRole + 1,
+    RangeRole,
+    KindRole,
+    ProviderRole,
+};
+}
+
+QIcon diagnosticsIcon(DiagnosticSeverity severity);
+
+/**
+ * Model behind the diagnostics view, a tree of files, their diagnostics and
+ * the rows below a diagnostic (further message lines, related information, fixes).
+ *
+ * The diagnostics of a file are stored in one contiguous array of small entries,
+ * their strings are interned in a pool shared by all files. The rows below a
+ * diagnostic are only created once somebody asks for them.
+ */
+class DiagnosticsModel : public QAbstractItemModel
+{
+public:
+    enum class ItemKind {
+        Invalid,
+        File,
+        Diagnostic,
+        Child,
+    };
+
+    struct Entry {
+        KTextEditor::Range range;
+        DiagnosticsProvider *provider = nullptr;
+        // stable, unlike the row
+        quint32 id = 0;
+        // string pool ids
+        quint32 text = 0;
+        quint32 message = 0;
+        quint32 code = 0;
+        quint32 source = 0;
+        // related information is in File::related
+        quint32 relatedBegin = 0;
+        quint16 relatedCount = 0;
+        // message lines after the first one
+        quint16 extraLines = 0;
+        DiagnosticSeverity severity = DiagnosticSeverity::Unknown;
+        // false if suppressed
+        bool enabled = true;
+    };
+
+    struct ChildRow {
+        QString text;
+        // only set for related information
+        QUrl url;
+        KTextEditor::Range range = KTextEditor::Range::invalid();
+        bool related = false;
+        std::optional<DiagnosticFix> fix;
+    };
+
+    // what the internal pointer of non file indexes points to
+    struct Node {
+        bool isFile = false;
+        // row of the file or of the diagnostic the children belong to
+        int row = 0;
+    };
+
+    struct File;
+    struct Children : Node {
+        File *file = nullptr;
+        quint32 entryId = 0;
+        std::vector<ChildRow> rows;
+    };
+
+    struct File : Node {
+        QUrl url;
+        // url.toString(QUrl::PreferLocalFile | QUrl::RemovePassword)
+        QString path;
+        std::vector<Entry> diagnostics;
+        std::vector<DiagnosticRelatedInformation> related;
+        QList<DiagnosticsProvider *> providers;
+        bool suppressionEnabled = true;
+        int suppressedCount = 0;
+        std::unique_ptr<DiagnosticSuppression> diagnosticSuppression;
+        // materialized rows below diagnostics, by entry id
+        std::unordered_map<quint32, std::unique_ptr<Children>> children;
+    };
+
+    explicit DiagnosticsModel(QObject *parent = nullptr);
+    ~DiagnosticsModel() override;
+
+    int fileCount() const
+    {
+        return (int)m_files.size();
+    }
+    File *fileAt(int row) const
+    {
+        return m_files.at(row).get();
+    }
+    File *fileForUrl(const QUrl &url) const;
+    File *addFile(const QUrl &url);
+    void removeFiles(int row, int count);
+    void clear();
+
+    /**
+     * Total number of diagnostics in all files
+     */
+    int diagnosticsCount() const
+    {
+        return m_entryCount;
+    }
+
+    void addProvider(File *file, DiagnosticsProvider *provider);
+    void appendDiagnostics(File *file, DiagnosticsProvider *provider, const QList<Diagnostic> &diagnostics);
+
+    /**
+     * Remove diagnostics of @p provider. If @p provider is null, remove all diagnostics
+     * of the file except the ones whose provider has persistentDiagnostics().
+     * @return number of removed diagnostics
+     */
+    int removeDiagnosticsForProvider(File *file, DiagnosticsProvider *provider);
+
+    /**
+     * Replace the diagnostics of @p provider by @p diagnostics. Entries that are
+     * unchanged (same range, severity, code, source, message and related information)
+     * stay where they are, the others are removed and the new ones appended
+     * from row @p firstAdded on. The related information of the removed entries
+     * goes to @p removedRelated, if given.
+     * @return the removed entries
+     */
+    std::vector<Entry> updateDiagnostics(File *file,
+                                         DiagnosticsProvider *provider,
+                                         const QList<Diagnostic> &diagnostics,
+                                         int &firstAdded,
+                                         std::vector<DiagnosticRelatedInformation> *removedRelated = nullptr);
+
+    /**
+     * Update which diagnostics are enabled, i.e., not suppressed.
+     * @p enabled has an element for every diagnostic from @p firstRow on
+     */
+    void setDiagnosticsEnabled(File *file, int firstRow, const std::vector<bool> &enabled);
+
+    /**
+     * Lines were inserted (@p delta > 0) or removed in the document of @p file,
+     * move whatever points into it from line @p line on by @p delta lines.
+     */
+    void shiftLines(File *file, int line, int delta);
+
+    /**
+     * Move the diagnostic in @p row, or its related information @p related
+     * if that is not -1, to where the document says it is now.
+     */
+    void setRange(File *file, int row, int related, KTextEditor::Range range);
+
+    QString string(quint32 id) const
+    {
+        return m_strings[id];
+    }
+    int rowOfEntry(const File *file, quint32 id) const;
+    Diagnostic diagnostic(const File *file, int row) const;
+    const std::vector<ChildRow> &children(File *file, int row) const;
+    void addFixes(File *file, int row, const QList<DiagnosticFix> &fixes);
+    QList<DiagnosticFix> fixes(File *file, int row) const;
+
+    ItemKind kind(const QModelIndex &index) const;
+    // the file of an index of any level
+    File *fileForIndex(const QModelIndex &index) const;
+    // the diagnostic row of a diagnostic or child index, -1 otherwise
+    int entryRowForIndex(const QModelIndex &index) const;
+    QModelIndex indexForFile(const File *file) const;
+    QModelIndex indexForEntry(const File *file, int row) const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = {}) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = {}) const override;
+    int columnCount(const QModelIndex &parent = {}) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+private:
+    std::vector<Entry> removeEntries(File *file, const std::vector<bool> &remove, std::vector<DiagnosticRelatedInformation> *removedRelated = nullptr);
+    quint32 intern(const QString &s);
+    void compactStrings();
+    Children &childrenFor(File *file, int row) const;
+    void updateChildRows(File *file);
+
+    std::vector<std::unique_ptr<File>> m_files;
+    QHash<QString, File *> m_filesByPath;
+
+    // id 0 is the empty string
+    std::vector<QString> m_strings;
+    QHash<QString, quint32> m_stringIds;
+
+    int m_entryCount = 0;
+    quint32 m_nextEntryId = 0;
+};
@@ -5,8 +5,8 @@
 */
 #include "diagnosticview.h"
 
-#include "diagnosticitem.h"
 #include "drawing_utils.h"
+#include "ktexteditor_utils.h"
 // #include "kateapp.h"
 // #include "kateviewmanager.h"
 #include "session_diagnostic_suppression.h"
@@ -30,6 +30,7 @@
 #include <QLineEdit>
 #include <QMenu>
 #include <QPainter>
+#include <QSet>
 #include <QSortFilterProxyModel>
 #include <QStyledItemDelegate>
 #include <QTextLayout>
@@ -109,51 +110,31 @@ public:
 
     bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override
     {
+        auto model = static_cast<DiagnosticsModel *>(sourceModel());
         bool ret = true;
-        auto model = static_cast<QStandardItemModel *>(sourceModel());
-        if (activeProvider) {
-            auto index = sourceModel()->index(sourceRow, 0, sourceParent);
-            if (index.isValid()) {
-                const auto item = model->itemFromIndex(index);
-                if (item->type() == DiagnosticItem_File) {
-                    ret = static_cast<DocumentDiagnosticItem *>(item)->providers().contains(activeProvider);
-                } else {
-                    // check parent item if the item is not diag
-                    if (item->type() != DiagnosticItem_Diag && item->parent()) {
-                        Q_ASSERT(item->parent()->type() == DiagnosticItem_Diag);
-                        index = item->parent()->index();
-                    }
-                    ret = index.data(DiagnosticModelRole::ProviderRole).value<DiagnosticsProvider *>() == activeProvider;
-                }
+        switch (model->kind(sourceParent)) {
+        case DiagnosticsModel::ItemKind::Invalid: {
+            const auto file = model->fileAt(sourceRow);
+            if (activeProvider) {
+                ret = file->providers.contains(activeProvider);
             }
-        }
-
-        if (ret && severity != DiagnosticSeverity::Unknown) {
-            auto index = sourceModel()->index(sourceRow, 0, sourceParent);
-            const auto item = model->itemFromIndex(index);
-            if (item && item->type() == DiagnosticItem_Diag) {
-                auto castedItem = static_cast<DiagnosticItem *>(item);
-                ret = castedItem->m_diagnostic.severity == severity;
-            } else if (item && item->type() == DiagnosticItem_File) {
+            if (ret && severity != DiagnosticSeverity::Unknown) {
                 // Hide parent if all childs hidden
-                int rc = item->rowCount();
-                int count = 0;
-                for (int i = 0; i < rc; ++i) {
-                    auto child = item->child(i);
-                    if (child && child->type() == DiagnosticItem_Diag) {
-                        count += static_cast<DiagnosticItem *>(child)->m_diagnostic.severity == severity;
-                    }
-                }
-                ret = count > 0;
-            } else if (item) {
-                ret = false;
-                if (item->parent() && item->parent()->type() == DiagnosticItem_Diag) {
-                    auto castedItem = static_cast<DiagnosticItem *>(item);
-                    ret = castedItem->m_diagnostic.severity == severity;
-                }
-            } else {
-                ret = false;
+                ret = std::any_of(file->diagnostics.begin(), file->diagnostics.end(), [this](const DiagnosticsModel::Entry &e) {
+                    return e.severity == severity;
+                });
             }
+            break;
+        }
+        case DiagnosticsModel::ItemKind::File:
+            ret = acceptsDiagnostic(model->fileAt(sourceParent.row())->diagnostics[sourceRow]);
+            break;
+        case DiagnosticsModel::ItemKind::Diagnostic:
+            // rows below a diagnostic follow the diagnostic
+            ret = acceptsDiagnostic(model->fileForIndex(sourceParent)->diagnostics[sourceParent.row()]);
+            break;
+        case DiagnosticsModel::ItemKind::Child:
+            break;
         }
 
         if (ret) {
@@ -163,6 +144,18 @@ public:
     }
 
 private:
+    bool acceptsDiagnostic(const DiagnosticsModel::Entry &e) const
+    {
+        // suppressed diagnostics are hidden
+        if (!e.enabled) {
+            return false;
+        }
+        if (activeProvider && e.provider != activeProvider) {
+            return false;
+        }
+        return severity == DiagnosticSeverity::Unknown || e.severity == severity;
+    }
+
     DiagnosticsProvider *activeProvider = nullptr;
     DiagnosticSeverity severity = DiagnosticSeverity::Unknown;
 };
@@ -195,8 +188,9 @@ static constexpr KTextEditor::Document::MarkTypes markTypeDiagAll =
     KTextEditor::Document::MarkTypes(markTypeDiagError | markTypeDiagWarning | markTypeDiagOther);
 
 struct DiagModelIndex {
-    int row;
-    int parentRow;
+    QUrl url;
+    // DiagnosticsModel::Entry::id, the row might change until the fixes arrive
+    quint32 id;
     bool autoApply;
 };
 Q_DECLARE_METATYPE(DiagModelIndex)
@@ -248,28 +242,6 @@ private:
     QFont m_monoFont;
 };
 
-static QIcon diagnosticsIcon(DiagnosticSeverity severity)
-{
-    switch (severity) {
-    case DiagnosticSeverity::Error: {
-        static QIcon icon(QIcon::fromTheme(QStringLiteral("data-error"), QIcon::fromTheme(QStringLiteral("dialog-error"))));
-        return icon;
-    }
-    case DiagnosticSeverity::Warning: {
-        static QIcon icon(QIcon::fromTheme(QStringLiteral("data-warning"), QIcon::fromTheme(QStringLiteral("dialog-warning"))));
-        return icon;
-    }
-    case DiagnosticSeverity::Information:
-    case DiagnosticSeverity::Hint: {
-        static QIcon icon(QIcon::fromTheme(QStringLiteral("data-information"), QIcon::fromTheme(QStringLiteral("dialog-information"))));
-        return icon;
-    }
-    default:
-        break;
-    }
-    return QIcon();
-}
-
 DiagnosticsView::DiagnosticsView(QWidget *parent, KTextEditor::MainWindow *mainWindow)
     : QWidget(parent)
     , KXMLGUIClient()
@@ -309,8 +281,6 @@ DiagnosticsView::DiagnosticsView(QWidget *parent, KTextEditor::MainWindow *mainW
         m_proxy->setFilterRegularExpression(m_filterLineEdit->text());
     });
 
-    m_model.setColumnCount(1);
-
     m_diagnosticsTree->setHeaderHidden(true);
     m_diagnosticsTree->setFocusPolicy(Qt::NoFocus);
     m_diagnosticsTree->setLayoutDirection(Qt::LeftToRight);
@@ -517,7 +487,13 @@ void DiagnosticsView::setupDiagnosticViewToolbar(QVBoxLayout *mainLayout)
     m_clearButton->setToolTip(i18nc("@info:tooltip", "Clear diagnostics"));
     m_clearButton->setIcon(QIcon::fromTheme(QStringLiteral("edit-clear-all")));
     connect(m_clearButton, &QToolButton::clicked, this, [this] {
-        std::vector<KTextEditor::Document *> docs(m_diagnosticsMarks.begin(), m_diagnosticsMarks.end());
+        auto docs = m_diagnosticsRanges.keys();
+        const auto marked = m_diagnosticsMarks.keys();
+        for (auto d : marked) {
+            if (!docs.contains(d)) {
+                docs.push_back(d);
+            }
+        }
         for (auto d : docs) {
             clearAllMarks(d);
         }
@@ -531,12 +507,23 @@ void DiagnosticsView::setupDiagnosticViewToolbar(QVBoxLayout *mainLayout)
 void DiagnosticsView::onViewChanged(KTextEditor::View *v)
 {
     disconnect(posChangedConnection);
+    disconnect(scrollConnection);
     m_posChangedTimer->stop();
     if (v) {
         posChangedConnection = connect(v, &KTextEditor::View::cursorPositionChanged, this, [this] {
             m_posChangedTimer->start();
         });
         m_posChangedTimer->start();
+
+        // underlines only exist around the visible lines
+        scrollConnection = connect(v, &KTextEditor::View::verticalScrollPositionChanged, this, [this](KTextEditor::View *view) {
+            if (m_diagnosticsRanges.contains(view->document())) {
+                updateUnderlines(view->document(), false);
+            }
+        });
+        if (m_diagnosticsRanges.contains(v->document())) {
+            updateUnderlines(v->document(), false);
+        }
     }
 
     if (v && v->document()) {
@@ -621,79 +608,30 @@ void DiagnosticsView::tabForToolViewAdded(QWidget *toolView, QWidget *tab)
 {
     if (parent() == toolView) {
         m_tabButtonOverlay = new DiagTabOverlay(tab);
-        m_tabButtonOverlay->setActive(!isVisible() && m_model.rowCount() > 0);
+        m_tabButtonOverlay->setActive(!isVisible() && m_model.fileCount() > 0);
     }
 }
 
-static DocumentDiagnosticItem *getItem(const QStandardItemModel &model, const QUrl &url)
+static int findDiagnostic(const DiagnosticsModel::File *file, KTextEditor::Cursor pos, bool onlyLine, DiagnosticSeverity severity = DiagnosticSeverity::Unknown)
 {
-    // local file in custom role, Qt::DisplayRole might have additional elements
-    auto l = model.match(model.index(0, 0, QModelIndex()), Qt::UserRole, url.toString(QUrl::PreferLocalFile | QUrl::RemovePassword), 1, Qt::MatchExactly);
-    if (!l.empty()) {
-        return static_cast<DocumentDiagnosticItem *>(model.itemFromIndex(l.at(0)));
+    if (!file) {
+        return -1;
     }
-    return nullptr;
-}
-
-static QStandardItem *getItem(const QStandardItem *topItem, KTextEditor::Cursor pos, bool onlyLine, DiagnosticSeverity severity = DiagnosticSeverity::Unknown)
-{
-    QStandardItem *targetItem = nullptr;
-    if (topItem) {
-        int count = topItem->rowCount();
-        int first = 0, last = count;
-        // let's not run wild on a linear search in a flood of diagnostics
-        if (count > 50) {
-            // instead, let's *assume* sorted and use binary search to get closer
-            // it probably is sorted, so it should work out
-            // if not, at least we tried (without spending/wasting more on sorting)
-            auto getLine = [topItem, count](int index) {
-                Q_ASSERT(index >= 0);
-                Q_ASSERT(index < count);
-                auto range = topItem->child(index)->data(DiagnosticModelRole::RangeRole).value<KTextEditor::Range>();
-                return range.start().line();
-            };
-            int first = 0, last = count - 1;
-            int target = pos.line();
-            while (first + 1 < last) {
-                int middle = first + ((last - first) / 2);
-                Q_ASSERT(first != middle);
-                Q_ASSERT(middle != last);
-                if (getLine(middle) < target) {
-                    first = middle;
-                } else {
-                    last = middle;
-                }
-            }
+    const auto &diags = file->diagnostics;
+    for (int i = 0; i < (int)diags.size(); ++i) {
+        const auto &e = diags[i];
+        if (!e.enabled) {
+            continue;
         }
-        for (int i = first; i < last; ++i) {
-            auto item = topItem->child(i);
-            if (!(item->flags() & Qt::ItemIsEnabled)) {
+        if ((onlyLine && pos.line() == e.range.start().line()) || (e.range.contains(pos))) {
+            // the severity must match if it was specified
+            if (severity != DiagnosticSeverity::Unknown && e.severity != severity) {
                 continue;
             }
-
-            auto range = item->data(DiagnosticModelRole::RangeRole).value<KTextEditor::Range>();
-            if ((onlyLine && pos.line() == range.start().line()) || (range.contains(pos))) {
-                // the severity must match if it was specified
-                if (severity != DiagnosticSeverity::Unknown && item->type() == DiagnosticItem_Diag
-                    && static_cast<DiagnosticItem *>(item)->m_diagnostic.severity != severity) {
-                    continue;
-                }
-                targetItem = item;
-                break;
-            }
+            return i;
         }
     }
-    return targetItem;
-}
-
-static void fillItemRoles(QStandardItem *item, const QUrl &url, const KTextEditor::Range _range, DiagnosticSeverity kind)
-{
-    // auto range = snapshot ? transformRange(url, *snapshot, _range) : _range;
-    item->setData(QVariant(url), DiagnosticModelRole::FileUrlRole);
-    QVariant vrange;
-    vrange.setValue(_range);
-    item->setData(vrange, DiagnosticModelRole::RangeRole);
-    item->setData(QVariant::fromValue(kind), DiagnosticModelRole::KindRole);
+    return -1;
 }
 
 void DiagnosticsView::onFixesAvailable(const QList<DiagnosticFix> &fixes, const QVariant &data)
@@ -702,18 +640,10 @@ void DiagnosticsView::onFixesAvailable(const QList<DiagnosticFix> &fixes, const
         return;
     }
     const auto diagModelIdx = data.value<DiagModelIndex>();
-    if (diagModelIdx.parentRow == -1) {
-        qWarning() << "Unexpected -1 parentRow";
-        return;
-    }
-    const auto parentIdx = m_model.index(diagModelIdx.parentRow, 0);
-    const auto idx = m_model.index(diagModelIdx.row, 0, parentIdx);
-    if (!idx.isValid()) {
-        qWarning() << Q_FUNC_INFO << "Unexpected invalid idx";
-        return;
-    }
-    const auto item = m_model.itemFromIndex(idx);
-    if (!item) {
+    auto file = m_model.fileForUrl(diagModelIdx.url);
+    const int row = file ? m_model.rowOfEntry(file, diagModelIdx.id) : -1;
+    if (row == -1) {
+        // the diagnostic is gone in the meantime
         return;
     }
     bool autoApply = diagModelIdx.autoApply;
@@ -725,15 +655,7 @@ void DiagnosticsView::onFixesAvailable(const QList<DiagnosticFix> &fixes, const
         }
         return;
     }
-    for (const auto &fix : fixes) {
-        if (!fix.fixCallback) {
-            continue;
-        }
-        auto f = new DiagnosticFixItem;
-        f->fix = fix;
-        f->setText(fix.fixTitle);
-        item->appendRow(f);
-    }
+    m_model.addFixes(file, row, fixes);
 }
 
 void DiagnosticsView::showFixesInMenu(const QList<DiagnosticFix> &fixes)
@@ -761,63 +683,62 @@ void DiagnosticsView::quickFix()
         return;
     }
 
-    QStandardItem *topItem = getItem(m_model, document->url());
+    auto file = m_model.fileForUrl(document->url());
 
     // try to find current diagnostic based on cursor position
     auto pos = activeView->cursorPosition();
-    QStandardItem *targetItem = getItem(topItem, pos, false);
-    if (!targetItem) {
+    int row = findDiagnostic(file, pos, false);
+    if (row == -1) {
         // match based on line position only
-        targetItem = getItem(topItem, pos, true);
+        row = findDiagnostic(file, pos, true);
     }
 
-    if (targetItem && targetItem->type() == DiagnosticItem_Diag) {
-        if (static_cast<DiagnosticItem *>(targetItem)->hasFixes()) {
-            QList<DiagnosticFix> fixes;
-            for (int i = 0; i < targetItem->rowCount(); ++i) {
-                auto item = targetItem->child(i);
-                if (item && item->type() == DiagnosticItem_Fix) {
-                    fixes << static_cast<DiagnosticFixItem *>(item)->fix;
-                }
-            }
+    if (row != -1) {
+        const auto fixes = m_model.fixes(file, row);
+        if (!fixes.isEmpty()) {
             if (fixes.size() > 1) {
                 showFixesInMenu(fixes);
             } else if (fixes.size() == 1 && fixes[0].fixCallback) {
                 fixes[0].fixCallback();
             }
         } else {
-            onDoubleClicked(m_model.indexFromItem(targetItem), true);
+            onDoubleClicked(m_model.indexForEntry(file, row), true);
         }
     }
 }
 
 void DiagnosticsView::onDoubleClicked(const QModelIndex &index, bool quickFix)
 {
-    auto itemFromIndex = m_model.itemFromIndex(index);
-    if (!itemFromIndex) {
+    auto file = m_model.fileForIndex(index);
+    if (!file) {
         qWarning() << "invalid item clicked";
         return;
     }
 
-    if (itemFromIndex->type() == DiagnosticItem_Diag) {
-        if (static_cast<DiagnosticItem *>(itemFromIndex)->hasFixes()) {
+    const auto kind = m_model.kind(index);
+    if (kind == DiagnosticsModel::ItemKind::Diagnostic) {
+        const int row = index.row();
+        if (!m_model.fixes(file, row).isEmpty()) {
             return;
         }
-        auto provider = index.data(DiagnosticModelRole::ProviderRole).value<DiagnosticsProvider *>();
+        const auto &e = file->diagnostics[row];
+        auto provider = e.provider;
         if (!provider) {
             return;
         }
-        auto item = static_cast<DiagnosticItem *>(itemFromIndex);
         DiagModelIndex idx;
-        idx.row = item->row();
-        idx.parentRow = item->parent() ? item->parent()->row() : -1;
+        idx.url = file->url;
+        idx.id = e.id;
         idx.autoApply = quickFix;
         QVariant data = QVariant::fromValue(idx);
-        Q_EMIT provider->requestFixes(item->data(DiagnosticModelRole::FileUrlRole).toUrl(), item->m_diagnostic, data);
+        Q_EMIT provider->requestFixes(file->url, m_model.diagnostic(file, row), data);
     }
 
-    if (itemFromIndex->type() == DiagnosticItem_Fix) {
-        static_cast<DiagnosticFixItem *>(itemFromIndex)->fix.fixCallback();
+    if (kind == DiagnosticsModel::ItemKind::Child) {
+        const auto &child = m_model.children(file, m_model.entryRowForIndex(index)).at(index.row());
+        if (child.fix) {
+            child.fix->fixCallback();
+        }
     }
 }
 
@@ -850,115 +771,106 @@ void DiagnosticsView::onDiagnosticsAdded(const FileDiagnostics &diagnostics)
     auto *provider = qobject_cast<DiagnosticsProvider *>(sender());
     Q_ASSERT(provider);
 
-    QStandardItemModel *model = &m_model;
-    DocumentDiagnosticItem *topItem = getItem(m_model, diagnostics.uri);
+    DiagnosticsModel::File *file = m_model.fileForUrl(diagnostics.uri);
 
     auto toProxyIndex = [this](const QModelIndex &index) {
         return m_proxy->mapFromSource(index);
     };
 
-    // current diagnostics row, if one of incoming diagnostics' document
-    int row = -1;
-    if (!topItem) {
+    // current diagnostic, if one of incoming diagnostics' document
+    QPersistentModelIndex current;
+    if (!file) {
         // no need to create an empty one
         if (diagnostics.diagnostics.empty()) {
             return;
         }
-        topItem = new DocumentDiagnosticItem();
-        model->appendRow(topItem);
-        QString prettyUri = diagnostics.uri.toString(QUrl::PreferLocalFile | QUrl::RemovePassword);
-        topItem->setText(prettyUri);
-        topItem->setData(prettyUri, Qt::UserRole);
+        file = m_model.addFile(diagnostics.uri);
     } else {
         // try to retain current position
         auto currentIndex = m_proxy->mapToSource(m_diagnosticsTree->currentIndex());
-        if (currentIndex.parent() == topItem->index()) {
-            row = currentIndex.row();
-        }
-
-        // Remove old diagnostics of this provider
-        if (!provider->m_persistentDiagnostics) {
-            int removedCount = topItem->removeItemsForProvider(provider);
-            m_diagnosticsCount -= removedCount;
-        }
-    }
-    topItem->addProvider(provider);
-    // emit so that proxy can update
-    m_model.dataChanged(topItem->index(), topItem->index());
-
-    QList<QStandardItem *> diagItems;
-    diagItems.reserve(diagnostics.diagnostics.size());
-    for (const auto &diag : diagnostics.diagnostics) {
-        auto item = new DiagnosticItem(diag);
-        diagItems.push_back(item);
-        QString source;
-        if (diag.source.length()) {
-            source = QStringLiteral("[%1] ").arg(diag.source);
-        }
-        if (diag.code.length()) {
-            source += QStringLiteral("(%1) ").arg(diag.code);
-        }
-        item->setData(diagnosticsIcon(diag.severity), Qt::DecorationRole);
-        // rendering of lines with embedded newlines does not work so well
-        // so ... split message by lines
-        auto lines = diag.message.split(QLatin1Char('\n'), Qt::SkipEmptyParts);
-        item->setText(source + (!lines.empty() ? lines[0] : QString()));
-        fillItemRoles(item, diagnostics.uri, diag.range, diag.severity);
-        item->setData(QVariant::fromValue(provider), DiagnosticModelRole::ProviderRole);
-        // add subsequent lines to subitems
-        // no metadata is added to these,
-        // as it can be taken from the parent (for marks and ranges)
-        for (int l = 1; l < lines.size(); ++l) {
-            auto subitem = new QStandardItem();
-            subitem->setText(lines[l]);
-            item->appendRow(subitem);
-        }
-        const auto &relatedInfo = diag.relatedInformation;
-        for (const auto &related : relatedInfo) {
-            if (related.location.uri.isEmpty()) {
-                continue;
-            }
-            auto relatedItemMessage = new QStandardItem();
+        if (currentIndex.parent() == m_model.indexForFile(file)) {
+            current = currentIndex;
+        }
+    }
+    m_model.addProvider(file, provider);
 
-            fillItemRoles(relatedItemMessage, related.location.uri, related.location.range, DiagnosticSeverity::Information);
+    auto app = KTextEditor::Editor::instance()->application();
+    const auto url = file->url;
+    auto fileDoc = app->findUrl(url);
+    // compare with where the diagnostics are now, edits may have moved them since
+    if (fileDoc) {
+        readBackUnderlines(fileDoc);
+    }
+
+    // only touch what changed, a republish after a small edit
+    // mostly consists of diagnostics we already have
+    const int countBefore = (int)file->diagnostics.size();
+    std::vector<DiagnosticsModel::Entry> removed;
+    std::vector<DiagnosticRelatedInformation> removedRelated;
+    int firstAdded = countBefore;
+    if (provider->m_persistentDiagnostics) {
+        m_model.appendDiagnostics(file, provider, diagnostics.diagnostics);
+    } else {
+        removed = m_model.updateDiagnostics(file, provider, diagnostics.diagnostics, firstAdded, &removedRelated);
+    }
+    const int count = (int)file->diagnostics.size();
+    m_diagnosticsCount += count - countBefore;
 
-            auto basename = QFileInfo(related.location.uri.toLocalFile()).fileName();
-            // display line number is 1-based (as opposed to internal 0-based)
-            auto location = QStringLiteral("%1:%2").arg(basename).arg(related.location.range.start().line() + 1);
-            relatedItemMessage->setText(QStringLiteral("[%1] %2").arg(location).arg(related.message));
-            relatedItemMessage->setData(diagnosticsIcon(DiagnosticSeverity::Information), Qt::DecorationRole);
-            item->appendRow(relatedItemMessage);
+    // the others were checked already
+    if (auto suppressions = file->suppressionEnabled ? file->diagnosticSuppression.get() : nullptr) {
+        std::vector<QString> texts;
+        std::vector<KTextEditor::Range> ranges;
+        texts.reserve(count - firstAdded);
+        ranges.reserve(count - firstAdded);
+        for (int i = firstAdded; i < count; ++i) {
+            const auto &e = file->diagnostics[i];
+            texts.push_back(m_model.string(e.text));
+            ranges.push_back(e.range);
         }
+        auto enabled = suppressions->match(texts, ranges, fileDoc);
+        enabled.flip();
+        m_model.setDiagnosticsEnabled(file, firstAdded, enabled);
     }
-    m_diagnosticsCount += diagItems.size();
-    topItem->appendRows(diagItems);
 
     // TODO perhaps add some custom delegate that only shows 1 line
     // and only the whole text when item selected ??
-    m_diagnosticsTree->expandRecursively(toProxyIndex(topItem->index()), 1);
+    m_diagnosticsTree->expand(toProxyIndex(m_model.indexForFile(file)));
+    for (int i = firstAdded; i < count; ++i) {
+        const auto index = m_model.indexForEntry(file, i);
+        if (m_model.rowCount(index) > 0) {
+            m_diagnosticsTree->expand(toProxyIndex(index));
+        }
+    }
+
+    // only hide if really nothing below
+    if (count == 0) {
+        m_model.removeFiles(file->row, 1);
+        file = nullptr;
+    }
+
+    if (fileDoc) {
+        if (file) {
+            updateDocumentMarks(fileDoc, file, removed, removedRelated, firstAdded);
+        } else {
+            clearAllMarks(fileDoc);
+        }
+    }
 
-    // topItem might be removed after this
-    updateDiagnosticsState(topItem);
     // also sync updated diagnostic to current position
     auto currentView = m_mainWindow->activeView();
-    if (topItem && currentView && currentView->document()) {
+    if (file && currentView && currentView->document()) {
         if (!syncDiagnostics(currentView->document(), currentView->cursorPosition(), false, false)) {
             // avoid jitter; only restore previous if applicable
-            if (row >= 0 && row < topItem->rowCount()) {
-                m_diagnosticsTree->scrollTo(toProxyIndex(topItem->child(row)->index()));
+            if (current.isValid()) {
+                m_diagnosticsTree->scrollTo(toProxyIndex(current));
             }
         }
     }
     if (m_tabButtonOverlay) {
-        m_tabButtonOverlay->setActive(!isVisible() && m_model.rowCount() > 0);
+        m_tabButtonOverlay->setActive(!isVisible() && m_model.fileCount() > 0);
     }
 }
 
-static auto getProvider(QStandardItem *item)
-{
-    return item->data(DiagnosticModelRole::ProviderRole).value<DiagnosticsProvider *>();
-}
-
 void DiagnosticsView::clearDiagnosticsForStaleDocs(const QList<QString> &filesToKeep, DiagnosticsProvider *provider)
 {
     auto diagWarnShowGuard = qScopeGuard([this] {
@@ -972,15 +884,15 @@ void DiagnosticsView::clearDiagnosticsForStaleDocs(const QList<QString> &filesTo
         }
     });
 
-    auto all_diags_from_provider = [provider](DocumentDiagnosticItem *file) {
-        if (file->rowCount() == 0) {
+    auto all_diags_from_provider = [provider](const DiagnosticsModel::File *file) {
+        if (file->diagnostics.empty()) {
             return true;
         }
-        if (provider && file->providers().size() == 1 && file->providers().contains(provider)) {
+        if (provider && file->providers.size() == 1 && file->providers.contains(provider)) {
             return true;
         }
         if (!provider) {
-            const QList<DiagnosticsProvider *> &providers = file->providers();
+            const QList<DiagnosticsProvider *> &providers = file->providers;
             return std::all_of(providers.begin(), providers.end(), [](DiagnosticsProvider *p) {
                 return !p->persistentDiagnostics();
             });
@@ -988,12 +900,12 @@ void DiagnosticsView::clearDiagnosticsForStaleDocs(const QList<QString> &filesTo
         return false;
     };
 
-    auto bulk_remove = [this](QStandardItemModel *model, int &start, int &count, int &i) {
+    auto bulk_remove = [this](int &start, int &count, int &i) {
         if (start > -1 && count != 0) {
             for (int r = start; r < (start + count); r++) {
-                m_diagnosticsCount -= model->item(r)->rowCount();
+                m_diagnosticsCount -= (int)m_model.fileAt(r)->diagnostics.size();
             }
-            model->removeRows(start, count);
+            m_model.removeFiles(start, count);
             i = start - 1; // reset i
         }
         start = -1;
@@ -1002,14 +914,14 @@ void DiagnosticsView::clearDiagnosticsForStaleDocs(const QList<QString> &filesTo
 
     int start = -1, count = 0;
 
-    for (int i = 0; i < m_model.rowCount(); ++i) {
-        auto fileItem = static_cast<DocumentDiagnosticItem *>(m_model.item(i));
-        if (!filesToKeep.contains(fileItem->data(Qt::UserRole).toString())) {
-            if (!all_diags_from_provider(fileItem)) {
-                // If the diagnostics of this file item are from multiple providers
+    for (int i = 0; i < m_model.fileCount(); ++i) {
+        auto file = m_model.fileAt(i);
+        if (!filesToKeep.contains(file->path)) {
+            if (!all_diags_from_provider(file)) {
+                // If the diagnostics of this file are from multiple providers
                 // delete the ones from @p provider
-                bulk_remove(&m_model, start, count, i);
-                int removedCount = fileItem->removeItemsForProvider(provider);
+                bulk_remove(start, count, i);
+                int removedCount = m_model.removeDiagnosticsForProvider(file, provider);
                 m_diagnosticsCount -= removedCount;
             } else {
                 if (start == -1) {
@@ -1018,21 +930,21 @@ void DiagnosticsView::clearDiagnosticsForStaleDocs(const QList<QString> &filesTo
                 count += 1;
             }
         } else {
-            bulk_remove(&m_model, start, count, i);
+            bulk_remove(start, count, i);
         }
     }
 
     if (start != -1 && count != 0) {
         for (int r = start; r < (start + count); r++) {
-            m_diagnosticsCount -= m_model.item(r)->rowCount();
+            m_diagnosticsCount -= (int)m_model.fileAt(r)->diagnostics.size();
         }
-        m_model.removeRows(start, count);
+        m_model.removeFiles(start, count);
     }
 
     updateMarks();
 
     if (m_tabButtonOverlay) {
-        m_tabButtonOverlay->setActive(!isVisible() && m_model.rowCount() > 0);
+        m_tabButtonOverlay->setActive(!isVisible() && m_model.fileCount() > 0);
     }
 }
 
@@ -1040,46 +952,35 @@ void DiagnosticsView::clearSuppressionsFromProvider(DiagnosticsProvider *provide
 {
     // need to clear suppressions
     // will be filled again at suitable time by re-requesting provider
-    for (int i = 0; i < m_model.rowCount(); ++i) {
-        auto item = m_model.item(i);
-        if (item->type() != DiagnosticItem_File) {
-            continue;
-        }
-        auto fileItem = static_cast<DocumentDiagnosticItem *>(item);
-        if (getProvider(fileItem) == provider) {
-            fileItem->diagnosticSuppression.reset();
+    for (int i = 0; i < m_model.fileCount(); ++i) {
+        auto file = m_model.fileAt(i);
+        if (file->providers.contains(provider)) {
+            file->diagnosticSuppression.reset();
         }
     }
 }
 
-void DiagnosticsView::addMarks(KTextEditor::Document *doc, QStandardItem *item)
+static KTextEditor::Document::MarkTypes markTypeForSeverity(DiagnosticSeverity severity)
 {
-    Q_ASSERT(item);
-    using Style = KSyntaxHighlighting::Theme::TextStyle;
-
-    // only consider enabled items
-    if (!(item->flags() & Qt::ItemIsEnabled)) {
-        return;
-    }
-
-    const auto url = item->data(DiagnosticModelRole::FileUrlRole).toUrl().toDisplayString(QUrl::PreferLocalFile | QUrl::PrettyDecoded | QUrl::RemovePassword);
-    const auto docUrl = doc->url().toDisplayString(QUrl::PreferLocalFile | QUrl::PrettyDecoded | QUrl::RemovePassword);
-    // document url could end up empty while in intermediate reload state
-    // (and then it might match a parent item with no RangeData at all)
-    if (url != docUrl || url.isEmpty()) {
-        return;
-    }
-
-    const auto range = item->data(DiagnosticModelRole::RangeRole).value<KTextEditor::Range>();
-    if (!range.isValid()) {
-        return;
+    switch (severity) {
+    case DiagnosticSeverity::Error:
+        return markTypeDiagError;
+    case DiagnosticSeverity::Warning:
+        return markTypeDiagWarning;
+    case DiagnosticSeverity::Information:
+    case DiagnosticSeverity::Hint:
+        return markTypeDiagOther;
+    case DiagnosticSeverity::Unknown:
+        break;
     }
+    return KTextEditor::Document::MarkTypes(0);
+}
 
-    KTextEditor::Attribute::Ptr attr;
-    KTextEditor::Document::MarkTypes markType = markTypeDiagWarning;
+static KTextEditor::Attribute::Ptr underlineAttribute(DiagnosticSeverity severity)
+{
+    using Style = KSyntaxHighlighting::Theme::TextStyle;
 
-    const auto kind = item->data(DiagnosticModelRole::KindRole).value<DiagnosticSeverity>();
-    switch (kind) {
+    switch (severity) {
     // use underlining for diagnostics to avoid lots of fancy flickering
     case DiagnosticSeverity::Error: {
         static KTextEditor::Attribute::Ptr errorAttr;
@@ -1089,9 +990,7 @@ void DiagnosticsView::addMarks(KTextEditor::Document *doc, QStandardItem *item)
             errorAttr->setUnderlineColor(theme.textColor(Style::Error));
             errorAttr->setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
         }
-        attr = errorAttr;
-        markType = markTypeDiagError;
-        break;
+        return errorAttr;
     }
     case DiagnosticSeverity::Warning: {
         static KTextEditor::Attribute::Ptr warnAttr;
@@ -1101,9 +1000,7 @@ void DiagnosticsView::addMarks(KTextEditor::Document *doc, QStandardItem *item)
             warnAttr->setUnderlineColor(theme.textColor(Style::Warning));
             warnAttr->setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
         }
-        attr = warnAttr;
-        markType = markTypeDiagWarning;
-        break;
+        return warnAttr;
     }
     case DiagnosticSeverity::Information:
     case DiagnosticSeverity::Hint: {
@@ -1114,57 +1011,153 @@ void DiagnosticsView::addMarks(KTextEditor::Document *doc, QStandardItem *item)
             infoAttr->setUnderlineColor(theme.textColor(Style::Information));
             infoAttr->setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
         }
-        attr = infoAttr;
-        markType = markTypeDiagOther;
-        break;
+        return infoAttr;
     }
     case DiagnosticSeverity::Unknown:
         qWarning() << "Unknown diagnostic severity";
+        break;
+    }
+    return {};
+}
+
+// index in the mark counts of a line, -1 for no mark
+static int markIndex(KTextEditor::Document::MarkTypes type)
+{
+    if (type == markTypeDiagError) {
+        return 0;
+    } else if (type == markTypeDiagWarning) {
+        return 1;
+    } else if (type == markTypeDiagOther) {
+        return 2;
+    }
+    return -1;
+}
+
+static uint markTypes(const std::array<int, 3> &counts)
+{
+    return (counts[0] ? markTypeDiagError : 0) | (counts[1] ? markTypeDiagWarning : 0) | (counts[2] ? markTypeDiagOther : 0);
+}
+
+// the way KTextEditor moves the marks as lines are inserted or removed
+static void shiftMarkCounts(QHash<int, std::array<int, 3>> &counts, int line, int delta)
+{
+    QHash<int, std::array<int, 3>> shifted;
+    shifted.reserve(counts.size());
+    for (auto it = counts.cbegin(); it != counts.cend(); ++it) {
+        // marks of joined lines are merged
+        auto &c = shifted[it.key() >= line ? it.key() + delta : it.key()];
+        for (size_t i = 0; i < c.size(); ++i) {
+            c[i] += it.value()[i];
+        }
+    }
+    counts = std::move(shifted);
+}
+
+static void setMarkDescriptions(KTextEditor::Document *doc)
+{
+    doc->setMarkDescription(markTypeDiagError, i18n("Error"));
+    doc->setMarkIcon(markTypeDiagError, diagnosticsIcon(DiagnosticSeverity::Error));
+    doc->setMarkDescription(markTypeDiagWarning, i18n("Warning"));
+    doc->setMarkIcon(markTypeDiagWarning, diagnosticsIcon(DiagnosticSeverity::Warning));
+    doc->setMarkDescription(markTypeDiagOther, i18n("Information"));
+    doc->setMarkIcon(markTypeDiagOther, diagnosticsIcon(DiagnosticSeverity::Information));
+}
+
+void DiagnosticsView::addMark(KTextEditor::Document *doc, KTextEditor::Range range, KTextEditor::Document::MarkTypes type)
+{
+    auto marks = m_diagnosticsMarks.find(doc);
+    const int index = markIndex(type);
+    if (marks == m_diagnosticsMarks.end() || index < 0 || !range.isValid()) {
         return;
     }
+    const int line = range.start().line();
+    if (marks.value()[line][index]++ == 0) {
+        doc->addMark(line, type);
+    }
+}
 
-    if (!attr) {
-        qWarning() << "Unexpected null attr";
+void DiagnosticsView::removeMark(KTextEditor::Document *doc, KTextEditor::Range range, KTextEditor::Document::MarkTypes type)
+{
+    auto marks = m_diagnosticsMarks.find(doc);
+    const int index = markIndex(type);
+    if (marks == m_diagnosticsMarks.end() || index < 0 || !range.isValid()) {
+        return;
+    }
+    const int line = range.start().line();
+    auto counts = marks->find(line);
+    if (counts == marks->end() || counts.value()[index] == 0) {
+        return;
+    }
+    // a line keeps the mark types other diagnostics still need
+    if (--counts.value()[index] == 0) {
+        doc->removeMark(line, type);
+        if (!markTypes(counts.value())) {
+            marks->erase(counts);
+        }
+    }
+}
+
+void DiagnosticsView::updateDocumentMarks(KTextEditor::Document *doc)
+{
+    // document url could end up empty while in intermediate reload state
+    const auto docUrl = doc->url();
+    auto file = docUrl.isEmpty() ? nullptr : m_model.fileForUrl(docUrl);
+    if (!file) {
+        clearAllMarks(doc);
+        return;
     }
 
-    // highlight the range
-    if (attr) {
-        KTextEditor::Range highlightedRange = range;
-        if (range.isEmpty()) {
-            auto end = highlightedRange.end();
-            end.setColumn(doc->lineLength(highlightedRange.start().line()));
-            highlightedRange.setEnd(end);
+    // every diagnostic gets its mark, wherever it is
+    QHash<int, std::array<int, 3>> counts;
+    for (const auto &e : file->diagnostics) {
+        // only consider enabled items
+        if (!e.enabled) {
+            continue;
+        }
+        const int index = markIndex(markTypeForSeverity(e.severity));
+        if (e.range.isValid() && index >= 0) {
+            counts[e.range.start().line()][index]++;
+        }
+        // related information might point into this document as well
+        for (quint32 i = e.relatedBegin; i < e.relatedBegin + e.relatedCount; ++i) {
+            const auto &location = file->related[i].location;
+            if (location.uri == docUrl && location.range.isValid()) {
+                counts[location.range.start().line()][markIndex(markTypeDiagOther)]++;
+            }
         }
-        KTextEditor::MovingRange *mr = doc->newMovingRange(highlightedRange);
-        mr->setZDepth(-90000.0); // Set the z-depth to slightly worse than the selection
-        mr->setAttribute(attr);
-        mr->setAttributeOnlyForViews(true);
-        m_diagnosticsRanges[doc].push_back(mr);
     }
 
-    auto iface = doc;
-    // add match mark for range
-    switch (markType) {
-    case markTypeDiagError:
-        iface->setMarkDescription(markType, i18n("Error"));
-        iface->setMarkIcon(markType, diagnosticsIcon(DiagnosticSeverity::Error));
-        break;
-    case markTypeDiagWarning:
-        iface->setMarkDescription(markType, i18n("Warning"));
-        iface->setMarkIcon(markType, diagnosticsIcon(DiagnosticSeverity::Warning));
-        break;
-    case markTypeDiagOther:
-        iface->setMarkDescription(markType, i18n("Information"));
-        iface->setMarkIcon(markType, diagnosticsIcon(DiagnosticSeverity::Information));
-        break;
-    default:
-        Q_ASSERT(false);
-        break;
+    if (!counts.isEmpty()) {
+        setMarkDescriptions(doc);
     }
 
-    const auto line = range.start().line();
-    iface->addMark(line, markType);
-    m_diagnosticsMarks.insert(doc);
+    // only touch the lines whose marks change
+    std::vector<std::pair<int, uint>> current;
+    const QHash<int, KTextEditor::Mark *> marks = doc->marks();
+    for (auto mark : marks) {
+        if (mark->type & markTypeDiagAll) {
+            current.emplace_back(mark->line, mark->type & markTypeDiagAll);
+        }
+    }
+    QSet<int> seen;
+    for (const auto &[line, have] : current) {
+        seen.insert(line);
+        auto c = counts.constFind(line);
+        const uint want = c != counts.cend() ? markTypes(c.value()) : 0;
+        if (have & ~want) {
+            doc->removeMark(line, have & ~want);
+        }
+        if (want & ~have) {
+            doc->addMark(line, want & ~have);
+        }
+    }
+    for (auto it = counts.cbegin(); it != counts.cend(); ++it) {
+        if (!seen.contains(it.key())) {
+            doc->addMark(it.key(), markTypes(it.value()));
+        }
+    }
+    // tracked even without marks, so later publishes only apply what changed
+    m_diagnosticsMarks.insert(doc, std::move(counts));
 
     // ensure runtime match
     using Doc = KTextEditor::Document;
@@ -1175,28 +1168,268 @@ void DiagnosticsView::addMarks(KTextEditor::Document *doc, QStandardItem *item)
     // reload might save/restore marks before/after above signals, so let's clear before that
     connect(doc, &Doc::aboutToReload, this, &DiagnosticsView::clearAllMarks, Qt::UniqueConnection);
     connect(doc, &Doc::markClicked, this, &DiagnosticsView::onMarkClicked, Qt::UniqueConnection);
+    // the diagnostics move along with the lines until the next publish
+    connect(doc, &Doc::lineWrapped, this, &DiagnosticsView::onLineWrapped, Qt::UniqueConnection);
+    connect(doc, &Doc::lineUnwrapped, this, &DiagnosticsView::onLineUnwrapped, Qt::UniqueConnection);
+
+    updateUnderlines(doc, true);
 }
 
-void DiagnosticsView::addMarksRec(KTextEditor::Document *doc, QStandardItem *item)
+void DiagnosticsView::updateDocumentMarks(KTextEditor::Document *doc,
+                                          const DiagnosticsModel::File *file,
+                                          const std::vector<DiagnosticsModel::Entry> &removed,
+                                          const std::vector<DiagnosticRelatedInformation> &removedRelated,
+                                          int firstAdded)
 {
-    Q_ASSERT(item);
-    // We only care about @p doc items
-    if (item->type() == DiagnosticItem_File && QUrl::fromLocalFile(item->data(Qt::UserRole).toString()) != doc->url()) {
+    // nothing to apply the changes to yet
+    if (!m_diagnosticsMarks.contains(doc) || !m_diagnosticsRanges.contains(doc)) {
+        updateDocumentMarks(doc);
         return;
     }
-    addMarks(doc, item);
-    for (int i = 0; i < item->rowCount(); ++i) {
-        addMarksRec(doc, item->child(i));
+
+    const auto docUrl = doc->url();
+    const auto &diags = file->diagnostics;
+    for (const auto &e : removed) {
+        if (!e.enabled) {
+            continue;
+        }
+        removeMark(doc, e.range, markTypeForSeverity(e.severity));
+        for (quint32 i = e.relatedBegin; i < e.relatedBegin + e.relatedCount; ++i) {
+            const auto &location = removedRelated[i].location;
+            if (location.uri == docUrl) {
+                removeMark(doc, location.range, markTypeDiagOther);
+            }
+        }
+    }
+    bool added = false;
+    for (int row = firstAdded; row < (int)diags.size(); ++row) {
+        const auto &e = diags[row];
+        if (!e.enabled) {
+            continue;
+        }
+        if (!added) {
+            setMarkDescriptions(doc);
+            added = true;
+        }
+        addMark(doc, e.range, markTypeForSeverity(e.severity));
+        for (quint32 i = e.relatedBegin; i < e.relatedBegin + e.relatedCount; ++i) {
+            const auto &location = file->related[i].location;
+            if (location.uri == docUrl) {
+                addMark(doc, location.range, markTypeDiagOther);
+            }
+        }
+    }
+
+    // the ranges of removed diagnostics are reused for the new ones
+    auto &state = m_diagnosticsRanges[doc];
+    QSet<quint32> gone;
+    for (const auto &e : removed) {
+        gone.insert(e.id);
+    }
+    std::vector<KTextEditor::MovingRange *> unused;
+    std::erase_if(state.underlines, [&gone, &unused](const DiagnosticRanges::Underline &u) {
+        if (gone.contains(u.entryId)) {
+            unused.push_back(u.range);
+            return true;
+        }
+        return false;
+    });
+    for (int row = firstAdded; row < (int)diags.size(); ++row) {
+        addUnderlines(doc, state, unused, file, diags[row]);
     }
+    qDeleteAll(unused);
 }
 
-void DiagnosticsView::addMarks(KTextEditor::Document *doc)
+void DiagnosticsView::addUnderline(KTextEditor::Document *doc,
+                                   DiagnosticRanges &state,
+                                   std::vector<KTextEditor::MovingRange *> &unused,
+                                   KTextEditor::Range range,
+                                   DiagnosticSeverity severity,
+                                   quint32 id,
+                                   int related)
 {
-    // check if already added
-    if (m_diagnosticsRanges.contains(doc) && m_diagnosticsMarks.contains(doc)) {
+    const auto lines = state.lines;
+    if (!lines.isValid() || !range.isValid() || range.end().line() < lines.start() || range.start().line() > lines.end()) {
         return;
     }
-    addMarksRec(doc, m_model.invisibleRootItem());
+    auto attr = underlineAttribute(severity);
+    if (!attr) {
+        return;
+    }
+    const bool empty = range.isEmpty();
+    if (empty) {
+        auto end = range.end();
+        end.setColumn(doc->lineLength(range.start().line()));
+        range.setEnd(end);
+    }
+    KTextEditor::MovingRange *mr = nullptr;
+    if (!unused.empty()) {
+        mr = unused.back();
+        unused.pop_back();
+        mr->setRange(range);
+    } else {
+        mr = doc->newMovingRange(range);
+        mr->setZDepth(-90000.0); // Set the z-depth to slightly worse than the selection
+        mr->setAttributeOnlyForViews(true);
+    }
+    mr->setAttribute(attr);
+    state.underlines.push_back({mr, id, related, empty});
+}
+
+void DiagnosticsView::addUnderlines(KTextEditor::Document *doc,
+                                    DiagnosticRanges &state,
+                                    std::vector<KTextEditor::MovingRange *> &unused,
+                                    const DiagnosticsModel::File *file,
+                                    const DiagnosticsModel::Entry &e)
+{
+    // only consider enabled items
+    if (!e.enabled) {
+        return;
+    }
+    addUnderline(doc, state, unused, e.range, e.severity, e.id, -1);
+    // related information might point into this document as well
+    for (quint32 i = 0; i < e.relatedCount; ++i) {
+        const auto &location = file->related[e.relatedBegin + i].location;
+        if (location.uri == file->url) {
+            addUnderline(doc, state, unused, location.range, DiagnosticSeverity::Information, e.id, int(i));
+        }
+    }
+}
+
+void DiagnosticsView::updateUnderlines(KTextEditor::Document *doc, bool force)
+{
+    // the lines shown in our views of the document, with a screen of margin around them
+    KTextEditor::LineRange lines = KTextEditor::LineRange::invalid();
+    const auto views = doc->views();
+    for (auto view : views) {
+        if (view->mainWindow() != m_mainWindow) {
+            continue;
+        }
+        const auto visible = Utils::getVisibleRange(view);
+        const int margin = visible.numberOfLines() + 1;
+        const int start = std::max(0, visible.start().line() - margin);
+        const int end = std::min(doc->lines() - 1, visible.end().line() + margin);
+        if (lines.isValid()) {
+            lines = KTextEditor::LineRange(std::min(lines.start(), start), std::max(lines.end(), end));
+        } else {
+            lines = KTextEditor::LineRange(start, end);
+        }
+    }
+
+    auto it = m_diagnosticsRanges.find(doc);
+    if (!force && it != m_diagnosticsRanges.end() && it->lines.isValid() && lines.isValid() && it->lines.start() <= lines.start()
+        && lines.end() <= it->lines.end()) {
+        return;
+    }
+
+    auto file = doc->url().isEmpty() ? nullptr : m_model.fileForUrl(doc->url());
+    if (!file) {
+        if (it != m_diagnosticsRanges.end()) {
+            for (const auto &u : it->underlines) {
+                delete u.range;
+            }
+            m_diagnosticsRanges.erase(it);
+        }
+        return;
+    }
+
+    // the ranges know where their diagnostics went after edits
+    readBackUnderlines(doc);
+    auto &state = m_diagnosticsRanges[doc];
+    // recycle the ranges of the lines that scrolled out of sight
+    std::vector<KTextEditor::MovingRange *> unused;
+    unused.reserve(state.underlines.size());
+    for (const auto &u : state.underlines) {
+        unused.push_back(u.range);
+    }
+    state.underlines.clear();
+    state.lines = lines;
+
+    if (lines.isValid()) {
+        for (const auto &e : file->diagnostics) {
+            addUnderlines(doc, state, unused, file, e);
+        }
+    }
+    qDeleteAll(unused);
+}
+
+void DiagnosticsView::readBackUnderlines(KTextEditor::Document *doc)
+{
+    auto it = m_diagnosticsRanges.find(doc);
+    auto file = doc->url().isEmpty() ? nullptr : m_model.fileForUrl(doc->url());
+    if (it == m_diagnosticsRanges.end() || !file) {
+        return;
+    }
+
+    // the line shifts keep the model close, edits within the lines only show in the ranges
+    for (const auto &u : it->underlines) {
+        const int row = m_model.rowOfEntry(file, u.entryId);
+        // gone since
+        if (row < 0) {
+            continue;
+        }
+        auto range = u.range->toRange();
+        if (u.empty) {
+            range.setEnd(range.start());
+        }
+        const auto &e = file->diagnostics[row];
+        const auto old = u.related < 0 ? e.range : file->related[e.relatedBegin + u.related].location.range;
+        if (old == range) {
+            continue;
+        }
+        // the mark goes along, KTextEditor only moves it with whole lines
+        if (old.start().line() != range.start().line()) {
+            const auto type = u.related < 0 ? markTypeForSeverity(e.severity) : markTypeDiagOther;
+            removeMark(doc, old, type);
+            addMark(doc, range, type);
+        }
+        m_model.setRange(file, row, u.related, range);
+    }
+}
+
+void DiagnosticsView::onLineWrapped(KTextEditor::Document *doc, KTextEditor::Cursor position)
+{
+    auto file = doc->url().isEmpty() ? nullptr : m_model.fileForUrl(doc->url());
+    if (!file) {
+        return;
+    }
+    // a newline went in at position, the part of the line behind it is only tracked by the underlines,
+    // unless all of the line moved down
+    const int from = position.column() == 0 ? position.line() : position.line() + 1;
+    m_model.shiftLines(file, from, 1);
+    if (auto marks = m_diagnosticsMarks.find(doc); marks != m_diagnosticsMarks.end()) {
+        shiftMarkCounts(marks.value(), from, 1);
+    }
+
+    // the covered lines move along, whatever came from outside of them is not covered
+    auto it = m_diagnosticsRanges.find(doc);
+    if (it != m_diagnosticsRanges.end() && it->lines.isValid()) {
+        auto &lines = it->lines;
+        const int start = lines.start() > position.line() ? lines.start() + 1 : lines.start();
+        const int end = lines.end() >= position.line() ? lines.end() + 1 : lines.end();
+        lines = KTextEditor::LineRange(start, end);
+    }
+}
+
+void DiagnosticsView::onLineUnwrapped(KTextEditor::Document *doc, int line)
+{
+    auto file = doc->url().isEmpty() ? nullptr : m_model.fileForUrl(doc->url());
+    if (!file) {
+        return;
+    }
+    // line got appended to line - 1
+    m_model.shiftLines(file, line, -1);
+    if (auto marks = m_diagnosticsMarks.find(doc); marks != m_diagnosticsMarks.end()) {
+        shiftMarkCounts(marks.value(), line, -1);
+    }
+
+    auto it = m_diagnosticsRanges.find(doc);
+    if (it != m_diagnosticsRanges.end() && it->lines.isValid()) {
+        auto &lines = it->lines;
+        const int start = lines.start() > line ? lines.start() - 1 : lines.start();
+        const int end = lines.end() >= line - 1 ? lines.end() - 1 : lines.end();
+        lines = start <= end ? KTextEditor::LineRange(start, end) : KTextEditor::LineRange::invalid();
+    }
 }
 
 void DiagnosticsView::clearAllMarks(KTextEditor::Document *doc)
@@ -1213,8 +1446,9 @@ void DiagnosticsView::clearAllMarks(KTextEditor::Document *doc)
 
     auto it = m_diagnosticsRanges.find(doc);
     if (it != m_diagnosticsRanges.end()) {
-        for (auto range : it.value()) {
-            delete range;
+        readBackUnderlines(doc);
+        for (const auto &u : it->underlines) {
+            delete u.range;
         }
         it = m_diagnosticsRanges.erase(it);
     }
@@ -1238,60 +1472,45 @@ void DiagnosticsView::updateMarks(const std::vector<QUrl> &urls)
     }
 
     for (auto doc : docs) {
-        clearAllMarks(doc);
-        addMarks(doc);
+        updateDocumentMarks(doc);
     }
 }
 
-void DiagnosticsView::updateDiagnosticsState(DocumentDiagnosticItem *&topItem)
+void DiagnosticsView::updateDiagnosticsState(DiagnosticsModel::File *&file)
 {
-    if (!topItem) {
+    if (!file) {
         return;
     }
 
-    auto diagTopItem = static_cast<DocumentDiagnosticItem *>(topItem);
-    auto enabled = diagTopItem->enabled;
-    auto suppressions = enabled ? diagTopItem->diagnosticSuppression.get() : nullptr;
-    auto url = topItem->data(Qt::UserRole).toUrl();
+    auto suppressions = file->suppressionEnabled ? file->diagnosticSuppression.get() : nullptr;
+    const auto url = file->url;
     auto doc = KTextEditor::Editor::instance()->application()->findUrl(url);
 
-    const int totalCount = topItem->rowCount();
-    int count = 0;
-    for (int i = 0; i < totalCount; ++i) {
-        auto item = topItem->child(i);
-        if (!item) {
-            continue;
+    const auto &diags = file->diagnostics;
+    std::vector<bool> enabled(diags.size(), true);
+    if (suppressions) {
+        std::vector<QString> texts;
+        std::vector<KTextEditor::Range> ranges;
+        texts.reserve(diags.size());
+        ranges.reserve(diags.size());
+        for (const auto &e : diags) {
+            texts.push_back(m_model.string(e.text));
+            ranges.push_back(e.range);
         }
-
-        auto hide = suppressions && suppressions->match(*item, doc);
-        // mark accordingly as flag and (un)hide
-        Qt::ItemFlags flags = item->flags();
-        const bool itemIsEnabled = flags.testFlag(Qt::ItemIsEnabled);
-        if (itemIsEnabled != !hide) {
-            flags.setFlag(Qt::ItemIsEnabled, !hide);
-            if (item->flags() != flags) {
-                item->setFlags(flags);
-            }
-            const auto proxyIdx = m_proxy->mapFromSource(item->index());
-            if (m_diagnosticsTree->isRowHidden(proxyIdx.row(), proxyIdx.parent()) != hide) {
-                m_diagnosticsTree->setRowHidden(proxyIdx.row(), proxyIdx.parent(), hide);
-            }
-        }
-        count += hide ? 0 : 1;
+        enabled = suppressions->match(texts, ranges, fileDoc);
+        enabled.flip();
     }
-    // adjust file item level text
-    auto suppressed = totalCount - count;
-    const QString path = topItem->data(Qt::UserRole).toString();
-    topItem->setText(suppressed ? i18nc("@info", "%1 [suppressed: %2]", path, suppressed) : path);
-    // only hide if really nothing below
-    const auto proxyIdx = m_proxy->mapFromSource(topItem->index());
-    m_diagnosticsTree->setRowHidden(proxyIdx.row(), proxyIdx.parent(), totalCount == 0);
-    if (topItem->rowCount() == 0) {
-        m_model.removeRow(topItem->row());
-        topItem = nullptr;
+    // suppressed diagnostics are disabled and hidden by the proxy,
+    // the file text shows how many there are
+    m_model.setDiagnosticsEnabled(file, 0, enabled);
+
+    // only remove if really nothing below
+    if (diags.empty()) {
+        m_model.removeFiles(file->row, 1);
+        file = nullptr;
     }
 
-    updateMarks({QUrl::fromLocalFile(path)});
+    updateMarks({url});
 }
 
 void DiagnosticsView::goToItemLocation(QModelIndex index)
@@ -1368,25 +1587,28 @@ void DiagnosticsView::filterViewTo(DiagnosticsProvider *provider)
 bool DiagnosticsView::syncDiagnostics(KTextEditor::Document *document, KTextEditor::Cursor pos, bool allowTop, bool doShow)
 {
     auto hint = QAbstractItemView::PositionAtTop;
-    DocumentDiagnosticItem *topItem = getItem(m_model, document->url());
-    updateDiagnosticsSuppression(topItem, document);
+    updateDiagnosticsSuppression(m_model.fileForUrl(document->url()), document);
+    // the file is gone if nothing was left below it
+    auto file = m_model.fileForUrl(document->url());
     auto proxy = static_cast<DiagnosticsProxyModel *>(m_proxy);
     auto severity = proxy->activeSeverity();
-    QStandardItem *targetItem = getItem(topItem, pos, /*onlyLine=*/pos.column() == 0, severity);
-    if (targetItem) {
+    const int row = findDiagnostic(file, pos, /*onlyLine=*/pos.column() == 0, severity);
+    QModelIndex target;
+    if (row != -1) {
         hint = QAbstractItemView::PositionAtCenter;
+        target = m_model.indexForEntry(file, row);
     }
-    if (!targetItem && allowTop) {
-        targetItem = topItem;
+    if (!target.isValid() && file && allowTop) {
+        target = m_model.indexForFile(file);
     }
-    if (targetItem) {
+    if (target.isValid()) {
         m_diagnosticsTree->blockSignals(true);
-        const auto idx = m_proxy->mapFromSource(targetItem->index());
+        const auto idx = m_proxy->mapFromSource(target);
         if (idx.isValid()) {
             m_diagnosticsTree->scrollTo(idx, hint);
             m_diagnosticsTree->setCurrentIndex(idx);
         } else {
-            qWarning() << "Invalid idx for" << targetItem->text();
+            qWarning() << "Invalid idx for" << target.data().toString();
             Q_ASSERT(false);
         }
         m_diagnosticsTree->blockSignals(false);
@@ -1394,19 +1616,19 @@ bool DiagnosticsView::syncDiagnostics(KTextEditor::Document *document, KTextEdit
             m_mainWindow->showToolView(qobject_cast<QWidget *>(parent()));
         }
     }
-    return targetItem != nullptr;
+    return target.isValid();
 }
 
-void DiagnosticsView::updateDiagnosticsSuppression(DocumentDiagnosticItem *diagTopItem, KTextEditor::Document *doc, bool force)
+void DiagnosticsView::updateDiagnosticsSuppression(DiagnosticsModel::File *file, KTextEditor::Document *doc, bool force)
 {
-    if (!diagTopItem) {
+    if (!file) {
         return;
     }
 
-    auto &suppressions = diagTopItem->diagnosticSuppression;
+    auto &suppressions = file->diagnosticSuppression;
     if (!suppressions || force) {
         std::vector<QJsonObject> providerSupressions;
-        const QList<DiagnosticsProvider *> &providers = diagTopItem->providers();
+        const QList<DiagnosticsProvider *> &providers = file->providers;
         if (doc) {
             for (auto p : providers) {
                 auto suppressions = p->suppressions(doc);
@@ -1416,13 +1638,13 @@ void DiagnosticsView::updateDiagnosticsSuppression(DocumentDiagnosticItem *diagT
             }
         }
 
-        const auto docUrl = diagTopItem->data(Qt::UserRole).toUrl();
+        const auto docUrl = file->url;
         const auto sessionSuppressions = m_sessionDiagnosticSuppressions->getSuppressions(docUrl.toLocalFile());
         auto supp = new DiagnosticSuppression(docUrl, providerSupressions, sessionSuppressions);
         const bool hadSuppression = suppressions != nullptr;
         suppressions.reset(supp);
         if (!providerSupressions.empty() || !sessionSuppressions.empty() || hadSuppression) {
-            updateDiagnosticsState(diagTopItem);
+            updateDiagnosticsState(file);
         }
     }
 }
@@ -1437,20 +1659,20 @@ void DiagnosticsView::onContextMenuRequested(const QPoint &pos)
     menu->addSeparator();
 
     QModelIndex index = m_proxy->mapToSource(m_diagnosticsTree->currentIndex());
-    if (QStandardItem *item = m_model.itemFromIndex(index)) {
+    if (index.isValid()) {
         auto diagText = index.data().toString();
         menu->addAction(QIcon::fromTheme(QLatin1String("edit-copy")), i18n("Copy to Clipboard"), [diagText]() {
             QClipboard *clipboard = QGuiApplication::clipboard();
             clipboard->setText(diagText);
         });
 
-        if (item->type() == DiagnosticItem_Diag) {
+        const auto kind = m_model.kind(index);
+        if (kind == DiagnosticsModel::ItemKind::Diagnostic) {
             menu->addSeparator();
             auto parent = index.parent();
-            auto docDiagItem = static_cast<DocumentDiagnosticItem *>(m_model.itemFromIndex(parent));
-            // track validity of raw pointer
+            // track validity of the file
             QPersistentModelIndex pindex(parent);
-            auto h = [this, pindex, diagText, docDiagItem](bool add, const QString &file, const QString &diagnostic) {
+            auto h = [this, pindex](bool add, const QString &file, const QString &diagnostic) {
                 if (!pindex.isValid()) {
                     return;
                 }
@@ -1463,19 +1685,16 @@ void DiagnosticsView::onContextMenuRequested(const QPoint &pos)
                 auto app = KTextEditor::Editor::instance()->application();
                 if (file.isEmpty()) {
                     // global
-                    const int rows = m_model.rowCount();
-                    for (int i = 0; i < rows; ++i) {
-                        auto item = m_model.item(i);
-                        if (item->type() == DiagnosticItem_File && item->rowCount() > 0) {
-                            auto docItem = static_cast<DocumentDiagnosticItem *>(item);
-                            auto url = docItem->data(Qt::UserRole).toUrl();
-                            updateDiagnosticsSuppression(docItem, app->findUrl(url), true);
+                    for (int i = 0; i < m_model.fileCount(); ++i) {
+                        auto docFile = m_model.fileAt(i);
+                        if (!docFile->diagnostics.empty()) {
+                            updateDiagnosticsSuppression(docFile, app->findUrl(docFile->url), true);
                         }
                     }
                 } else {
                     // local
-                    auto url = docDiagItem->data(Qt::UserRole).toUrl();
-                    updateDiagnosticsSuppression(docDiagItem, app->findUrl(url), true);
+                    auto docFile = m_model.fileForIndex(pindex);
+                    updateDiagnosticsSuppression(docFile, app->findUrl(docFile->url), true);
                 }
             };
             using namespace std::placeholders;
@@ -1491,19 +1710,18 @@ void DiagnosticsView::onContextMenuRequested(const QPoint &pos)
             } else {
                 menu->addAction(i18n("Add Local Suppression"), this, std::bind(h, true, file, diagText));
             }
-        } else if (item->type() == DiagnosticItem_File) {
-            // track validity of raw pointer
+        } else if (kind == DiagnosticsModel::ItemKind::File) {
+            // track validity of the file
             QPersistentModelIndex pindex(index);
-            auto docDiagItem = static_cast<DocumentDiagnosticItem *>(item);
-            auto h = [this, item, pindex](bool enabled) {
+            auto h = [this, pindex](bool enabled) {
                 if (!pindex.isValid()) {
                     return;
                 }
-                auto docDiagItem = static_cast<DocumentDiagnosticItem *>(item);
-                docDiagItem->enabled = enabled;
-                updateDiagnosticsState(docDiagItem);
+                auto docFile = m_model.fileForIndex(pindex);
+                docFile->suppressionEnabled = enabled;
+                updateDiagnosticsState(docFile);
             };
-            if (docDiagItem->enabled) {
+            if (m_model.fileForIndex(index)->suppressionEnabled) {
                 menu->addAction(i18n("Disable Suppression"), this, std::bind(h, false));
             } else {
                 menu->addAction(i18n("Enable Suppression"), this, std::bind(h, true));
@@ -1518,16 +1736,14 @@ void DiagnosticsView::onTextHint(KTextEditor::View *view, const KTextEditor::Cur
     QString result;
     auto document = view->document();
 
-    QStandardItem *topItem = getItem(m_model, document->url());
-    QStandardItem *targetItem = getItem(topItem, position, false);
-    if (targetItem) {
-        result = targetItem->text();
+    auto file = m_model.fileForUrl(document->url());
+    const int row = findDiagnostic(file, position, false);
+    if (row != -1) {
+        result = m_model.string(file->diagnostics[row].text);
         // also include related info
-        int count = targetItem->rowCount();
-        for (int i = 0; i < count; ++i) {
-            auto item = targetItem->child(i);
+        for (const auto &child : m_model.children(file, row)) {
             result += QStringLiteral("\n");
-            result += item->text();
+            result += child.text;
         }
         // but let's not get carried away too far
         constexpr int maxsize = 1000;
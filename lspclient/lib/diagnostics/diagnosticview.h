@@ -6,18 +6,21 @@
 #pragma once
 
 #include "diagnostic_types.h"
+#include "diagnosticsmodel.h"
 
 #include <QJsonObject>
 #include <QPointer>
-#include <QStandardItemModel>
 #include <QUrl>
 #include <QWidget>
 
 #include <KXMLGUIClient>
 
 #include <KTextEditor/Document>
+#include <KTextEditor/LineRange>
 #include <KTextEditor/Range>
 
+#include <array>
+
 class KConfigGroup;
 class SessionDiagnosticSuppressions;
 class KateMainWindow;
@@ -191,7 +194,7 @@ private:
     void clearDiagnosticsForStaleDocs(const QList<QString> &filesToKeep, DiagnosticsProvider *provider);
     void clearSuppressionsFromProvider(DiagnosticsProvider *provider);
     void onDocumentUrlChanged();
-    void updateDiagnosticsState(struct DocumentDiagnosticItem *&topItem);
+    void updateDiagnosticsState(DiagnosticsModel::File *&file);
     void updateMarks(const std::vector<QUrl> &urls = {});
     void goToItemLocation(QModelIndex index);
 
@@ -199,15 +202,25 @@ private:
 
     void onDoubleClicked(const QModelIndex &index, bool quickFix = false);
 
-    void addMarks(KTextEditor::Document *doc, QStandardItem *item);
-    void addMarksRec(KTextEditor::Document *doc, QStandardItem *item);
-    void addMarks(KTextEditor::Document *doc);
+    void updateDocumentMarks(KTextEditor::Document *doc);
+    // apply a diff: @p removed are gone, the diagnostics from row @p firstAdded on are new
+    void updateDocumentMarks(KTextEditor::Document *doc,
+                             const DiagnosticsModel::File *file,
+                             const std::vector<DiagnosticsModel::Entry> &removed,
+                             const std::vector<DiagnosticRelatedInformation> &removedRelated,
+                             int firstAdded);
+    void addMark(KTextEditor::Document *doc, KTextEditor::Range range, KTextEditor::Document::MarkTypes type);
+    void removeMark(KTextEditor::Document *doc, KTextEditor::Range range, KTextEditor::Document::MarkTypes type);
+    void updateUnderlines(KTextEditor::Document *doc, bool force);
+    void readBackUnderlines(KTextEditor::Document *doc);
+    void onLineWrapped(KTextEditor::Document *doc, KTextEditor::Cursor position);
+    void onLineUnwrapped(KTextEditor::Document *doc, int line);
 
     Q_SLOT void clearAllMarks(KTextEditor::Document *doc);
     Q_SLOT void onMarkClicked(KTextEditor::Document *document, KTextEditor::Mark mark, bool &handled);
 
     bool syncDiagnostics(KTextEditor::Document *document, KTextEditor::Cursor pos, bool allowTop, bool doShow);
-    void updateDiagnosticsSuppression(struct DocumentDiagnosticItem *topItem, KTextEditor::Document *doc, bool force = false);
+    void updateDiagnosticsSuppression(DiagnosticsModel::File *file, KTextEditor::Document *doc, bool force = false);
 
     void onContextMenuRequested(const QPoint &pos);
 
@@ -225,18 +238,44 @@ private:
 
     class ProviderListModel *m_providerModel;
 
-    QStandardItemModel m_model;
+    DiagnosticsModel m_model;
     QSortFilterProxyModel *const m_proxy;
     std::vector<DiagnosticsProvider *> m_providers;
     std::unique_ptr<SessionDiagnosticSuppressions> m_sessionDiagnosticSuppressions;
 
-    QHash<KTextEditor::Document *, QList<KTextEditor::MovingRange *>> m_diagnosticsRanges;
-    // applied marks
-    QSet<KTextEditor::Document *> m_diagnosticsMarks;
+    struct DiagnosticRanges {
+        // underlines exist for the diagnostics in these lines
+        KTextEditor::LineRange lines = KTextEditor::LineRange::invalid();
+        struct Underline {
+            KTextEditor::MovingRange *range;
+            quint32 entryId;
+            // index in the entry's related information, -1 for the diagnostic itself
+            int related;
+            // empty ranges are underlined up to the end of the line
+            bool empty;
+        };
+        std::vector<Underline> underlines;
+    };
+    void addUnderline(KTextEditor::Document *doc,
+                      DiagnosticRanges &state,
+                      std::vector<KTextEditor::MovingRange *> &unused,
+                      KTextEditor::Range range,
+                      DiagnosticSeverity severity,
+                      quint32 id,
+                      int related);
+    void addUnderlines(KTextEditor::Document *doc,
+                       DiagnosticRanges &state,
+                       std::vector<KTextEditor::MovingRange *> &unused,
+                       const DiagnosticsModel::File *file,
+                       const DiagnosticsModel::Entry &e);
+    QHash<KTextEditor::Document *, DiagnosticRanges> m_diagnosticsRanges;
+    // applied marks, by line the number of diagnostics that want error, warning and other marks
+    QHash<KTextEditor::Document *, QHash<int, std::array<int, 3>>> m_diagnosticsMarks;
 
     QPointer<DiagTabOverlay> m_tabButtonOverlay;
 
     QMetaObject::Connection posChangedConnection;
+    QMetaObject::Connection scrollConnection;
     QTimer *const m_posChangedTimer;
     QTimer *const m_filterChangedTimer;
     QTimer *const m_urlChangedTimer;
@@ -0,0 +1,90 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#include "fuzzyscorer.h"
+
+#include <KFuzzyMatcher>
+
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <limits>
+
+using FuzzyScorer::Match;
+
+// below two chunks a thread pool only adds overhead
+static constexpr qsizetype ChunkSize = 4096;
+
+// higher score first, then earlier candidate
+static bool better(const Match &a, const Match &b)
+{
+    return a.score != b.score ? a.score > b.score : a.index < b.index;
+}
+
+// best @p limit matches of candidates [begin, end), unordered
+static std::vector<Match> scoreRange(const QString &pattern, const QStringList &candidates, qsizetype begin, qsizetype end, size_t limit)
+{
+    std::vector<Match> matches;
+    for (qsizetype i = begin; i < end; ++i) {
+        const auto res = KFuzzyMatcher::match(pattern, candidates[i]);
+        if (!res.matched) {
+            continue;
+        }
+        const Match m{.index = int(i), .score = res.score};
+        // a heap with the worst kept match on top
+        if (matches.size() < limit) {
+            matches.push_back(m);
+            std::push_heap(matches.begin(), matches.end(), better);
+        } else if (better(m, matches.front())) {
+            std::pop_heap(matches.begin(), matches.end(), better);
+            matches.back() = m;
+            std::push_heap(matches.begin(), matches.end(), better);
+        }
+    }
+    return matches;
+}
+
+std::vector<Match> FuzzyScorer::topMatches(const QString &pattern, const QStringList &candidates, int limit)
+{
+    const size_t maxCount = limit < 0 ? std::numeric_limits<size_t>::max() : size_t(limit);
+    std::vector<Match> matches;
+    if (maxCount == 0) {
+        return matches;
+    }
+
+    if (pattern.isEmpty()) {
+        const auto count = std::min(maxCount, size_t(candidates.size()));
+        matches.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            matches.push_back({.index = int(i), .score = 0});
+        }
+        return matches;
+    }
+
+    if (candidates.size() < 2 * ChunkSize) {
+        matches = scoreRange(pattern, candidates, 0, candidates.size(), maxCount);
+    } else {
+        std::vector<std::pair<qsizetype, qsizetype>> chunks;
+        for (qsizetype begin = 0; begin < candidates.size(); begin += ChunkSize) {
+            chunks.push_back({begin, std::min(begin + ChunkSize, candidates.size())});
+        }
+        // every chunk keeps its own best ones, the overall best are among them
+        auto scoreChunk = [&pattern, &candidates, maxCount](const std::pair<qsizetype, qsizetype> &chunk) -> std::vector<Match> {
+            return scoreRange(pattern, candidates, chunk.first, chunk.second, maxCount);
+        };
+        const auto parts = QtConcurrent::blockingMapped<std::vector<std::vector<Match>>>(chunks, scoreChunk);
+        for (const auto &part : parts) {
+            matches.insert(matches.end(), part.begin(), part.end());
+        }
+    }
+
+    if (matches.size() > maxCount) {
+        std::partial_sort(matches.begin(), matches.begin() + maxCount, matches.end(), better);
+        matches.resize(maxCount);
+    } else {
+        std::sort(matches.begin(), matches.end(), better);
+    }
+    return matches;
+}
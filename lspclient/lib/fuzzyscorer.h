@@ -0,0 +1,31 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#pragma once
+
+#include <QStringList>
+
+#include <vector>
+
+/**
+ * Fuzzy scoring of many candidates at once, for filter models and completion.
+ * Candidates are scored with KFuzzyMatcher, big lists in chunks on all cores,
+ * and only the best ones are kept.
+ */
+namespace FuzzyScorer
+{
+struct Match {
+    // index into the candidates
+    int index = 0;
+    int score = 0;
+};
+
+/**
+ * Match @p pattern against @p candidates and keep the @p limit best matches,
+ * all of them if @p limit is negative. An empty pattern matches everything.
+ * @return the matches, best first, equal scores in candidate order
+ */
+std::vector<Match> topMatches(const QString &pattern, const QStringList &candidates, int limit = -1);
+}
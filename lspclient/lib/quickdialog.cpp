@@ -5,6 +5,7 @@
 */
 #include "quickdialog.h"
 #include "drawing_utils.h"
+#include "fuzzyscorer.h"
 
 #include <QCoreApplication>
 #include <QDebug>
@@ -19,51 +20,94 @@
 
 #include <KFuzzyMatcher>
 
+#include <numeric>
+
 namespace
 {
-class FuzzyFilterModel final : public QSortFilterProxyModel
+/**
+ * Presents the rows of a flat source model that match the filter string.
+ * The matching rows are computed in one go, scored fuzzy filtering ranks
+ * them best first, the other types keep the source order.
+ */
+class FuzzyFilterModel final : public QAbstractProxyModel
 {
 public:
     explicit FuzzyFilterModel(QObject *parent = nullptr)
-        : QSortFilterProxyModel(parent)
+        : QAbstractProxyModel(parent)
     {
     }
 
-    bool lessThan(const QModelIndex &sourceLeft, const QModelIndex &sourceRight) const override
+    void setSourceModel(QAbstractItemModel *model) override
     {
-        if (!m_pattern.isEmpty() && m_scoreRole > -1 && m_scoreRole > Qt::UserRole) {
-            const int l = sourceLeft.data(m_scoreRole).toInt();
-            const int r = sourceRight.data(m_scoreRole).toInt();
-            return l < r;
+        beginResetModel();
+        if (sourceModel()) {
+            disconnect(sourceModel(), nullptr, this, nullptr);
         }
-        return sourceLeft.row() > sourceRight.row();
+        QAbstractProxyModel::setSourceModel(model);
+        if (model) {
+            // cheap enough to simply start over on structural changes,
+            // the reset begins before the source changes so no view asks about rows that are gone
+            connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &FuzzyFilterModel::beginRefilter);
+            connect(model, &QAbstractItemModel::modelReset, this, &FuzzyFilterModel::endRefilter);
+            connect(model, &QAbstractItemModel::layoutAboutToBeChanged, this, &FuzzyFilterModel::beginRefilter);
+            connect(model, &QAbstractItemModel::layoutChanged, this, &FuzzyFilterModel::endRefilter);
+            connect(model, &QAbstractItemModel::rowsAboutToBeInserted, this, &FuzzyFilterModel::beginRefilter);
+            connect(model, &QAbstractItemModel::rowsInserted, this, &FuzzyFilterModel::endRefilter);
+            connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &FuzzyFilterModel::beginRefilter);
+            connect(model, &QAbstractItemModel::rowsRemoved, this, &FuzzyFilterModel::endRefilter);
+            connect(model, &QAbstractItemModel::rowsAboutToBeMoved, this, &FuzzyFilterModel::beginRefilter);
+            connect(model, &QAbstractItemModel::rowsMoved, this, &FuzzyFilterModel::endRefilter);
+            connect(model, &QAbstractItemModel::dataChanged, this, &FuzzyFilterModel::onDataChanged);
+        }
+        updateRows();
+        endResetModel();
     }
 
-    bool filterAcceptsRow(int row, const QModelIndex &parent) const override
+    QModelIndex index(int row, int column, const QModelIndex &parent = {}) const override
     {
-        if (m_pattern.isEmpty()) {
-            return true;
+        if (parent.isValid() || row < 0 || row >= rowCount() || column < 0 || column >= columnCount()) {
+            return {};
         }
+        return createIndex(row, column);
+    }
+
+    QModelIndex parent(const QModelIndex &) const override
+    {
+        return {};
+    }
+
+    int rowCount(const QModelIndex &parent = {}) const override
+    {
+        return parent.isValid() ? 0 : (int)m_rows.size();
+    }
 
-        const auto index = sourceModel()->index(row, filterKeyColumn(), parent);
-        const auto text = index.data(filterRole()).toString();
-        if (m_filterType == HUDDialog::Fuzzy) {
-            return KFuzzyMatcher::matchSimple(m_pattern, text);
-        } else if (m_filterType == HUDDialog::Contains) {
-            return text.contains(m_pattern, Qt::CaseInsensitive);
-        } else if (m_filterType == HUDDialog::ScoredFuzzy) {
-            KFuzzyMatcher::Result res = KFuzzyMatcher::match(m_pattern, text);
-            Q_ASSERT(m_scoreRole > -1 && m_scoreRole > Qt::UserRole);
-            sourceModel()->setData(index, res.score, m_scoreRole);
-            return res.matched;
+    int columnCount(const QModelIndex &parent = {}) const override
+    {
+        return !parent.isValid() && sourceModel() ? sourceModel()->columnCount() : 0;
+    }
+
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override
+    {
+        if (!proxyIndex.isValid() || !sourceModel()) {
+            return {};
+        }
+        return sourceModel()->index(m_rows[proxyIndex.row()], proxyIndex.column());
+    }
+
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override
+    {
+        if (!sourceIndex.isValid() || sourceIndex.parent().isValid() || size_t(sourceIndex.row()) >= m_proxyRows.size()) {
+            return {};
         }
-        return false;
+        const int row = m_proxyRows[sourceIndex.row()];
+        return row < 0 ? QModelIndex() : index(row, sourceIndex.column());
     }
 
     void setFilterString(const QString &text)
     {
         beginResetModel();
         m_pattern = text;
+        updateRows();
         endResetModel();
     }
 
@@ -72,15 +116,89 @@ public:
         m_filterType = t;
     }
 
-    void setScoreRole(int role)
+    void setFilterKeyColumn(int column)
+    {
+        m_filterKeyColumn = column;
+    }
+
+    void setFilterRole(int role)
     {
-        m_scoreRole = role;
+        m_filterRole = role;
     }
 
 private:
-    HUDDialog::FilterType m_filterType;
+    void refilter()
+    {
+        beginRefilter();
+        endRefilter();
+    }
+
+    void beginRefilter()
+    {
+        beginResetModel();
+    }
+
+    void endRefilter()
+    {
+        updateRows();
+        endResetModel();
+    }
+
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles)
+    {
+        if (!m_pattern.isEmpty() && (roles.isEmpty() || roles.contains(m_filterRole))) {
+            refilter();
+        } else if (!m_rows.empty()) {
+            // rows are not contiguous here, let the view sort it out
+            Q_EMIT dataChanged(index(0, topLeft.column()), index(rowCount() - 1, bottomRight.column()), roles);
+        }
+    }
+
+    void updateRows()
+    {
+        m_rows.clear();
+        const int count = sourceModel() ? sourceModel()->rowCount() : 0;
+        m_proxyRows.assign(count, -1);
+
+        if (m_pattern.isEmpty()) {
+            m_rows.resize(count);
+            std::iota(m_rows.begin(), m_rows.end(), 0);
+        } else {
+            QStringList texts;
+            texts.reserve(count);
+            for (int row = 0; row < count; ++row) {
+                texts.push_back(sourceModel()->index(row, m_filterKeyColumn).data(m_filterRole).toString());
+            }
+
+            if (m_filterType == HUDDialog::ScoredFuzzy) {
+                const auto matches = FuzzyScorer::topMatches(m_pattern, texts);
+                m_rows.reserve(matches.size());
+                for (const auto &m : matches) {
+                    m_rows.push_back(m.index);
+                }
+            } else {
+                for (int row = 0; row < count; ++row) {
+                    const bool accept = m_filterType == HUDDialog::Fuzzy ? KFuzzyMatcher::matchSimple(m_pattern, texts[row])
+                                                                        : texts[row].contains(m_pattern, Qt::CaseInsensitive);
+                    if (accept) {
+                        m_rows.push_back(row);
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < m_rows.size(); ++i) {
+            m_proxyRows[m_rows[i]] = int(i);
+        }
+    }
+
+    HUDDialog::FilterType m_filterType = HUDDialog::Fuzzy;
     QString m_pattern;
-    int m_scoreRole = -1;
+    int m_filterKeyColumn = 0;
+    int m_filterRole = Qt::DisplayRole;
+    // proxy row => source row and back (-1 if filtered out)
+    std::vector<int> m_rows;
+    std::vector<int> m_proxyRows;
 };
 
 }
@@ -126,8 +244,6 @@ HUDDialog::HUDDialog(QWidget *mainWindow)
     initHudDialog(this, mainWindow, &m_lineEdit, &m_treeView);
 
     m_proxy->setSourceModel(m_model);
-    m_proxy->setFilterRole(Qt::DisplayRole);
-    m_proxy->setFilterKeyColumn(0);
 
     m_delegate = new HUDStyleDelegate(this);
     m_treeView.setModel(m_proxy);
@@ -328,15 +444,14 @@ void HUDDialog::clearLineEdit()
     m_lineEdit.clear();
 }
 
-void HUDDialog::setModel(QAbstractItemModel *model, FilterType type, int filterKeyCol, int filterRole, int scoreRole)
+void HUDDialog::setModel(QAbstractItemModel *model, FilterType type, int filterKeyCol, int filterRole)
 {
     m_model = model;
-    m_proxy->setSourceModel(model);
-    m_proxy->setFilterKeyColumn(filterKeyCol);
-    m_proxy->setFilterRole(filterRole);
     auto proxy = static_cast<FuzzyFilterModel *>(m_proxy.data());
+    proxy->setFilterKeyColumn(filterKeyCol);
+    proxy->setFilterRole(filterRole);
     proxy->setFilterType(type);
-    proxy->setScoreRole(scoreRole);
+    proxy->setSourceModel(model);
 }
 
 void HUDDialog::setFilteringEnabled(bool enabled)
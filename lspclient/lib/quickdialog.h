@@ -5,11 +5,11 @@
 */
 #pragma once
 
+#include <QAbstractProxyModel>
 #include <QFrame>
 #include <QLineEdit>
 #include <QMenu>
 #include <QPointer>
-#include <QSortFilterProxyModel>
 #include <QStyledItemDelegate>
 #include <QTreeView>
 
@@ -61,7 +61,7 @@ public:
 
     void setStringList(const QStringList &);
 
-    void setModel(QAbstractItemModel *, FilterType, int filterKeyCol = 0, int filterRole = Qt::DisplayRole, int scoreRole = -1);
+    void setModel(QAbstractItemModel *, FilterType, int filterKeyCol = 0, int filterRole = Qt::DisplayRole);
 
     void setFilteringEnabled(bool enabled);
 
@@ -85,7 +85,7 @@ protected:
 private:
     QPointer<QWidget> m_mainWindow;
     QPointer<QAbstractItemModel> m_model;
-    QPointer<QSortFilterProxyModel> m_proxy;
+    QPointer<QAbstractProxyModel> m_proxy;
     HUDStyleDelegate *m_delegate = nullptr;
 
 Q_SIGNALS:
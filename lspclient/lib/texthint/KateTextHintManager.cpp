@@ -14,6 +14,13 @@
 #include <KTextEditor/View>
 #include <KTextEditor/Document>
 
+#include <QLoggingCategory>
+
+#include <algorithm>
+#include <utility>
+
+Q_LOGGING_CATEGORY(LOG_TEXTHINT, "kate.texthint", QtWarningMsg)
+
 KateTextHintProvider::KateTextHintProvider(KTextEditor::MainWindow *mainWindow, QObject *parent)
     : QObject(parent)
 {
@@ -80,6 +87,8 @@ KateTextHintManager::KateTextHintManager(KTextEditor::MainWindow *mainWindow)
     const auto updateConfig = [this, mainWindow] {
         KConfigGroup cgGeneral = KConfigGroup(KSharedConfig::openConfig(), QStringLiteral("General"));
         const auto hintViewEnabled = cgGeneral.readEntry("Enable Context ToolView", false);
+        // how long to wait for slower providers to add to a tooltip
+        m_deadline = cgGeneral.readEntry("Text Hint Deadline", 1000);
         if (hintViewEnabled && !m_hintView) {
             m_hintView = new KateTextHintView(mainWindow, this);
         } else if (!hintViewEnabled && m_hintView) {
@@ -90,6 +99,9 @@ KateTextHintManager::KateTextHintManager(KTextEditor::MainWindow *mainWindow)
 
     //connect(KateApp::self(), &KateApp::configurationChanged, this, updateConfig);
     updateConfig();
+
+    m_deadlineTimer.setSingleShot(true);
+    m_deadlineTimer.callOnTimeout(this, &KateTextHintManager::expireHintRequest);
 }
 
 KateTextHintManager::~KateTextHintManager()
@@ -108,13 +120,18 @@ void KateTextHintManager::registerProvider(KateTextHintProvider *provider)
             if (it != m_providers.end()) {
                 m_providers.erase(it);
             }
+            std::erase(m_pendingProviders, provider);
+            std::erase_if(m_collectedHints, [provider](const Hint &hint) {
+                return hint.provider == provider;
+            });
+            m_latencies.erase(static_cast<KateTextHintProvider *>(provider));
         });
 
         const auto slot = [provider, this](bool forced) {
             return [this, provider, forced](const QString &hint, TextHintMarkupKind kind, KTextEditor::Cursor pos) {
                 const auto instanceId = reinterpret_cast<std::uintptr_t>(provider);
                 if (forced) { // Forced requests go implicitly to the tooltip
-                    showTextHint(instanceId, hint, kind, pos, true);
+                    showHints({{.provider = provider, .text = hint, .kind = kind, .pos = pos}}, true);
                     return;
                 }
                 const auto lastRange = getLastRange(m_lastRequestor);
@@ -125,7 +142,7 @@ void KateTextHintManager::registerProvider(KateTextHintProvider *provider)
                         m_hintView->update(instanceId, hint, kind, m_provider->view());
                         return;
                     }
-                    showTextHint(instanceId, hint, kind, pos, forced);
+                    collectHint({.provider = provider, .text = hint, .kind = kind, .pos = pos});
                 }
             };
         };
@@ -147,14 +164,65 @@ void KateTextHintManager::ontextHintRequested(KTextEditor::View *v, KTextEditor:
     setLastRange(wordRange, hintSource);
     m_lastRequestor = hintSource;
 
-    for (const auto &provider : m_providers) {
+    // what is known locally is answered right away and shown at once,
+    // the others are added as they come in
+    m_pendingProviders = m_providers;
+    m_collectedHints.clear();
+    m_requestTime.start();
+    m_requesting = true;
+    const auto providers = m_providers;
+    for (const auto &provider : providers) {
         Q_EMIT provider->textHintRequested(v, c);
     }
+    m_requesting = false;
+
+    if (!m_collectedHints.empty()) {
+        showHints(std::exchange(m_collectedHints, {}), false);
+    }
+    if (m_pendingProviders.empty()) {
+        m_deadlineTimer.stop();
+    } else {
+        m_deadlineTimer.start(m_deadline);
+    }
 }
 
-void KateTextHintManager::showTextHint(size_t instanceId, const QString &hint, TextHintMarkupKind kind, KTextEditor::Cursor pos, bool force)
+void KateTextHintManager::collectHint(const Hint &hint)
 {
-    if (!pos.isValid()) {
+    auto it = std::find(m_pendingProviders.begin(), m_pendingProviders.end(), hint.provider);
+    if (it == m_pendingProviders.end()) {
+        // too late, or not asked for
+        return;
+    }
+    m_pendingProviders.erase(it);
+
+    auto &latency = m_latencies[hint.provider];
+    const auto elapsed = m_requestTime.elapsed();
+    ++latency.count;
+    latency.total += elapsed;
+    latency.max = std::max(latency.max, elapsed);
+    qCDebug(LOG_TEXTHINT) << hint.provider->parent() << "answered in" << elapsed << "ms, average" << latency.total / latency.count << "max" << latency.max;
+
+    if (m_pendingProviders.empty()) {
+        m_deadlineTimer.stop();
+    }
+    if (m_requesting) {
+        m_collectedHints.push_back(hint);
+    } else {
+        showHints({hint}, false);
+    }
+}
+
+void KateTextHintManager::expireHintRequest()
+{
+    for (const auto provider : m_pendingProviders) {
+        qCDebug(LOG_TEXTHINT) << provider->parent() << "missed the deadline of" << m_deadline << "ms";
+    }
+    m_pendingProviders.clear();
+}
+
+void KateTextHintManager::showHints(const std::vector<Hint> &hints, bool force)
+{
+    if (hints.empty() || !hints.front().pos.isValid()) {
         return;
     }
 
@@ -163,8 +231,12 @@ void KateTextHintManager::showTextHint(size_t instanceId, const QString &hint, T
         return;
     }
 
-    QPoint p = view->cursorToCoordinate(pos);
-    auto tooltip = KateTooltip::show(instanceId, hint, kind, view->mapToGlobal(p), view, force, getLastRange(Requestor::HintProvider));
+    std::vector<KateTooltip::Hint> tooltipHints;
+    for (const auto &hint : hints) {
+        tooltipHints.push_back({.instanceId = reinterpret_cast<std::uintptr_t>(hint.provider), .text = hint.text, .kind = hint.kind});
+    }
+    QPoint p = view->cursorToCoordinate(hints.front().pos);
+    auto tooltip = KateTooltip::show(tooltipHints, view->mapToGlobal(p), view, force, getLastRange(Requestor::HintProvider));
     if (tooltip) {
         // unset the range if the tooltip is gone
         connect(tooltip, &QObject::destroyed, this, [this] {
@@ -7,9 +7,12 @@
 
 #include <KTextEditor/Cursor>
 #include <KTextEditor/Range>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QPointer>
+#include <QTimer>
 
+#include <unordered_map>
 #include <vector>
 
 namespace KTextEditor
@@ -61,7 +64,16 @@ public:
     void registerProvider(KateTextHintProvider *provider);
 
 private:
-    void showTextHint(size_t instanceId, const QString &hint, TextHintMarkupKind kind, KTextEditor::Cursor pos, bool force);
+    struct Hint {
+        KateTextHintProvider *provider;
+        QString text;
+        TextHintMarkupKind kind;
+        KTextEditor::Cursor pos;
+    };
+
+    void collectHint(const Hint &hint);
+    void showHints(const std::vector<Hint> &hints, bool force);
+    void expireHintRequest();
     KTextEditor::Range getLastRange(Requestor requestor);
     void setLastRange(KTextEditor::Range range, Requestor requestor);
 
@@ -77,4 +89,21 @@ private:
 
     KTextEditor::Range m_HintProviderLastRange = KTextEditor::Range::invalid();
     KTextEditor::Range m_CursorChangeLastRange = KTextEditor::Range::invalid();
+
+    // providers asked for the current tooltip that have not answered yet,
+    // whatever comes after the deadline is dropped
+    std::vector<KateTextHintProvider *> m_pendingProviders;
+    // answers given while still asking, shown together
+    std::vector<Hint> m_collectedHints;
+    bool m_requesting = false;
+    QElapsedTimer m_requestTime;
+    QTimer m_deadlineTimer;
+    int m_deadline = 1000;
+
+    struct Latency {
+        int count = 0;
+        qint64 total = 0;
+        qint64 max = 0;
+    };
+    std::unordered_map<const KateTextHintProvider *, Latency> m_latencies;
 };
@@ -6,6 +6,8 @@
 #include "hintstate.h"
 
 #include <QApplication>
+#include <QCache>
+#include <QCryptographicHash>
 #include <QEvent>
 #include <QFontMetrics>
 #include <QMouseEvent>
@@ -14,12 +16,15 @@
 #include <QScrollBar>
 #include <QString>
 #include <QTextBrowser>
+#include <QThreadPool>
 #include <QTimer>
+#include <QtConcurrentRun>
 
 #include <KSyntaxHighlighting/Definition>
 #include <KSyntaxHighlighting/Format>
 #include <KSyntaxHighlighting/Repository>
 #include <KSyntaxHighlighting/SyntaxHighlighter>
+#include <KSyntaxHighlighting/Theme>
 #include <KTextEditor/Document>
 #include <KTextEditor/Editor>
 #include <KTextEditor/View>
@@ -27,6 +32,8 @@
 #include <QMenu>
 #include <QScopedValueRollback>
 
+#include <algorithm>
+
 class TooltipHighlighter final : public KSyntaxHighlighting::SyntaxHighlighter
 {
 public:
@@ -70,6 +77,122 @@ public:
     QFont m_editorFont;
 };
 
+namespace
+{
+// what a hint is rendered with
+struct RenderStyle {
+    // of code blocks
+    QString definition;
+    QString theme;
+    QFont font;
+    QBrush inlineCodeSpanColor;
+};
+}
+
+// shorter hints are rendered right away, longer ones in the background
+static constexpr qsizetype asyncRenderSize = 2000;
+static constexpr int maxCachedHints = 32;
+
+/**
+ * @p text as a document with all formatting, highlighting included, in its character formats
+ * so that it survives QTextDocument::clone(). May run on any thread, given a @p repository
+ * that is only used by that thread.
+ */
+static QTextDocument *renderHint(const QString &text, TextHintMarkupKind kind, const RenderStyle &style, KSyntaxHighlighting::Repository &repository)
+{
+    auto doc = new QTextDocument();
+    doc->setDocumentMargin(5);
+    doc->setDefaultFont(style.font);
+    if (kind == TextHintMarkupKind::PlainText) {
+        doc->setPlainText(text);
+    } else {
+        doc->setMarkdown(text);
+    }
+
+    auto block = doc->firstBlock();
+    for (int i = 0; i < doc->blockCount(); ++i) {
+        auto bfmt = block.blockFormat();
+        // Fix some things for code blocks in markdown
+        if (bfmt.hasProperty(QTextFormat::BlockCodeLanguage)) {
+            QTextCursor c(block);
+            // allow word wrap
+            bfmt.setNonBreakableLines(false);
+            // fix the font, use our own mono font
+            c.select(QTextCursor::BlockUnderCursor);
+            auto cfmt = block.charFormat();
+            cfmt.setFont(style.font);
+            c.mergeBlockFormat(bfmt);
+            c.setCharFormat(cfmt);
+        } else if (bfmt.headingLevel() != 0) {
+            // Make all headings H3
+            QTextCursor c(block);
+            bfmt.setHeadingLevel(3);
+            c.select(QTextCursor::BlockUnderCursor);
+            QTextCharFormat cfmt = block.charFormat();
+            cfmt.setProperty(QTextFormat::FontSizeAdjustment, 0);
+            cfmt.setFontWeight(QFont::Bold);
+            c.mergeBlockFormat(bfmt);
+            c.setCharFormat(cfmt);
+        }
+        block = block.next();
+    }
+
+    // highlight, then keep the result once the highlighter is gone
+    TooltipHighlighter hl(static_cast<QObject *>(nullptr));
+    hl.setDefinition(repository.definitionForName(style.definition));
+    hl.setTheme(repository.theme(style.theme));
+    hl.m_inlineCodeSpanColor = style.inlineCodeSpanColor;
+    hl.m_editorFont = style.font;
+    hl.setDocument(doc);
+    hl.rehighlight();
+    std::vector<std::pair<int, QTextLayout::FormatRange>> formats;
+    for (auto b = doc->firstBlock(); b.isValid(); b = b.next()) {
+        const auto blockFormats = b.layout()->formats();
+        for (const auto &f : blockFormats) {
+            formats.emplace_back(b.position(), f);
+        }
+    }
+    hl.setDocument(nullptr);
+    for (const auto &[position, f] : formats) {
+        QTextCursor c(doc);
+        c.setPosition(position + f.start);
+        c.setPosition(position + f.start + f.length, QTextCursor::KeepAnchor);
+        c.mergeCharFormat(f.format);
+    }
+
+    return doc;
+}
+
+static QByteArray renderKey(const QString &text, TextHintMarkupKind kind, const RenderStyle &style)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const auto &s : {text, style.definition, style.theme, style.font.toString()}) {
+        hash.addData(QByteArrayView(reinterpret_cast<const char *>(s.constData()), s.size() * sizeof(QChar)));
+        hash.addData(QByteArrayView("\0", 1));
+    }
+    hash.addData(QByteArray::number(static_cast<int>(kind)));
+    return hash.result();
+}
+
+// rendered hints, shared by all tooltips
+static QCache<QByteArray, QTextDocument> &renderCache()
+{
+    static QCache<QByteArray, QTextDocument> cache(maxCachedHints);
+    return cache;
+}
+
+static QThreadPool *renderPool()
+{
+    // a single thread, as it needs its own syntax repository
+    static QThreadPool *pool = [] {
+        auto pool = new QThreadPool(qApp);
+        pool->setMaxThreadCount(1);
+        pool->setExpiryTimeout(-1);
+        return pool;
+    }();
+    return pool;
+}
+
 class TooltipPrivate : public QTextBrowser
 {
 public:
@@ -85,7 +208,7 @@ public:
 
             m_view = view;
 
-            m_hl->setDefinition(KTextEditor::Editor::instance()->repository().definitionForFileName(m_view->document()->url().toString()));
+            m_style.definition = KTextEditor::Editor::instance()->repository().definitionForFileName(m_view->document()->url().toString()).name();
 
             if (m_view && m_view->focusProxy()) {
                 m_view->focusProxy()->installEventFilter(this);
@@ -95,7 +218,6 @@ public:
 
     TooltipPrivate(QWidget *parent, bool manual, KTextEditor::Range wordRange)
         : QTextBrowser(parent)
-        , m_hl(new TooltipHighlighter(document()))
         , m_manual(manual)
         , m_hoveredWordRange(wordRange)
     {
@@ -115,7 +237,7 @@ public:
 
         auto updateColors = [this](KTextEditor::Editor *e) {
             auto theme = e->theme();
-            m_hl->setTheme(theme);
+            m_style.theme = theme.name();
 
             auto pal = palette();
             const QColor bg = theme.editorColor(KSyntaxHighlighting::Theme::BackgroundColor);
@@ -130,15 +252,15 @@ public:
             setPalette(pal);
 
             if (bg.lightness() < 127) {
-                m_hl->m_inlineCodeSpanColor = bg.lighter();
+                m_style.inlineCodeSpanColor = bg.lighter();
             } else {
-                m_hl->m_inlineCodeSpanColor = bg.darker(120);
+                m_style.inlineCodeSpanColor = bg.darker(120);
             }
 
             auto newFont = KTextEditor::Editor::instance()->font();
             newFont.setPointSize(font().pointSize());
             setFont(newFont);
-            m_hl->m_editorFont = newFont;
+            m_style.font = newFont;
         };
         updateColors(KTextEditor::Editor::instance());
         connect(KTextEditor::Editor::instance(), &KTextEditor::Editor::configChanged, this, updateColors);
@@ -288,15 +410,15 @@ public:
         this->move(p);
     }
 
-    void upsert(size_t instanceId, const QString &text, TextHintMarkupKind kind)
+    void update(const std::vector<KateTooltip::Hint> &hints)
     {
-        m_hintState.upsert(instanceId, text, kind);
-        triggerChange();
-    }
-
-    void remove(size_t instanceId)
-    {
-        m_hintState.remove(instanceId);
+        for (const auto &hint : hints) {
+            if (hint.text.trimmed().isEmpty()) {
+                m_hintState.remove(hint.instanceId);
+            } else {
+                m_hintState.upsert(hint.instanceId, hint.text, hint.kind);
+            }
+        }
         triggerChange();
     }
 
@@ -343,61 +465,72 @@ private:
     {
         m_hintState.render([this](const HintState::Hint &data) {
             const auto &[text, kind] = data;
-            if (kind == TextHintMarkupKind::PlainText) {
-                setPlainText(text);
-            } else {
-                setMarkdown(text);
+            const auto key = renderKey(text, kind, m_style);
+            const int generation = ++m_renderGeneration;
+            if (auto doc = renderCache().object(key)) {
+                display(doc->clone(this));
+                return;
             }
 
-            auto block = document()->firstBlock();
-            for (int i = 0; i < document()->blockCount(); ++i) {
-                auto bfmt = block.blockFormat();
-                // Fix some things for code blocks in markdown
-                if (bfmt.hasProperty(QTextFormat::BlockCodeLanguage)) {
-                    QTextCursor c(block);
-                    // allow word wrap
-                    bfmt.setNonBreakableLines(false);
-                    // fix the font, use our own mono font
-                    c.select(QTextCursor::BlockUnderCursor);
-                    auto cfmt = block.charFormat();
-                    cfmt.setFont(this->font());
-                    c.mergeBlockFormat(bfmt);
-                    c.setCharFormat(cfmt);
-                } else if (bfmt.headingLevel() != 0) {
-                    // Make all headings H3
-                    QTextCursor c(block);
-                    bfmt.setHeadingLevel(3);
-                    c.select(QTextCursor::BlockUnderCursor);
-                    QTextCharFormat cfmt = block.charFormat();
-                    cfmt.setProperty(QTextFormat::FontSizeAdjustment, 0);
-                    cfmt.setFontWeight(QFont::Bold);
-                    c.mergeBlockFormat(bfmt);
-                    c.setCharFormat(cfmt);
-                }
-                block = block.next();
+            if (text.size() < asyncRenderSize) {
+                auto doc = renderHint(text, kind, m_style, KTextEditor::Editor::instance()->repository());
+                display(doc->clone(this));
+                renderCache().insert(key, doc);
+                return;
             }
 
-            resizeTip();
+            // plain text until rendered
+            auto plain = new QTextDocument(this);
+            plain->setDocumentMargin(5);
+            plain->setDefaultFont(m_style.font);
+            plain->setPlainText(text);
+            display(plain);
+
+            auto render = [text, kind, style = m_style] {
+                thread_local KSyntaxHighlighting::Repository repository;
+                auto doc = renderHint(text, kind, style, repository);
+                doc->moveToThread(qApp->thread());
+                return doc;
+            };
+            QPointer<TooltipPrivate> self(this);
+            QtConcurrent::run(renderPool(), render).then(qApp, [self, key, generation](QTextDocument *doc) {
+                if (self && self->m_renderGeneration == generation) {
+                    self->display(doc->clone(self));
+                }
+                renderCache().insert(key, doc);
+            });
         });
     }
 
+    // show @p doc, which is owned by this
+    void display(QTextDocument *doc)
+    {
+        QTextOption option = doc->defaultTextOption();
+        option.setWrapMode(QTextOption::WordWrap);
+        doc->setDefaultTextOption(option);
+
+        auto previous = m_displayed;
+        m_displayed = doc;
+        setDocument(doc);
+        delete previous;
+        resizeTip();
+    }
+
     bool inContextMenu = false;
     QPointer<KTextEditor::View> m_view;
     QTimer m_hideTimer;
-    TooltipHighlighter *m_hl;
+    RenderStyle m_style;
+    // the document shown, unless still the initial one
+    QTextDocument *m_displayed = nullptr;
+    // to tell whether a rendering in the background is still wanted
+    int m_renderGeneration = 0;
     bool m_manual;
     HintState m_hintState;
     double prevDistance = 0.0;
     const KTextEditor::Range m_hoveredWordRange;
 };
 
-QObject *KateTooltip::show(size_t instanceId,
-                           const QString &text,
-                           TextHintMarkupKind kind,
-                           QPoint pos,
-                           KTextEditor::View *v,
-                           bool manual,
-                           KTextEditor::Range hoveredRange)
+QObject *KateTooltip::show(const std::vector<Hint> &hints, QPoint pos, KTextEditor::View *v, bool manual, KTextEditor::Range hoveredRange)
 {
     if (!v || !v->document()) {
         return nullptr;
@@ -405,23 +538,21 @@ QObject *KateTooltip::show(size_t instanceId,
 
     static QPointer<TooltipPrivate> tooltip = nullptr;
     if (tooltip && tooltip->isVisible()) {
-        if (text.isEmpty() || text.trimmed().isEmpty()) {
-            tooltip->remove(instanceId);
-            return tooltip;
-        }
-
-        tooltip->upsert(instanceId, text, kind);
+        tooltip->update(hints);
         return tooltip;
     }
     delete tooltip;
 
-    if (text.isEmpty() || text.trimmed().isEmpty()) {
+    const bool empty = std::all_of(hints.begin(), hints.end(), [](const Hint &hint) {
+        return hint.text.trimmed().isEmpty();
+    });
+    if (empty) {
         return tooltip;
     }
 
     tooltip = new TooltipPrivate(v, manual, hoveredRange);
     tooltip->setView(v);
-    tooltip->upsert(instanceId, text, kind);
+    tooltip->update(hints);
     tooltip->place(pos);
     tooltip->show();
     return tooltip;
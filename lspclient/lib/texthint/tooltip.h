@@ -6,9 +6,11 @@
 
 #include "KateTextHintManager.h"
 #include <QPoint>
+#include <QString>
+
+#include <vector>
 
 class QWidget;
-class QString;
 
 namespace KTextEditor
 {
@@ -18,6 +20,12 @@ class View;
 class KateTooltip
 {
 public:
-    static QObject *
-    show(size_t instanceId, const QString &text, TextHintMarkupKind kind, QPoint pos, KTextEditor::View *v, bool manual, KTextEditor::Range hoveredRange);
+    struct Hint {
+        size_t instanceId;
+        QString text;
+        TextHintMarkupKind kind;
+    };
+
+    // show all of @p hints at once, an empty one removes that of its instance
+    static QObject *show(const std::vector<Hint> &hints, QPoint pos, KTextEditor::View *v, bool manual, KTextEditor::Range hoveredRange);
 };
@@ -5,6 +5,7 @@
 */
 
 #include "lspclientcompletion.h"
+#include "fuzzyscorer.h"
 #include "lspclientplugin.h"
 #include "lspclientprotocol.h"
 #include "lspclientutils.h"
@@ -15,9 +16,13 @@
 #include <KTextEditor/Editor>
 #include <KTextEditor/View>
 
+#include <QCache>
+#include <QElapsedTimer>
 #include <QIcon>
+#include <QPointer>
 
 #include <algorithm>
+#include <deque>
 #include <utility>
 
 #include <drawing_utils.h>
@@ -177,6 +182,25 @@ static bool compare_match(const LSPCompletionItem &a, const LSPCompletionItem &b
     return a.sortText < b.sortText;
 }
 
+// neighbours of the selected item on either side that are resolved ahead
+static constexpr int ResolveWindow = 5;
+// resolve requests in flight, besides the one for the selected item
+static constexpr int MaxResolving = 4;
+// resolved items kept across completion sessions
+static constexpr int MaxResolvedItems = 1000;
+
+// what completionItem/resolve adds to an item
+struct ResolvedCompletion {
+    LSPMarkupContent documentation;
+    QList<LSPTextEdit> additionalTextEdits;
+};
+
+// the data is opaque to us and only meaningful along with the item it came with
+static QByteArray resolveKey(const LSPCompletionItem &item)
+{
+    return item.originalLabel.toUtf8() + '\0' + item.data;
+}
+
 class LSPClientCompletionImpl : public LSPClientCompletion
 {
     typedef LSPClientCompletionImpl self_type;
@@ -197,6 +221,24 @@ class LSPClientCompletionImpl : public LSPClientCompletion
     QList<LSPClientCompletionItem> m_matches;
     LSPClientServer::RequestHandle m_handle, m_handleSig;
 
+    // last complete server reply, typing on in the same word only refilters it
+    struct CompletionCache {
+        QPointer<KTextEditor::Document> document;
+        // start of the word and what was typed of it when requested
+        KTextEditor::Cursor start = KTextEditor::Cursor::invalid();
+        QString typed;
+        QList<LSPClientCompletionItem> items;
+        QStringList filterTexts;
+    } m_cache;
+    // keystroke to popup
+    QElapsedTimer m_latency;
+
+    // resolved items by resolveKey(), most recently used are kept
+    mutable QCache<QByteArray, ResolvedCompletion> m_resolved{MaxResolvedItems};
+    // resolve requests in flight and those still to send, by resolveKey()
+    mutable QHash<QByteArray, LSPClientServer::RequestHandle> m_resolving;
+    mutable std::deque<LSPCompletionItem> m_resolveQueue;
+
 public:
     LSPClientCompletionImpl(std::shared_ptr<LSPClientServerManager> manager)
         : LSPClientCompletion(nullptr)
@@ -207,6 +249,11 @@ public:
 
     void setServer(std::shared_ptr<LSPClientServer> server) override
     {
+        if (m_server != server) {
+            m_cache = {};
+            cancelResolve();
+            m_resolved.clear();
+        }
         m_server = server;
         if (m_server) {
             const auto &caps = m_server->capabilities();
@@ -272,32 +319,15 @@ public:
         } else if (role == KTextEditor::CodeCompletionModel::IsExpandable) {
             return !match.documentation.value.isEmpty();
         } else if (role == KTextEditor::CodeCompletionModel::ExpandingWidget && !match.documentation.value.isEmpty()) {
-            if (m_server->capabilities().completionProvider.resolveProvider && !match.m_docResolved && !match.data.isNull()) {
-                QPersistentModelIndex pIndex = QPersistentModelIndex(index);
-                auto h = [this, pIndex](const LSPCompletionItem &c) {
-                    if (pIndex.isValid()) {
-                        auto self = const_cast<LSPClientCompletionImpl *>(this);
-                        auto i = QModelIndex(pIndex);
-                        // we only support resolving additionalTextEdits and documentation so only
-                        // update those fields
-                        self->m_matches[i.row()].documentation.value += c.documentation.value;
-                        self->m_matches[i.row()].additionalTextEdits = c.additionalTextEdits;
-                        self->m_matches[i.row()].m_docResolved = true;
-                        self->dataChanged(i, i, {KTextEditor::CodeCompletionModel::ExpandingWidget});
-                    }
-                };
-
-                m_server->documentCompletionResolve(match, this, h);
-                auto self = const_cast<LSPClientCompletionImpl *>(this);
-                self->m_matches[index.row()].m_docResolved = true;
-            }
-
+            // may fill in the documentation of the item
+            prefetchResolve(index.row());
             // probably plaintext, but let's show markdown as-is for now
             // FIXME better presentation of markdown
-            return match.documentation.value;
+            return m_matches.at(index.row()).documentation.value;
         } else if (role == KTextEditor::CodeCompletionModel::ItemSelected && !match.argumentHintDepth && !match.documentation.value.isEmpty()
                    && m_selectedDocumentation) {
-            return match.documentation.value;
+            prefetchResolve(index.row());
+            return m_matches.at(index.row()).documentation.value;
         } else if (role == KTextEditor::CodeCompletionModel::CustomHighlight && match.argumentHintDepth > 0) {
             if (index.column() != Name || match.len == 0)
                 return {};
@@ -316,6 +346,101 @@ public:
         return QVariant();
     }
 
+    static bool needsResolve(const LSPClientCompletionItem &item)
+    {
+        return !item.m_docResolved && !item.argumentHintDepth && !item.data.isNull();
+    }
+
+    // we only support resolving additionalTextEdits and documentation so only
+    // update those fields
+    static void applyResolved(LSPClientCompletionItem &item, const ResolvedCompletion &resolved)
+    {
+        item.documentation.value += resolved.documentation.value;
+        item.additionalTextEdits = resolved.additionalTextEdits;
+        item.m_docResolved = true;
+    }
+
+    /**
+     * Show resolved documentation of the item at @p row, and of its neighbours shortly,
+     * so scrolling through the list does not wait for the server item by item.
+     * The item at @p row is resolved right away, the others a few at a time.
+     */
+    void prefetchResolve(int row) const
+    {
+        if (!m_server || !m_server->capabilities().completionProvider.resolveProvider) {
+            return;
+        }
+        auto self = const_cast<LSPClientCompletionImpl *>(this);
+
+        // the selected item, then its neighbours closest first;
+        // only the neighbours of the latest selection are of interest
+        std::vector<int> rows{row};
+        for (int d = 1; d <= ResolveWindow; ++d) {
+            if (row + d < m_matches.size()) {
+                rows.push_back(row + d);
+            }
+            if (row - d >= 0) {
+                rows.push_back(row - d);
+            }
+        }
+        m_resolveQueue.clear();
+        for (int r : rows) {
+            auto &item = self->m_matches[r];
+            if (!needsResolve(item)) {
+                continue;
+            }
+            // the view asks for the data again anyway, no need to notify from within data()
+            if (auto resolved = m_resolved.object(resolveKey(item))) {
+                applyResolved(item, *resolved);
+            } else if (r == row) {
+                sendResolve(item);
+            } else {
+                m_resolveQueue.push_back(item);
+            }
+        }
+        sendQueuedResolves();
+    }
+
+    void sendQueuedResolves() const
+    {
+        while (!m_resolveQueue.empty() && m_resolving.size() < MaxResolving) {
+            sendResolve(m_resolveQueue.front());
+            m_resolveQueue.pop_front();
+        }
+    }
+
+    void sendResolve(const LSPCompletionItem &item) const
+    {
+        const auto key = resolveKey(item);
+        if (m_resolving.contains(key) || m_resolved.contains(key)) {
+            return;
+        }
+        auto self = const_cast<LSPClientCompletionImpl *>(this);
+        auto h = [self, key](const LSPCompletionItem &c) {
+            self->m_resolving.remove(key);
+            self->m_resolved.insert(key, new ResolvedCompletion{.documentation = c.documentation, .additionalTextEdits = c.additionalTextEdits});
+            const auto &resolved = *self->m_resolved.object(key);
+            for (int r = 0; r < self->m_matches.size(); ++r) {
+                auto &item = self->m_matches[r];
+                if (needsResolve(item) && resolveKey(item) == key) {
+                    applyResolved(item, resolved);
+                    self->dataChanged(self->index(r, 0), self->index(r, ColumnCount - 1), {KTextEditor::CodeCompletionModel::ExpandingWidget});
+                }
+            }
+            self->sendQueuedResolves();
+        };
+        m_resolving.insert(key, m_server->documentCompletionResolve(item, this, h));
+    }
+
+    void cancelResolve()
+    {
+        for (auto &handle : m_resolving) {
+            handle.cancel();
+        }
+        m_resolving.clear();
+        m_resolveQueue.clear();
+    }
+
     bool shouldStartCompletion(KTextEditor::View *view, const QString &insertedText, bool userInsertion, const KTextEditor::Cursor &position) override
     {
         if (!m_showCompletion) {
@@ -366,24 +491,36 @@ public:
             m_triggerSignature = m_triggersSignature.contains(c);
         }
 
+        m_latency.start();
+        auto document = view->document();
+        // the default range is determined based on a reasonable identifier (word)
+        // which is generally fine and nice, but let's pass actual cursor position
+        // (which may be within this typical range)
+        const auto position = view->cursorPosition();
+        const auto cursor = qMax(range.start(), qMin(range.end(), position));
+        const auto typed = document ? document->text({range.start(), cursor}) : QString();
+
         // maybe use WaitForReset ??
         // but more complex and already looks good anyway
-        auto handler = [this](const QList<LSPCompletionItem> &completion) {
-            beginResetModel();
-            //qCInfo(LSPCLIENT) << "adding completions " << completion.size();
-            // purge all existing completion items
-            m_matches.erase(std::remove_if(m_matches.begin(),
-                                           m_matches.end(),
-                                           [](const LSPClientCompletionItem &ci) {
-                                               return ci.argumentHintDepth == 0;
-                                           }),
-                            m_matches.end());
-            for (const auto &item : completion) {
-                m_matches.push_back(item);
+        auto handler = [this, document = QPointer<KTextEditor::Document>(document), start = range.start(), typed](const LSPCompletionList &completion) {
+            QList<LSPClientCompletionItem> items;
+            items.reserve(completion.items.size());
+            for (const auto &item : completion.items) {
+                items.push_back(item);
             }
-            std::stable_sort(m_matches.begin(), m_matches.end(), compare_match);
-            setRowCount(m_matches.size());
-            endResetModel();
+            std::stable_sort(items.begin(), items.end(), compare_match);
+            if (completion.isIncomplete) {
+                m_cache = {};
+            } else {
+                QStringList filterTexts;
+                filterTexts.reserve(items.size());
+                for (const auto &item : items) {
+                    filterTexts.push_back(item.filterText);
+                }
+                m_cache = {.document = document, .start = start, .typed = typed, .items = items, .filterTexts = filterTexts};
+            }
+            setCompletions(std::move(items));
+            qCDebug(LSPCLIENT) << "completion latency (server):" << m_latency.elapsed() << "ms," << completion.items.size() << "items";
         };
 
         auto sigHandler = [this](const LSPSignatureHelp &sig) {
@@ -414,17 +551,22 @@ public:
 
         beginResetModel();
         m_matches.clear();
-        auto document = view->document();
         if (m_server && document) {
-            // the default range is determined based on a reasonable identifier (word)
-            // which is generally fine and nice, but let's pass actual cursor position
-            // (which may be within this typical range)
-            auto position = view->cursorPosition();
-            auto cursor = qMax(range.start(), qMin(range.end(), position));
             m_manager->update(document, false);
 
             if (m_triggerCompletion || userInvocation) {
-                m_handle = m_server->documentCompletion(document->url(), {cursor.line(), cursor.column()}, this, handler);
+                // a complete list for the start of the word also holds for more of it
+                const bool cached = !userInvocation && m_cache.document == document && m_cache.start == range.start()
+                    && cursor.line() == range.start().line() && typed.startsWith(m_cache.typed);
+                m_handle.cancel();
+                if (cached) {
+                    m_matches = refilter(m_cache, typed);
+                    qCDebug(LSPCLIENT) << "completion latency (cached):" << m_latency.nsecsElapsed() / 1000 << "us," << m_matches.size() << "of"
+                                       << m_cache.items.size() << "items";
+                } else {
+                    m_cache = {};
+                    m_handle = m_server->documentCompletion(document->url(), {cursor.line(), cursor.column()}, this, handler);
+                }
             }
 
             if (m_signatureHelp && m_triggerSignature) {
@@ -435,6 +577,37 @@ public:
         endResetModel();
     }
 
+    void setCompletions(QList<LSPClientCompletionItem> items)
+    {
+        beginResetModel();
+        // purge all existing completion items, keep the signatures
+        m_matches.erase(std::remove_if(m_matches.begin(),
+                                       m_matches.end(),
+                                       [](const LSPClientCompletionItem &ci) {
+                                           return ci.argumentHintDepth == 0;
+                                       }),
+                        m_matches.end());
+        m_matches.append(std::move(items));
+        std::stable_sort(m_matches.begin(), m_matches.end(), compare_match);
+        setRowCount(m_matches.size());
+        endResetModel();
+    }
+
+    /**
+     * Cached items (sorted by sortText) that fuzzy match @p typed, best first.
+     * Equally good ones keep the order of the server.
+     */
+    static QList<LSPClientCompletionItem> refilter(const CompletionCache &cache, const QString &typed)
+    {
+        const auto matches = FuzzyScorer::topMatches(typed, cache.filterTexts);
+        QList<LSPClientCompletionItem> ret;
+        ret.reserve(matches.size());
+        for (const auto &m : matches) {
+            ret.push_back(cache.items[m.index]);
+        }
+        return ret;
+    }
+
     /**
      * @brief return next char *after* the range
      */
@@ -500,7 +673,12 @@ public:
         }
 
         QChar next = peekNextChar(view->document(), word);
-        const auto item = m_matches.at(index.row());
+        auto item = m_matches.at(index.row());
+        if (needsResolve(item)) {
+            if (auto resolved = m_resolved.object(resolveKey(item))) {
+                applyResolved(item, *resolved);
+            }
+        }
         QString matching = m_matches.at(index.row()).insertText;
         // if there is already a '"' or >, remove it, this happens with #include "xx.h"
         if ((next == QLatin1Char('"') && matching.endsWith(QLatin1Char('"'))) || (next == QLatin1Char('>') && matching.endsWith(QLatin1Char('>')))) {
@@ -522,7 +700,7 @@ public:
 
         // NOTE: view->setCursorPosition() will invalidate the matches, so we save the
         // additionalTextEdits before setting cursor-possition
-        const auto additionalTextEdits = m_matches.at(index.row()).additionalTextEdits;
+        const auto additionalTextEdits = item.additionalTextEdits;
         if (m_complParens) {
             const auto [col, textToInsert] = stripSnippetMarkers(matching);
             //qCInfo(LSPCLIENT) << "original text: " << matching << ", snippet markers removed; " << textToInsert;
@@ -578,7 +756,10 @@ public:
         m_matches.clear();
         m_handle.cancel();
         m_handleSig.cancel();
+        cancelResolve();
         m_triggerSignature = false;
+        // the document may change anywhere until the next time
+        m_cache = {};
         endResetModel();
     }
 };
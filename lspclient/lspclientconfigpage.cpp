@@ -61,6 +61,7 @@ LSPClientConfigPage::LSPClientConfigPage(QWidget *parent, LSPClientPlugin *plugi
              ui->chkOnTypeFormatting,
              ui->chkIncrementalSync,
              ui->chkHighlightGoto,
+             ui->chkAutoHighlight,
              ui->chkSemanticHighlighting,
              ui->chkAutoHover,
              ui->chkSignatureHelp,
@@ -128,6 +129,7 @@ void LSPClientConfigPage::apply()
     m_plugin->m_onTypeFormatting = ui->chkOnTypeFormatting->isChecked();
     m_plugin->m_incrementalSync = ui->chkIncrementalSync->isChecked();
     m_plugin->m_highlightGoto = ui->chkHighlightGoto->isChecked();
+    m_plugin->m_autoHighlight = ui->chkAutoHighlight->isChecked();
     m_plugin->m_semanticHighlighting = ui->chkSemanticHighlighting->isChecked();
     m_plugin->m_signatureHelp = ui->chkSignatureHelp->isChecked();
     m_plugin->m_autoImport = ui->chkAutoImport->isChecked();
@@ -173,6 +175,7 @@ void LSPClientConfigPage::reset()
     ui->chkOnTypeFormatting->setChecked(m_plugin->m_onTypeFormatting);
     ui->chkIncrementalSync->setChecked(m_plugin->m_incrementalSync);
     ui->chkHighlightGoto->setChecked(m_plugin->m_highlightGoto);
+    ui->chkAutoHighlight->setChecked(m_plugin->m_autoHighlight);
     ui->chkSemanticHighlighting->setChecked(m_plugin->m_semanticHighlighting);
     ui->chkSignatureHelp->setChecked(m_plugin->m_signatureHelp);
     ui->chkAutoImport->setChecked(m_plugin->m_autoImport);
@@ -11,6 +11,10 @@
 #include <KTextEditor/Document>
 #include <KTextEditor/View>
 
+#include <QCache>
+#include <QPointer>
+#include <QTimer>
+
 #include "lspclientserver.h"
 #include "lspclientservermanager.h"
 #include "texthint/KateTextHintManager.h"
@@ -28,6 +32,49 @@ static TextHintMarkupKind toKateMarkupKind(LSPMarkupKind kind)
     return TextHintMarkupKind::PlainText;
 }
 
+// how long the cursor rests before prefetching
+static constexpr int prefetchDelay = 750;
+// identifiers prefetched on either side of the cursor
+static constexpr int prefetchWords = 3;
+static constexpr int maxCachedHovers = 256;
+
+namespace
+{
+// hover info is that of an identifier in some revision of a document
+struct HoverKey {
+    KTextEditor::Document *doc = nullptr;
+    qint64 revision = -1;
+    KTextEditor::Range range;
+
+    bool operator==(const HoverKey &other) const = default;
+};
+
+size_t qHash(const HoverKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.doc, key.revision, key.range.start().line(), key.range.start().column(), key.range.end().column());
+}
+}
+
+static HoverKey hoverKey(KTextEditor::Document *doc, const KTextEditor::Cursor &position)
+{
+    return {.doc = doc, .revision = doc->revision(), .range = doc->wordRangeAt(position)};
+}
+
+// combine contents elements to one string
+static QString hoverText(const LSPHover &info, LSPMarkupKind &kind)
+{
+    kind = LSPMarkupKind::PlainText;
+    QString text;
+    for (auto &element : info.contents) {
+        kind = element.kind;
+        if (!text.isEmpty()) {
+            text.append(QLatin1Char('\n'));
+        }
+        text.append(element.value);
+    }
+    return text;
+}
+
 class LSPClientHoverImpl : public LSPClientHover
 {
     typedef LSPClientHoverImpl self_type;
@@ -38,19 +85,53 @@ class LSPClientHoverImpl : public LSPClientHover
     LSPClientServer::RequestHandle m_handle;
     KateTextHintProvider *m_textHintProvider;
 
+    // replies so far, stale ones are simply no longer asked for
+    QCache<HoverKey, LSPHover> m_cache;
+
+    QPointer<KTextEditor::View> m_view;
+    QTimer m_prefetchTimer;
+    LSPClientServer::RequestHandle m_prefetchHandle;
+
 public:
     explicit LSPClientHoverImpl(std::shared_ptr<LSPClientServerManager> manager, KateTextHintProvider *provider)
         : m_manager(std::move(manager))
         , m_server(nullptr)
         , m_textHintProvider(provider)
+        , m_cache(maxCachedHovers)
     {
+        m_prefetchTimer.setSingleShot(true);
+        m_prefetchTimer.callOnTimeout(this, &self_type::startPrefetch);
     }
 
     void setServer(std::shared_ptr<LSPClientServer> server) override
     {
+        if (server != m_server) {
+            m_cache.clear();
+            cancelPrefetch();
+        }
         m_server = server;
     }
 
+    void setView(KTextEditor::View *view) override
+    {
+        if (view == m_view) {
+            return;
+        }
+        if (m_view) {
+            disconnect(m_view, nullptr, this, nullptr);
+        }
+        cancelPrefetch();
+        m_view = view;
+        if (view) {
+            connect(view, &KTextEditor::View::cursorPositionChanged, this, [this] {
+                cancelPrefetch();
+                m_prefetchTimer.start(prefetchDelay);
+            });
+            connect(view->document(), &KTextEditor::Document::aboutToClose, this, &self_type::purge, Qt::UniqueConnection);
+            m_prefetchTimer.start(prefetchDelay);
+        }
+    }
+
     QString showTextHint(KTextEditor::View *view, const KTextEditor::Cursor &position, bool manual) override
     {
         if (!position.isValid()) {
@@ -73,16 +154,8 @@ public:
                     return;
                 }
 
-                // combine contents elements to one string
-                LSPMarkupKind kind = LSPMarkupKind::PlainText;
-                QString finalTooltip;
-                for (auto &element : info.contents) {
-                    kind = element.kind;
-                    if (!finalTooltip.isEmpty()) {
-                        finalTooltip.append(QLatin1Char('\n'));
-                    }
-                    finalTooltip.append(element.value);
-                }
+                LSPMarkupKind kind;
+                const auto finalTooltip = hoverText(info, kind);
 
                 // make sure there is no selection, otherwise we interrupt
                 if (!v->selection()) {
@@ -97,12 +170,117 @@ public:
                     emitHint({}, LSPMarkupKind::PlainText);
                     return {};
                 }
-                m_handle.cancel() = m_server->documentHover(view->document()->url(), position, this, h);
+
+                const auto key = hoverKey(doc, position);
+                if (auto info = m_cache.object(key)) {
+                    m_handle.cancel();
+                    h(*info);
+                    return {};
+                }
+
+                // this one goes first
+                cancelPrefetch();
+                QPointer<KTextEditor::Document> d(doc);
+                auto store = [this, d, key, h](const LSPHover &info) {
+                    cache(d, key, info);
+                    h(info);
+                };
+                m_handle.cancel() = m_server->documentHover(doc->url(), position, this, store);
+                m_prefetchTimer.start(prefetchDelay);
             }
         }
 
         return QString();
     }
+
+private:
+    void cache(const QPointer<KTextEditor::Document> &doc, const HoverKey &key, const LSPHover &info)
+    {
+        // a reply for a revision since edited may no longer match the identifier,
+        // and nothing may only mean the server is not ready yet
+        if (doc && doc->revision() == key.revision && !info.contents.isEmpty()) {
+            m_cache.insert(key, new LSPHover(info));
+        }
+    }
+
+    void purge(KTextEditor::Document *doc)
+    {
+        const auto keys = m_cache.keys();
+        for (const auto &key : keys) {
+            if (key.doc == doc) {
+                m_cache.remove(key);
+            }
+        }
+    }
+
+    void cancelPrefetch()
+    {
+        m_prefetchTimer.stop();
+        m_prefetchHandle.cancel();
+    }
+
+    // ask for the identifier at the cursor and those next to it on its line, all in one batch
+    void startPrefetch()
+    {
+        if (!m_server || !m_view || m_view->selection()) {
+            return;
+        }
+
+        const auto cursor = m_view->cursorPosition();
+        const auto text = m_view->document()->line(cursor.line());
+        auto isWordChar = [](QChar c) {
+            return c.isLetterOrNumber() || c == QLatin1Char('_');
+        };
+        std::vector<int> before;
+        std::vector<int> after;
+        for (int i = 0; i < text.size();) {
+            if (!isWordChar(text[i])) {
+                ++i;
+                continue;
+            }
+            const int start = i;
+            while (i < text.size() && isWordChar(text[i])) {
+                ++i;
+            }
+            if (i < cursor.column()) {
+                before.push_back(start);
+            } else if (start > cursor.column()) {
+                after.push_back(start);
+            }
+        }
+
+        std::vector<KTextEditor::Cursor> candidates{cursor};
+        for (int i = 0; i < prefetchWords; ++i) {
+            if (i < int(before.size())) {
+                candidates.push_back({cursor.line(), before[before.size() - 1 - i]});
+            }
+            if (i < int(after.size())) {
+                candidates.push_back({cursor.line(), after[i]});
+            }
+        }
+
+        auto doc = m_view->document();
+        QList<LSPPosition> positions;
+        QList<HoverKey> keys;
+        for (const auto &position : candidates) {
+            const auto key = hoverKey(doc, position);
+            if (key.range.isValid() && !key.range.isEmpty() && !m_cache.contains(key)) {
+                positions.push_back(position);
+                keys.push_back(key);
+            }
+        }
+        if (positions.isEmpty()) {
+            return;
+        }
+
+        QPointer<KTextEditor::Document> d(doc);
+        m_prefetchHandle.cancel();
+        m_prefetchHandle = m_server->documentHoverBatch(doc->url(), positions, this, [this, d, keys](const QList<LSPHover> &infos) {
+            for (int i = 0; i < infos.size(); ++i) {
+                cache(d, keys[i], infos[i]);
+            }
+        });
+    }
 };
 
 LSPClientHover *LSPClientHover::new_(std::shared_ptr<LSPClientServerManager> manager, class KateTextHintProvider *provider)
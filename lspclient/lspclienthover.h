@@ -31,6 +31,9 @@ public:
 
     virtual void setServer(std::shared_ptr<LSPClientServer> server) = 0;
 
+    // view whose cursor is followed, hovers around it are fetched ahead while it rests
+    virtual void setView(KTextEditor::View *view) = 0;
+
     // support additional parameters besides the usual interface signature
     virtual QString showTextHint(KTextEditor::View *view, const KTextEditor::Cursor &position, bool manual) = 0;
 };
@@ -34,6 +34,7 @@ static constexpr char CONFIG_AUTO_HOVER[] = "AutoHover";
 static constexpr char CONFIG_TYPE_FORMATTING[] = "TypeFormatting";
 static constexpr char CONFIG_INCREMENTAL_SYNC[] = "IncrementalSync";
 static constexpr char CONFIG_HIGHLIGHT_GOTO[] = "HighlightGoto";
+static constexpr char CONFIG_AUTO_HIGHLIGHT[] = "AutoHighlight";
 static constexpr char CONFIG_DIAGNOSTICS[] = "Diagnostics";
 static constexpr char CONFIG_MESSAGES[] = "Messages";
 static constexpr char CONFIG_SERVER_CONFIG[] = "ServerConfiguration";
@@ -122,6 +123,7 @@ void LSPClientPlugin::readConfig()
     m_onTypeFormatting = config.readEntry(CONFIG_TYPE_FORMATTING, false);
     m_incrementalSync = config.readEntry(CONFIG_INCREMENTAL_SYNC, false);
     m_highlightGoto = config.readEntry(CONFIG_HIGHLIGHT_GOTO, true);
+    m_autoHighlight = config.readEntry(CONFIG_AUTO_HIGHLIGHT, false);
     m_diagnostics = config.readEntry(CONFIG_DIAGNOSTICS, true);
     m_messages = config.readEntry(CONFIG_MESSAGES, true);
     m_configPath = config.readEntry(CONFIG_SERVER_CONFIG, QUrl());
@@ -160,6 +162,7 @@ void LSPClientPlugin::writeConfig() const
     config.writeEntry(CONFIG_TYPE_FORMATTING, m_onTypeFormatting);
     config.writeEntry(CONFIG_INCREMENTAL_SYNC, m_incrementalSync);
     config.writeEntry(CONFIG_HIGHLIGHT_GOTO, m_highlightGoto);
+    config.writeEntry(CONFIG_AUTO_HIGHLIGHT, m_autoHighlight);
     config.writeEntry(CONFIG_DIAGNOSTICS, m_diagnostics);
     config.writeEntry(CONFIG_MESSAGES, m_messages);
     config.writeEntry(CONFIG_SERVER_CONFIG, m_configPath);
@@ -63,6 +63,7 @@ public:
     bool m_onTypeFormatting = false;
     bool m_incrementalSync = false;
     bool m_highlightGoto = true;
+    bool m_autoHighlight = false;
     QUrl m_configPath;
     bool m_semanticHighlighting = false;
     bool m_signatureHelp = true;
@@ -5,6 +5,7 @@
 */
 
 #include "lspclientpluginview.h"
+#include "callhierarchy.h"
 #include "diagnostics/diagnosticview.h"
 #include "gotosymboldialog.h"
 #include "inlayhints.h"
@@ -14,6 +15,7 @@
 #include "lspclientservermanager.h"
 #include "lspclientsymbolview.h"
 #include "lspclientutils.h"
+#include "occurrencehighlighter.h"
 #include "texthint/KateTextHintManager.h"
 
 #include "lspclient_debug.h"
@@ -38,10 +40,14 @@
 #include <ktexteditor/movingrange.h>
 #include <ktexteditor_version.h>
 
+#include <QAbstractItemModel>
 #include <QAction>
 #include <QApplication>
+#include <QCache>
 #include <QClipboard>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileDialog>
 #include <QFileInfo>
 #include <QHBoxLayout>
 #include <QHeaderView>
@@ -54,6 +60,7 @@
 #include <QPainter>
 #include <QPlainTextEdit>
 #include <QPushButton>
+#include <QSaveFile>
 #include <QScopeGuard>
 #include <QSet>
 #include <QStandardItem>
@@ -61,6 +68,10 @@
 #include <QStyledItemDelegate>
 #include <QTimer>
 #include <QTreeView>
+#include <QtConcurrentRun>
+#include <algorithm>
+#include <cstring>
+#include <span>
 #include <unordered_map>
 #include <utility>
 
@@ -128,41 +139,250 @@ static KTextEditor::Document *findDocument(KTextEditor::MainWindow *mainWindow,
 
 // helper to read lines from unopened documents
 // lightweight and does not require additional symbols
-class FileLineReader
+namespace FileLineReader
 {
-    QFile file;
-    int lastLineNo = -1;
-    QString lastLine;
+// (trimmed) text of @p lines of local file @p path, may run on any thread
+static QHash<int, QString> read(const QString &path, std::vector<int> lines)
+{
+    QHash<int, QString> ret;
+    QFile file(path);
+    if (lines.empty() || !file.open(QIODevice::ReadOnly)) {
+        return ret;
+    }
+
+    // only look at what is needed of a possibly large file
+    QByteArray buffer;
+    qint64 size = file.size();
+    auto data = size > 0 ? reinterpret_cast<const char *>(file.map(0, size)) : nullptr;
+    if (!data) {
+        // not mappable, e.g. not a regular file
+        buffer = file.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+    const char *const end = data + size;
+
+    std::sort(lines.begin(), lines.end());
+    lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+    const char *begin = data;
+    int lineno = 0;
+    for (int wanted : lines) {
+        // memchr is vectorized by the C library
+        while (lineno < wanted && begin < end) {
+            auto nl = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+            begin = nl ? nl + 1 : end;
+            ++lineno;
+        }
+        if (lineno < wanted || begin >= end) {
+            break;
+        }
+        auto nl = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+        const QByteArrayView line(begin, nl ? nl : end);
+
+        auto toUtf16 = QStringDecoder(QStringDecoder::Utf8);
+        QString text = toUtf16(line);
+        if (toUtf16.hasError()) {
+            text = QString::fromLatin1(line);
+        }
+        ret.insert(wanted, text.trimmed());
+    }
+    return ret;
+}
+
+// lines read so far by file and modification time, a file tends to show up in several searches
+static QCache<QString, QHash<int, QString>> &cache()
+{
+    static QCache<QString, QHash<int, QString>> lines(200);
+    return lines;
+}
+
+static QString cacheKey(const QString &path)
+{
+    return QStringLiteral("%1@%2").arg(path).arg(QFileInfo(path).lastModified().toMSecsSinceEpoch());
+}
+}
 
+/**
+ * Locations of a request result, grouped by file with a file per top-level row.
+ * Rows are only indices into a sorted location array, so nothing is created per location,
+ * and the line of a location is only read once some row of its file is shown.
+ */
+class LocationModel : public QAbstractItemModel
+{
 public:
-    FileLineReader(const QUrl &url)
-        : file(url.toLocalFile())
+    struct Location {
+        LSPRange range;
+        LSPDocumentHighlightKind kind = LSPDocumentHighlightKind::Text;
+    };
+
+    struct File {
+        QUrl url;
+        QString text;
+        // locations [first, first + count)
+        int first = 0;
+        int count = 0;
+    };
+
+    LocationModel(KTextEditor::MainWindow *mainWindow, std::vector<File> files, std::vector<Location> locations)
+        : m_mainWindow(mainWindow)
+        , m_files(std::move(files))
+        , m_locations(std::move(locations))
+        , m_lines(m_locations.size())
+        , m_linesRequested(m_files.size())
     {
-        file.open(QIODevice::ReadOnly);
+        for (int i = 0; i < int(m_files.size()); ++i) {
+            m_fileIndex.insert(m_files[i].url, i);
+        }
     }
 
-    // called with non-descending lineno
-    QString line(int lineno)
+    // locations in @p url
+    std::span<const Location> locations(const QUrl &url) const
     {
-        if (lineno == lastLineNo) {
-            return lastLine;
+        auto it = m_fileIndex.find(url);
+        if (it == m_fileIndex.end()) {
+            return {};
+        }
+        const auto &file = m_files[*it];
+        return std::span(m_locations).subspan(file.first, file.count);
+    }
+
+    // whether all can be shown expanded
+    bool autoExpand() const
+    {
+        return m_autoExpand;
+    }
+
+    void setAutoExpand(bool expand)
+    {
+        m_autoExpand = expand;
+    }
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = {}) const override
+    {
+        if (column != 0 || row < 0 || row >= rowCount(parent)) {
+            return {};
+        }
+        return createIndex(row, column, parent.isValid() ? quintptr(parent.row() + 1) : FileRow);
+    }
+
+    QModelIndex parent(const QModelIndex &child) const override
+    {
+        if (!child.isValid() || child.internalId() == FileRow) {
+            return {};
+        }
+        return createIndex(int(child.internalId() - 1), 0, FileRow);
+    }
+
+    int rowCount(const QModelIndex &parent = {}) const override
+    {
+        if (!parent.isValid()) {
+            return int(m_files.size());
+        }
+        return parent.internalId() == FileRow ? m_files[parent.row()].count : 0;
+    }
+
+    int columnCount(const QModelIndex & = {}) const override
+    {
+        return 1;
+    }
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override
+    {
+        if (!index.isValid()) {
+            return {};
+        }
+        if (index.internalId() == FileRow) {
+            return role == Qt::DisplayRole ? QVariant(m_files[index.row()].text) : QVariant();
+        }
+
+        const int file = int(index.internalId() - 1);
+        const int i = m_files[file].first + index.row();
+        const auto &location = m_locations[i];
+        switch (role) {
+        case Qt::DisplayRole:
+            // line text is added once it is known
+            fetchLines(file);
+            return i18n("Line: %1: ", location.range.start().line() + 1).append(m_lines[i]);
+        case RangeData::FileUrlRole:
+            return m_files[file].url;
+        case RangeData::RangeRole:
+            return QVariant::fromValue(location.range);
+        case RangeData::KindRole:
+            return static_cast<int>(location.kind);
+        }
+        return {};
+    }
+
+private:
+    // internal id of file rows, that of a location row is its file row + 1
+    static constexpr quintptr FileRow = 0;
+
+    // obtain the lines of all locations in @p file, in the background if not open
+    void fetchLines(int file) const
+    {
+        if (m_linesRequested[file]) {
+            return;
+        }
+        m_linesRequested[file] = true;
+
+        const auto &f = m_files[file];
+        auto lineno = [this](int i) {
+            return m_locations[i].range.start().line();
+        };
+        if (auto doc = findDocument(m_mainWindow, f.url)) {
+            for (int i = f.first; i < f.first + f.count; ++i) {
+                m_lines[i] = doc->line(lineno(i));
+            }
+            return;
         }
-        while (file.isOpen() && !file.atEnd()) {
-            auto line = file.readLine();
-            if (++lastLineNo == lineno) {
-                auto toUtf16 = QStringDecoder(QStringDecoder::Utf8);
-                QString text = toUtf16(line);
-                if (toUtf16.hasError()) {
-                    text = QString::fromLatin1(line);
-                }
 
-                text = text.trimmed();
-                lastLine = text;
-                return text;
+        const auto path = f.url.toLocalFile();
+        const auto key = FileLineReader::cacheKey(path);
+        std::vector<int> lines;
+        lines.reserve(f.count);
+        for (int i = f.first; i < f.first + f.count; ++i) {
+            lines.push_back(lineno(i));
+        }
+        auto cached = FileLineReader::cache().object(key);
+        if (cached && std::all_of(lines.begin(), lines.end(), [cached](int l) {
+                return cached->contains(l);
+            })) {
+            for (int i = f.first; i < f.first + f.count; ++i) {
+                m_lines[i] = cached->value(lineno(i));
             }
+            return;
+        }
+
+        auto self = const_cast<LocationModel *>(this);
+        QtConcurrent::run(FileLineReader::read, path, lines).then(self, [self, file, key](const QHash<int, QString> &text) {
+            auto &cache = FileLineReader::cache();
+            if (auto cached = cache.object(key)) {
+                cached->insert(text);
+            } else {
+                cache.insert(key, new QHash<int, QString>(text));
+            }
+            self->setLines(file, text);
+        });
+    }
+
+    void setLines(int file, const QHash<int, QString> &text)
+    {
+        const auto &f = m_files[file];
+        for (int i = f.first; i < f.first + f.count; ++i) {
+            m_lines[i] = text.value(m_locations[i].range.start().line());
         }
-        return QString();
+        auto parent = index(file, 0);
+        Q_EMIT dataChanged(index(0, 0, parent), index(f.count - 1, 0, parent), {Qt::DisplayRole});
     }
+
+    KTextEditor::MainWindow *m_mainWindow;
+    std::vector<File> m_files;
+    std::vector<Location> m_locations;
+    QHash<QUrl, int> m_fileIndex;
+    // filled per file on demand
+    mutable std::vector<QString> m_lines;
+    mutable std::vector<bool> m_linesRequested;
+    bool m_autoExpand = false;
 };
 
 class CloseAllowedMessageBox : public QMessageBox
@@ -361,6 +581,8 @@ class LSPClientPluginViewImpl : public QObject, public KXMLGUIClient
     QPointer<QAction> m_findTypeDef;
     QPointer<QAction> m_findRef;
     QPointer<QAction> m_findImpl;
+    QPointer<QAction> m_incomingCalls;
+    QPointer<QAction> m_outgoingCalls;
     QPointer<QAction> m_triggerHighlight;
     QPointer<QAction> m_triggerSymbolInfo;
     QPointer<QAction> m_triggerGotoSymbol;
@@ -377,6 +599,7 @@ class LSPClientPluginViewImpl : public QObject, public KXMLGUIClient
     QPointer<QAction> m_onTypeFormatting;
     QPointer<QAction> m_incrementalSync;
     QPointer<QAction> m_highlightGoto;
+    QPointer<QAction> m_autoHighlight;
     QPointer<QAction> m_diagnostics;
     QPointer<QAction> m_messages;
     QPointer<QAction> m_closeDynamic;
@@ -398,9 +621,9 @@ class LSPClientPluginViewImpl : public QObject, public KXMLGUIClient
     typedef QSet<KTextEditor::Document *> DocumentCollection;
     DocumentCollection m_marks;
     // modelis either owned by tree added to tabwidget or owned here
-    std::unique_ptr<QStandardItemModel> m_ownedModel;
+    std::unique_ptr<LocationModel> m_ownedModel;
     // in either case, the model that directs applying marks/ranges
-    QPointer<QStandardItemModel> m_markModel;
+    QPointer<LocationModel> m_markModel;
     // goto definition and declaration jump list is more a menu than a
     // search result, so let's not keep adding new tabs for those
     // previous tree for definition result
@@ -409,6 +632,8 @@ class LSPClientPluginViewImpl : public QObject, public KXMLGUIClient
     QPointer<QTreeView> m_declTree;
     // ... and for type definition
     QPointer<QTreeView> m_typeDefTree;
+    // a call hierarchy is explored rather than searched, so only keep one
+    QPointer<QTreeView> m_callTree;
 
     // views on which completions have been registered
     QList<KTextEditor::View *> m_completionViews;
@@ -431,6 +656,7 @@ class LSPClientPluginViewImpl : public QObject, public KXMLGUIClient
 
     SemanticHighlighter m_semHighlightingManager;
     InlayHintsManager m_inlayHintsHandler;
+    OccurrenceHighlighter m_occurrenceHighlighter;
 
     class LSPDiagnosticProvider : public DiagnosticsProvider
     {
@@ -470,6 +696,7 @@ public:
         , m_symbolView(LSPClientSymbolView::new_(plugin, mainWin, m_serverManager))
         , m_semHighlightingManager(m_serverManager)
         , m_inlayHintsHandler(m_serverManager, this)
+        , m_occurrenceHighlighter(m_serverManager)
         , m_diagnosticProvider(mainWin, this)
     {
         KXMLGUIClient::setComponentName(QStringLiteral("lspclient"), i18n("LSP Client"));
@@ -480,6 +707,9 @@ public:
         connect(m_serverManager.get(), &LSPClientServerManager::serverChanged, this, &self_type::onServerChanged);
         connect(m_plugin, &LSPClientPlugin::showMessage, this, &self_type::onShowMessage);
         connect(m_serverManager.get(), &LSPClientServerManager::serverShowMessage, this, &self_type::onMessage);
+        connect(m_serverManager.get(), &LSPClientServerManager::serverDiagnostics, this, [this](LSPClientServer *, const LSPPublishDiagnosticsParams &diagnostics) {
+            onDiagnostics(diagnostics);
+        });
         connect(m_serverManager.get(), &LSPClientServerManager::serverLogMessage, this, [this](LSPClientServer *server, LSPLogMessageParams params) {
             switch (params.type) {
             case LSPMessageType::Error:
@@ -511,6 +741,14 @@ public:
         KActionCollection::setDefaultShortcut(m_findRef, QKeySequence(Qt::CTRL | Qt::ALT | Qt::Key_L));
         m_findImpl = actionCollection()->addAction(QStringLiteral("lspclient_find_implementations"), this, &self_type::findImplementation);
         m_findImpl->setText(i18n("Find Implementations"));
+        m_incomingCalls = actionCollection()->addAction(QStringLiteral("lspclient_incoming_calls"), this, [this] {
+            callHierarchy(CallHierarchyModel::Direction::Incoming);
+        });
+        m_incomingCalls->setText(i18n("Find Incoming Calls"));
+        m_outgoingCalls = actionCollection()->addAction(QStringLiteral("lspclient_outgoing_calls"), this, [this] {
+            callHierarchy(CallHierarchyModel::Direction::Outgoing);
+        });
+        m_outgoingCalls->setText(i18n("Find Outgoing Calls"));
         m_triggerHighlight = actionCollection()->addAction(QStringLiteral("lspclient_highlight"), this, &self_type::highlight);
         m_triggerHighlight->setText(i18n("Highlight"));
         m_triggerSymbolInfo = actionCollection()->addAction(QStringLiteral("lspclient_symbol_info"), this, &self_type::symbolInfo);
@@ -579,6 +817,9 @@ public:
         m_highlightGoto = actionCollection()->addAction(QStringLiteral("lspclient_highlight_goto"), this, &self_type::displayOptionChanged);
         m_highlightGoto->setText(i18n("Highlight goto location"));
         m_highlightGoto->setCheckable(true);
+        m_autoHighlight = actionCollection()->addAction(QStringLiteral("lspclient_auto_highlight"), this, &self_type::displayOptionChanged);
+        m_autoHighlight->setText(i18n("Highlight symbol occurrences"));
+        m_autoHighlight->setCheckable(true);
         m_inlayHints = actionCollection()->addAction(QStringLiteral("lspclient_inlay_hint"), this, [this](bool checked) {
             if (!checked) {
                 m_inlayHintsHandler.disable();
@@ -621,6 +862,8 @@ public:
         auto *lspOther = new QMenu();
         lspOtherAction->setMenu(lspOther);
         lspOther->addAction(m_findImpl);
+        lspOther->addAction(m_incomingCalls);
+        lspOther->addAction(m_outgoingCalls);
         lspOther->addAction(m_triggerHighlight);
         lspOther->addAction(m_triggerGotoSymbol);
         lspOther->addAction(m_expandMacro);
@@ -645,6 +888,7 @@ public:
         moreOptions->addAction(m_onTypeFormatting);
         moreOptions->addAction(m_incrementalSync);
         moreOptions->addAction(m_highlightGoto);
+        moreOptions->addAction(m_autoHighlight);
         moreOptions->addAction(m_inlayHints);
         moreOptions->addSeparator();
         moreOptions->addAction(m_diagnostics);
@@ -891,6 +1135,9 @@ public:
         if (m_highlightGoto) {
             m_highlightGoto->setChecked(m_plugin->m_highlightGoto);
         }
+        if (m_autoHighlight) {
+            m_autoHighlight->setChecked(m_plugin->m_autoHighlight);
+        }
         if (m_diagnostics) {
             m_diagnostics->setChecked(m_plugin->m_diagnostics);
         }
@@ -961,28 +1208,14 @@ public:
         m_markModel.clear();
     }
 
-    void addMarks(KTextEditor::Document *doc, QStandardItem *item, RangeCollection *ranges, DocumentCollection *docs) const
+    static void addMarks(KTextEditor::Document *doc, const LocationModel::Location &location, RangeCollection *ranges, DocumentCollection *docs)
     {
-        Q_ASSERT(item);
-
-        // only consider enabled items
-        if (!(item->flags() & Qt::ItemIsEnabled)) {
-            return;
-        }
-
-        auto url = item->data(RangeData::FileUrlRole).toUrl();
-        // document url could end up empty while in intermediate reload state
-        // (and then it might match a parent item with no RangeData at all)
-        if (url != doc->url() || url.isEmpty()) {
-            return;
-        }
-
-        auto range = item->data(RangeData::RangeRole).value<LSPRange>();
+        const auto &range = location.range;
         if (!range.isValid() || range.isEmpty()) {
             return;
         }
         auto line = range.start().line();
-        RangeData::KindEnum kind = RangeData::KindEnum(item->data(RangeData::KindRole).toInt());
+        RangeData::KindEnum kind = location.kind;
 
         KTextEditor::Attribute::Ptr attr;
 
@@ -1059,26 +1292,9 @@ public:
             iface->addMark(line, markType);
             docs->insert(doc);
         }
-
-        connect(doc, &KTextEditor::Document::aboutToInvalidateMovingInterfaceContent, this, &self_type::clearAllMarks, Qt::UniqueConnection);
-#if KTEXTEDITOR_VERSION < QT_VERSION_CHECK(6, 9, 0)
-        connect(doc, &KTextEditor::Document::aboutToDeleteMovingInterfaceContent, this, &self_type::clearAllMarks, Qt::UniqueConnection);
-#endif
-
-        // reload might save/restore marks before/after above signals, so let's clear before that
-        connect(doc, &KTextEditor::Document::aboutToReload, this, &self_type::clearAllMarks, Qt::UniqueConnection);
-    }
-
-    void addMarksRec(KTextEditor::Document *doc, QStandardItem *item, RangeCollection *ranges, DocumentCollection *docs)
-    {
-        Q_ASSERT(item);
-        addMarks(doc, item, ranges, docs);
-        for (int i = 0; i < item->rowCount(); ++i) {
-            addMarksRec(doc, item->child(i), ranges, docs);
-        }
     }
 
-    void addMarks(KTextEditor::Document *doc, QStandardItemModel *treeModel, RangeCollection &ranges, DocumentCollection &docs)
+    void addMarks(KTextEditor::Document *doc, const LocationModel *model, RangeCollection &ranges, DocumentCollection &docs)
     {
         // check if already added
         auto oranges = ranges.contains(doc) ? nullptr : &ranges;
@@ -1088,8 +1304,23 @@ public:
             return;
         }
 
-        Q_ASSERT(treeModel);
-        addMarksRec(doc, treeModel->invisibleRootItem(), oranges, odocs);
+        Q_ASSERT(model);
+        // document url could end up empty while in intermediate reload state
+        const auto locations = doc->url().isEmpty() ? std::span<const LocationModel::Location>() : model->locations(doc->url());
+        if (locations.empty()) {
+            return;
+        }
+        for (const auto &location : locations) {
+            addMarks(doc, location, oranges, odocs);
+        }
+
+        connect(doc, &KTextEditor::Document::aboutToInvalidateMovingInterfaceContent, this, &self_type::clearAllMarks, Qt::UniqueConnection);
+#if KTEXTEDITOR_VERSION < QT_VERSION_CHECK(6, 9, 0)
+        connect(doc, &KTextEditor::Document::aboutToDeleteMovingInterfaceContent, this, &self_type::clearAllMarks, Qt::UniqueConnection);
+#endif
+
+        // reload might save/restore marks before/after above signals, so let's clear before that
+        connect(doc, &KTextEditor::Document::aboutToReload, this, &self_type::clearAllMarks, Qt::UniqueConnection);
     }
 
     void goToDocumentLocation(const QUrl &uri, const KTextEditor::Range &location)
@@ -1255,66 +1486,6 @@ public:
         return (a.uri < b.uri) || ((a.uri == b.uri) && a.range < b.range);
     }
 
-    // provide Qt::DisplayRole (text) line lazily;
-    // only find line's text content when so requested
-    // This may then involve opening reading some file, at which time
-    // all items for that file will be resolved in one go.
-    struct LineItem : public QStandardItem {
-        KTextEditor::MainWindow *m_mainWindow;
-
-        LineItem(KTextEditor::MainWindow *mainWindow)
-            : m_mainWindow(mainWindow)
-        {
-        }
-
-        QVariant data(int role = Qt::UserRole + 1) const override
-        {
-            auto rootItem = this->parent();
-            if (role != Qt::DisplayRole || !rootItem) {
-                return QStandardItem::data(role);
-            }
-
-            auto line = data(Qt::UserRole);
-            // either of these mean we tried to obtain line already
-            if (line.isValid() || rootItem->data(RangeData::KindRole).toBool()) {
-                return QStandardItem::data(role).toString().append(line.toString());
-            }
-
-            KTextEditor::Document *doc = nullptr;
-            std::unique_ptr<FileLineReader> fr;
-            for (int i = 0; i < rootItem->rowCount(); i++) {
-                auto child = rootItem->child(i);
-                if (i == 0) {
-                    auto url = child->data(RangeData::FileUrlRole).toUrl();
-                    doc = findDocument(m_mainWindow, url);
-                    if (!doc) {
-                        fr.reset(new FileLineReader(url));
-                    }
-                }
-                auto lineno = child->data(RangeData::RangeRole).value<LSPRange>().start().line();
-                auto line = doc ? doc->line(lineno) : fr->line(lineno);
-                child->setData(line, Qt::UserRole);
-            }
-
-            // mark as processed
-            rootItem->setData(RangeData::KindRole, true);
-
-            // should work ok
-            return data(role);
-        }
-    };
-
-    static void
-    fillItemRoles(QStandardItem *item, const QUrl &url, const LSPRange _range, RangeData::KindEnum kind, const LSPClientRevisionSnapshot *snapshot = nullptr)
-    {
-        auto range = snapshot ? transformRange(url, *snapshot, _range) : _range;
-        item->setData(QVariant(url), RangeData::FileUrlRole);
-        QVariant vrange;
-        vrange.setValue(range);
-        item->setData(vrange, RangeData::RangeRole);
-        item->setData(static_cast<int>(kind), RangeData::KindRole);
-    }
-
     QString getProjectBaseDir()
     {
         QObject *project = m_mainWindow->pluginView(QStringLiteral("kateprojectplugin"));
@@ -1342,36 +1513,28 @@ public:
     void makeTree(const QList<RangeItem> &locations, const LSPClientRevisionSnapshot *snapshot)
     {
         // group by url, assuming input is suitably sorted that way
-        auto treeModel = new QStandardItemModel();
-        treeModel->setColumnCount(1);
+        std::vector<LocationModel::File> files;
+        std::vector<LocationModel::Location> items;
+        items.reserve(locations.size());
 
         QString baseDir = getProjectBaseDir();
-        QUrl lastUrl;
-        QStandardItem *parent = nullptr;
         for (const auto &loc : locations) {
-            // ensure we create a parent, if not already there (bug 427270) or we have a different url
-            if (!parent || loc.uri != lastUrl) {
-                if (parent) {
-                    parent->setText(QStringLiteral("%1: %2").arg(shortenPath(baseDir, lastUrl.toLocalFile())).arg(parent->rowCount()));
-                }
-                lastUrl = loc.uri;
-                parent = new QStandardItem();
-                treeModel->appendRow(parent);
+            // new file, if not already there (bug 427270) or we have a different url
+            if (files.empty() || loc.uri != files.back().url) {
+                files.push_back({.url = loc.uri, .text = {}, .first = int(items.size()), .count = 0});
             }
-            auto item = new LineItem(m_mainWindow);
-            parent->appendRow(item);
-            // add partial display data; line will be added by item later on
-            item->setText(i18n("Line: %1: ", loc.range.start().line() + 1));
-            fillItemRoles(item, loc.uri, loc.range, loc.kind, snapshot);
+            auto range = snapshot ? transformRange(loc.uri, *snapshot, loc.range) : loc.range;
+            items.push_back({.range = range, .kind = loc.kind});
+            ++files.back().count;
         }
-        if (parent) {
-            parent->setText(QStringLiteral("%1: %2").arg(shortenPath(baseDir, lastUrl.toLocalFile())).arg(parent->rowCount()));
+        for (auto &file : files) {
+            file.text = QStringLiteral("%1: %2").arg(shortenPath(baseDir, file.url.toLocalFile())).arg(file.count);
         }
 
+        const auto fileCount = files.size();
+        auto treeModel = new LocationModel(m_mainWindow, std::move(files), std::move(items));
         // plain heuristic; mark for auto-expand all when safe and/or useful to do so
-        if (treeModel->rowCount() <= 2 || locations.size() <= 20) {
-            treeModel->invisibleRootItem()->setData(true, RangeData::KindRole);
-        }
+        treeModel->setAutoExpand(fileCount <= 2 || locations.size() <= 20);
 
         m_ownedModel.reset(treeModel);
         m_markModel = treeModel;
@@ -1403,7 +1566,7 @@ public:
         int index = m_tabWidget->addTab(treeView, title);
         connect(treeView, &QTreeView::clicked, this, &self_type::goToItemLocation);
 
-        if (treeModel->invisibleRootItem()->data(RangeData::KindRole).toBool()) {
+        if (treeModel->autoExpand()) {
             treeView->expandAll();
         }
 
@@ -1522,6 +1685,8 @@ public:
                     ranges.push_back(itemConverter(def));
                 }
                 // ... so we can sort it also
+                QElapsedTimer timer;
+                timer.start();
                 std::stable_sort(ranges.begin(), ranges.end(), compareRangeItem);
                 makeTree(ranges, s.get()->get());
 
@@ -1529,6 +1694,7 @@ public:
                 // (not specified anyway in protocol/reply)
                 if (defs.count() > 1 || onlyshow) {
                     showTree(title, targetTree);
+                    qCDebug(LSPCLIENT) << "showing" << ranges.size() << "locations took" << timer.elapsed() << "ms";
                 }
                 // it's not nice to jump to some location if we are too late
                 if (!m_req_timeout && !onlyshow) {
@@ -1606,6 +1772,82 @@ public:
         processLocations<LSPLocation>(title, &LSPClientServer::documentImplementation, true, &self_type::locationToRangeItem);
     }
 
+    void callHierarchy(CallHierarchyModel::Direction direction)
+    {
+        auto server = m_serverManager->findServer(m_mainWindow->activeView());
+        if (!server) {
+            return;
+        }
+
+        const bool incoming = direction == CallHierarchyModel::Direction::Incoming;
+        auto title = incoming ? i18nc("@title:tab", "Incoming Calls: %1", currentWord()) : i18nc("@title:tab", "Outgoing Calls: %1", currentWord());
+        auto h = [this, server, direction, title](const QList<LSPCallHierarchyItem> &items) {
+            if (items.isEmpty()) {
+                showMessage(i18n("No results"), KTextEditor::Message::Information);
+                return;
+            }
+            showCallTree(title, new CallHierarchyModel(m_serverManager, server, direction, items));
+        };
+        positionRequest<CallHierarchyItemsReplyHandler>(&LSPClientServer::prepareCallHierarchy, h);
+    }
+
+    void showCallTree(const QString &title, CallHierarchyModel *model)
+    {
+        if (!m_tabWidget) {
+            initToolView();
+        }
+        if (m_callTree) {
+            int index = m_tabWidget->indexOf(m_callTree);
+            if (index >= 0) {
+                tabCloseRequested(index);
+            }
+        }
+
+        // not using configureTreeView, expanding everything would walk the whole call graph
+        auto treeView = new QTreeView();
+        treeView->setHeaderHidden(true);
+        treeView->setFocusPolicy(Qt::NoFocus);
+        treeView->setLayoutDirection(Qt::LeftToRight);
+        treeView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        treeView->setUniformRowHeights(true);
+        treeView->setModel(model);
+        model->setParent(treeView);
+        connect(treeView, &QTreeView::clicked, this, &self_type::goToItemLocation);
+
+        treeView->setContextMenuPolicy(Qt::CustomContextMenu);
+        auto menu = new QMenu(treeView);
+        menu->addAction(i18n("Stop Expanding"), model, &CallHierarchyModel::cancel);
+        menu->addAction(i18n("Collapse All"), treeView, &QTreeView::collapseAll);
+        menu->addSeparator();
+        menu->addAction(i18n("Export as Graphviz File…"), this, [this, model] {
+            exportCallGraph(model);
+        });
+        connect(treeView, &QTreeView::customContextMenuRequested, menu, [treeView, menu](const QPoint &p) {
+            menu->popup(treeView->viewport()->mapToGlobal(p));
+        });
+
+        m_callTree = treeView;
+        int index = m_tabWidget->addTab(treeView, title);
+        if (model->rowCount() == 1) {
+            treeView->expand(model->index(0, 0));
+        }
+        m_tabWidget->setCurrentIndex(index);
+        m_mainWindow->showToolView(m_toolView.get());
+    }
+
+    void exportCallGraph(CallHierarchyModel *model)
+    {
+        const auto fileName =
+            QFileDialog::getSaveFileName(m_mainWindow->window(), i18n("Export Call Graph"), QString(), i18n("Graphviz files (*.dot *.gv)"));
+        if (fileName.isEmpty()) {
+            return;
+        }
+        QSaveFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly) || file.write(model->toDot().toUtf8()) < 0 || !file.commit()) {
+            showMessage(i18n("Failed to write %1: %2", fileName, file.errorString()), KTextEditor::Message::Error);
+        }
+    }
+
     void highlight()
     {
         // determine current url to capture and use later on
@@ -1709,21 +1951,59 @@ public:
         applyEdits(document, snapshot, edits);
     }
 
-    void applyWorkspaceEdit(const LSPWorkspaceEdit &edit, const LSPClientRevisionSnapshot *snapshot)
+    // @return why it failed, empty if applied
+    QString applyWorkspaceEdit(const LSPWorkspaceEdit &edit, const LSPClientRevisionSnapshot *snapshot)
     {
-        auto currentView = m_mainWindow->activeView();
         // edits may be in changes or documentChanges
         // the latter is handled in a sneaky way, but not announced in capabilities
+        // ... as/though the document version is not (yet) taken into account
+        // each of documentChanges applies to what the ones before left, so they are kept apart
+        QHash<QUrl, QList<QList<LSPTextEdit>>> changes;
         for (auto it = edit.changes.begin(); it != edit.changes.end(); ++it) {
-            applyEdits(it.key(), snapshot, it.value());
+            changes[it.key()].push_back(it.value());
+        }
+        for (const auto &change : edit.documentChanges) {
+            changes[change.textDocument.uri].push_back(change.edits);
+        }
+
+        // files not open are edited on disk rather than loading a document for each of them,
+        // which is done first as that may fail and then nothing is changed
+        QElapsedTimer timer;
+        timer.start();
+        auto app = KTextEditor::Editor::instance()->application();
+        QHash<QUrl, QList<QList<LSPTextEdit>>> fileChanges;
+        for (auto it = changes.begin(); it != changes.end();) {
+            if (it.key().isLocalFile() && !app->findUrl(it.key())) {
+                fileChanges.insert(it.key(), it.value());
+                it = changes.erase(it);
+            } else {
+                ++it;
+            }
         }
-        // ... as/though the document version is not (yet) taken into account
-        for (auto &change : edit.documentChanges) {
-            applyEdits(change.textDocument.uri, snapshot, change.edits);
+        if (!fileChanges.empty()) {
+            const auto error = applyFileEdits(fileChanges);
+            // even a failed edit may have written some of the files
+            m_serverManager->workspaceChanged();
+            qCDebug(LSPCLIENT) << "editing" << fileChanges.size() << "files took" << timer.elapsed() << "ms";
+            if (!error.isEmpty()) {
+                showMessage(i18n("Edit not applied: %1", error), KTextEditor::Message::Error);
+                return error;
+            }
+        }
+
+        auto currentView = m_mainWindow->activeView();
+        for (auto it = changes.begin(); it != changes.end(); ++it) {
+            // only the first list is relative to the snapshot, the others to the edited document
+            const auto *docSnapshot = snapshot;
+            for (const auto &edits : it.value()) {
+                applyEdits(it.key(), docSnapshot, edits);
+                docSnapshot = nullptr;
+            }
         }
         if (currentView) {
             m_mainWindow->activateView(currentView->document());
         }
+        return {};
     }
 
     void onApplyEdit(const LSPApplyWorkspaceEditParams &edit, const ApplyEditReplyHandler &h, bool &handled)
@@ -1733,13 +2013,14 @@ public:
         }
         handled = true;
 
+        QString error;
         if (m_accept_edit) {
             qCInfo(LSPCLIENT) << "applying edit" << edit.label;
-            applyWorkspaceEdit(edit.edit, nullptr);
+            error = applyWorkspaceEdit(edit.edit, nullptr);
         } else {
             qCInfo(LSPCLIENT) << "ignoring edit";
         }
-        h({.applied = m_accept_edit, .failureReason = QString()});
+        h({.applied = m_accept_edit && error.isEmpty(), .failureReason = error});
     }
 
     template<typename Collection>
@@ -1990,10 +2271,12 @@ public:
     {
         KTextEditor::View *activeView = m_mainWindow->activeView();
         auto server = m_serverManager->findServer(activeView);
-        if (!server) {
+        // the index can do without a server
+        auto index = m_serverManager->symbolIndex(activeView ? activeView->document() : nullptr);
+        if (!server && !index) {
             return;
         }
-        auto d = new GotoSymbolHUDDialog(m_mainWindow, server);
+        auto d = new GotoSymbolHUDDialog(m_mainWindow, server, index);
         d->raise();
         d->show();
     }
@@ -2242,6 +2525,7 @@ public:
         auto doc = activeView ? activeView->document() : nullptr;
         auto server = m_serverManager->findServer(activeView);
         bool defEnabled = false, declEnabled = false, typeDefEnabled = false, refEnabled = false, implEnabled = false;
+        bool callHierarchyEnabled = false;
         bool hoverEnabled = false, highlightEnabled = false, codeActionEnabled = false;
         bool formatEnabled = false;
         bool renameEnabled = false;
@@ -2257,6 +2541,7 @@ public:
             typeDefEnabled = caps.typeDefinitionProvider;
             refEnabled = caps.referencesProvider;
             implEnabled = caps.implementationProvider;
+            callHierarchyEnabled = caps.callHierarchyProvider;
             hoverEnabled = caps.hoverProvider;
             highlightEnabled = caps.documentHighlightProvider;
             formatEnabled = caps.documentFormattingProvider || caps.documentRangeFormattingProvider;
@@ -2317,6 +2602,12 @@ public:
         if (m_findImpl) {
             m_findImpl->setEnabled(implEnabled);
         }
+        if (m_incomingCalls) {
+            m_incomingCalls->setEnabled(callHierarchyEnabled);
+        }
+        if (m_outgoingCalls) {
+            m_outgoingCalls->setEnabled(callHierarchyEnabled);
+        }
         if (m_triggerHighlight) {
             m_triggerHighlight->setEnabled(highlightEnabled);
         }
@@ -2372,6 +2663,9 @@ public:
 
         // update hover with relevant server
         m_hover->setServer(server && server->capabilities().hoverProvider ? server : nullptr);
+        // no need to look ahead if hovering is only on request
+        m_hover->setView(m_autoHover && m_autoHover->isChecked() ? activeView : nullptr);
+        m_occurrenceHighlighter.setActiveView(highlightEnabled && m_autoHighlight && m_autoHighlight->isChecked() ? activeView : nullptr);
 
         updateMarks(doc);
 
@@ -2388,14 +2682,20 @@ public:
 
     void updateMarks(KTextEditor::Document *doc = nullptr)
     {
-        if (!doc) {
-            KTextEditor::View *activeView = m_mainWindow->activeView();
-            doc = activeView ? activeView->document() : nullptr;
-        }
-
         // update marks if applicable
-        if (m_markModel && doc) {
+        if (!m_markModel) {
+            return;
+        }
+        if (doc) {
             addMarks(doc, m_markModel, m_ranges, m_marks);
+            return;
+        }
+        // only what can be seen, others follow once activated
+        const auto views = m_mainWindow->views();
+        for (auto view : views) {
+            if (view->isVisible() && view->document()) {
+                addMarks(view->document(), m_markModel, m_ranges, m_marks);
+            }
         }
     }
 
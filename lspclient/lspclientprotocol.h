@@ -22,6 +22,7 @@
 
 #include <memory>
 #include <optional>
+#include <span>
 
 // Following types roughly follow the types/interfaces as defined in LSP protocol spec
 // although some deviation may arise where it has been deemed useful
@@ -42,7 +43,8 @@ enum class LSPErrorCode {
 
     // Defined by the protocol.
     RequestCancelled = -32800,
-    ContentModified = -32801
+    ContentModified = -32801,
+    ServerCancelled = -32802
 };
 
 struct LSPResponseError {
@@ -96,6 +98,14 @@ struct LSPWorkspaceFoldersServerCapabilities {
     bool changeNotifications = false;
 };
 
+// Ref: https://microsoft.github.io/language-server-protocol/specification#diagnostic_pull
+struct LSPDiagnosticOptions {
+    bool provider = false;
+    QString identifier;
+    bool interFileDependencies = false;
+    bool workspaceDiagnostics = false;
+};
+
 struct LSPServerCapabilities {
     LSPTextDocumentSyncOptions textDocumentSync;
     bool hoverProvider = false;
@@ -121,6 +131,8 @@ struct LSPServerCapabilities {
     LSPWorkspaceFoldersServerCapabilities workspaceFolders;
     bool selectionRangeProvider = false;
     bool inlayHintProvider = false;
+    bool callHierarchyProvider = false;
+    LSPDiagnosticOptions diagnosticProvider;
 };
 
 enum class LSPMarkupKind {
@@ -211,23 +223,52 @@ enum class LSPSymbolTag : uint8_t {
     Deprecated = 1,
 };
 
-struct LSPSymbolInformation {
-    LSPSymbolInformation() = default;
-    LSPSymbolInformation(const QString &_name, LSPSymbolKind _kind, LSPRange _range, const QString &_detail)
-        : name(_name)
-        , detail(_detail)
-        , kind(_kind)
-        , range(_range)
+/**
+ * Document or workspace symbols in one contiguous block.
+ * Top-level symbols come first, the children of a symbol are stored next to each other.
+ * Names, details and urls are stored once and referred to by index.
+ */
+struct LSPSymbolTable {
+    struct Symbol {
+        LSPRange range;
+        double score = 0.0;
+        // indices into strings and urls
+        int name = 0;
+        int detail = 0;
+        int url = 0;
+        // indices into symbols
+        int parent = -1;
+        int firstChild = 0;
+        int childCount = 0;
+        LSPSymbolKind kind = LSPSymbolKind::File;
+        LSPSymbolTag tags = {};
+    };
+
+    std::vector<Symbol> symbols;
+    int rootCount = 0;
+    QStringList strings;
+    QList<QUrl> urls;
+
+    std::span<const Symbol> roots() const
     {
+        return {symbols.data(), size_t(rootCount)};
+    }
+    std::span<const Symbol> children(const Symbol &symbol) const
+    {
+        return {symbols.data() + symbol.firstChild, size_t(symbol.childCount)};
+    }
+    const QString &name(const Symbol &symbol) const
+    {
+        return strings.at(symbol.name);
+    }
+    const QString &detail(const Symbol &symbol) const
+    {
+        return strings.at(symbol.detail);
+    }
+    const QUrl &url(const Symbol &symbol) const
+    {
+        return urls.at(symbol.url);
     }
-    QString name;
-    QString detail;
-    LSPSymbolKind kind;
-    QUrl url;
-    LSPRange range;
-    double score = 0.0;
-    LSPSymbolTag tags;
-    std::list<LSPSymbolInformation> children;
 };
 
 struct LSPTextEdit {
@@ -275,6 +316,8 @@ struct LSPCompletionItem {
     QString detail;
     LSPMarkupContent documentation;
     QString sortText;
+    // what typed text is matched against, the label if not given
+    QString filterText;
     QString insertText;
     QList<LSPTextEdit> additionalTextEdits;
     // textEdit is unused because doesn't work well
@@ -284,6 +327,12 @@ struct LSPCompletionItem {
     QByteArray data;
 };
 
+struct LSPCompletionList {
+    // further typing should lead to a new request
+    bool isIncomplete = false;
+    QList<LSPCompletionItem> items;
+};
+
 struct LSPParameterInformation {
     // offsets into overall signature label
     // (-1 if invalid)
@@ -318,6 +367,28 @@ using LSPDiagnostic = Diagnostic;
 
 using LSPPublishDiagnosticsParams = FileDiagnostics;
 
+// full or unchanged document diagnostic report,
+// unchanged ones carry no diagnostics, the previous ones still apply
+struct LSPDiagnosticReport {
+    QUrl uri;
+    bool unchanged = false;
+    QString resultId;
+    QList<LSPDiagnostic> diagnostics;
+};
+
+struct LSPDocumentDiagnosticReport : LSPDiagnosticReport {
+    // reports for other documents, e.g. headers
+    QList<LSPDiagnosticReport> relatedDocuments;
+};
+
+// final workspace report or a partial result of one
+using LSPWorkspaceDiagnosticReport = QList<LSPDiagnosticReport>;
+
+struct LSPPreviousResultId {
+    QUrl uri;
+    QString value;
+};
+
 enum class LSPMessageType {
     Error = 1,
     Warning = 2,
@@ -448,9 +519,25 @@ struct LSPInlayHint {
     // unused fields atm, not sure if we will need them
     // enum Kind { Type = 1, Parameter = 2 } kind;
     // QString tooltip;
+};
+
+struct LSPCallHierarchyItem {
+    QString name;
+    LSPSymbolKind kind = LSPSymbolKind::Function;
+    QString detail;
+    QUrl uri;
+    LSPRange range;
+    // what to reveal, e.g. the name of a function
+    LSPRange selectionRange;
+    // opaque server data, needs to be passed back as is
+    QByteArray data;
+};
 
-    // kate specific
-    int width = 0; ///> Used to cache width
+// incoming: item calls the asked about one from fromRanges (in item)
+// outgoing: item is called by the asked about one from fromRanges (in that one)
+struct LSPCallHierarchyCall {
+    LSPCallHierarchyItem item;
+    QList<LSPRange> fromRanges;
 };
 
 struct LSPMessageRequestAction {
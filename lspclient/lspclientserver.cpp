@@ -11,6 +11,7 @@
 #include "lspclientprotocol.h"
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -160,6 +161,28 @@ static QJsonValue to_json(const LSPLocation &location)
     return QJsonValue();
 }
 
+static QJsonObject to_json(const LSPCallHierarchyItem &item)
+{
+    QJsonObject result{
+        {QStringLiteral("name"), item.name},
+        {QLatin1String(MEMBER_KIND), (int)item.kind},
+        {QLatin1String(MEMBER_URI), encodeUrl(item.uri)},
+        {QLatin1String(MEMBER_RANGE), to_json(item.range)},
+        {QStringLiteral("selectionRange"), to_json(item.selectionRange)},
+    };
+    if (!item.detail.isEmpty()) {
+        result[QLatin1String(MEMBER_DETAIL)] = item.detail;
+    }
+    if (!item.data.isEmpty()) {
+        // data need not be an object or array, so parse it wrapped
+        const auto array = QJsonDocument::fromJson(QByteArray("[" + item.data + "]")).array();
+        if (!array.isEmpty()) {
+            result[QStringLiteral("data")] = array.first();
+        }
+    }
+    return result;
+}
+
 static QJsonValue to_json(const LSPDiagnosticRelatedInformation &related)
 {
     auto loc = to_json(related.location);
@@ -441,16 +464,29 @@ static void from_json(LSPSemanticTokensOptions &options, const rapidjson::Value
                 types.push_back(QString::fromUtf8(tokenType.GetString()));
             }
         }
-        options.legend.initialize(types);
+
+        // keep position even for garbage, the index is the bit in the token's modifier bitset
+        const auto &tokenModifiers = GetJsonArrayForKey(it->value, "tokenModifiers");
+        const auto tokenModifiersArray = tokenModifiers.GetArray();
+        std::vector<QString> modifiers;
+        modifiers.reserve(tokenModifiersArray.Size());
+        for (const auto &tokenModifier : tokenModifiersArray) {
+            modifiers.push_back(tokenModifier.IsString() ? QString::fromUtf8(tokenModifier.GetString()) : QString());
+        }
+        options.legend.initialize(types, modifiers);
     }
-    // options.types = QList<QString>(types.begin(), types.end());
-    // Disabled
-    //     const auto tokenMods = legend.value(QStringLiteral("tokenModifiers")).toArray();
-    //     std::vector<QString> modifiers;
-    //     modifiers.reserve(tokenMods.size());
-    //     std::transform(tokenMods.cbegin(), tokenMods.cend(), std::back_inserter(modifiers), [](const QJsonValue &jv) {
-    //         return jv.toString();
-    //     });
+}
+
+static void from_json(LSPDiagnosticOptions &options, const rapidjson::Value &json)
+{
+    if (!json.IsObject()) {
+        return;
+    }
+
+    options.provider = true;
+    options.identifier = GetStringValue(json, "identifier");
+    options.interFileDependencies = GetBoolValue(json, "interFileDependencies");
+    options.workspaceDiagnostics = GetBoolValue(json, "workspaceDiagnostics");
 }
 
 static void from_json(LSPServerCapabilities &caps, const rapidjson::Value &json)
@@ -494,6 +530,8 @@ static void from_json(LSPServerCapabilities &caps, const rapidjson::Value &json)
     from_json(caps.workspaceFolders, GetJsonObjectForKey(workspace, "workspaceFolders"));
     caps.selectionRangeProvider = json.HasMember("selectionRangeProvider");
     caps.inlayHintProvider = json.HasMember("inlayHintProvider");
+    caps.callHierarchyProvider = json.HasMember("callHierarchyProvider");
+    from_json(caps.diagnosticProvider, GetJsonValueForKey(json, "diagnosticProvider"));
 }
 
 static void from_json(LSPVersionedTextDocumentIdentifier &id, const rapidjson::Value &json)
@@ -683,7 +721,93 @@ static LSPHover parseHover(const rapidjson::Value &hover)
     return ret;
 }
 
-static std::list<LSPSymbolInformation> parseDocumentSymbols(const rapidjson::Value &result)
+/**
+ * Collects symbols into an LSPSymbolTable, a parent has to be added before its children.
+ */
+class SymbolTableBuilder
+{
+    LSPSymbolTable m_table;
+    QHash<QString, int> m_strings;
+    QHash<QUrl, int> m_urls;
+
+    template<typename T>
+    static int intern(QHash<T, int> &index, QList<T> &values, const T &value)
+    {
+        auto it = index.constFind(value);
+        if (it != index.cend()) {
+            return it.value();
+        }
+        values.push_back(value);
+        return index.insert(value, values.size() - 1).value();
+    }
+
+public:
+    SymbolTableBuilder()
+    {
+        // index 0 is the empty one, the default of a Symbol
+        intern(m_strings, m_table.strings, QString());
+        intern(m_urls, m_table.urls, QUrl());
+    }
+
+    const LSPSymbolTable::Symbol &symbol(int index) const
+    {
+        return m_table.symbols[index];
+    }
+
+    int add(int parent, const QString &name, LSPSymbolKind kind, const LSPRange &range, const QString &detail = {}, const QUrl &url = {})
+    {
+        Q_ASSERT(parent < int(m_table.symbols.size()));
+        m_table.symbols.push_back({.range = range,
+                                   .name = intern(m_strings, m_table.strings, name),
+                                   .detail = intern(m_strings, m_table.strings, detail),
+                                   .url = intern(m_urls, m_table.urls, url),
+                                   .parent = parent,
+                                   .kind = kind});
+        return m_table.symbols.size() - 1;
+    }
+
+    LSPSymbolTable::Symbol &last()
+    {
+        return m_table.symbols.back();
+    }
+
+    // group siblings together, keeping their order
+    LSPSymbolTable take()
+    {
+        auto &symbols = m_table.symbols;
+        const int count = symbols.size();
+        // start[p + 1] is where the children of p go, p = -1 for the top-level ones
+        std::vector<int> start(count + 2, 0);
+        for (const auto &s : symbols) {
+            ++start[s.parent + 2];
+        }
+        for (int i = 1; i < count + 2; ++i) {
+            start[i] += start[i - 1];
+        }
+
+        std::vector<int> position(count);
+        std::vector<int> next(start.begin(), start.end() - 1);
+        for (int i = 0; i < count; ++i) {
+            position[i] = next[symbols[i].parent + 1]++;
+        }
+
+        std::vector<LSPSymbolTable::Symbol> sorted(count);
+        for (int i = 0; i < count; ++i) {
+            auto &s = sorted[position[i]];
+            s = symbols[i];
+            s.parent = s.parent < 0 ? -1 : position[s.parent];
+            s.firstChild = start[i + 1];
+            s.childCount = start[i + 2] - start[i + 1];
+        }
+        symbols = std::move(sorted);
+        m_table.rootCount = start[1];
+        m_strings.clear();
+        m_urls.clear();
+        return std::move(m_table);
+    }
+};
+
+static LSPSymbolTable parseDocumentSymbols(const rapidjson::Value &result)
 {
     // the reply could be old SymbolInformation[] or new (hierarchical) DocumentSymbol[]
     // try to parse it adaptively in any case
@@ -694,15 +818,13 @@ static std::list<LSPSymbolInformation> parseDocumentSymbols(const rapidjson::Val
     //   then we try to find such a parent whose range contains current range
     //   (otherwise fall back to using the last instance as a parent)
 
-    std::list<LSPSymbolInformation> ret;
+    SymbolTableBuilder table;
     if (!result.IsArray()) {
-        return ret;
+        return table.take();
     }
-    // std::list provides stable references/iterators, so index by direct pointer is safe
-    QMultiMap<QString, LSPSymbolInformation *> index;
+    QMultiMap<QString, int> index;
 
-    std::function<void(const rapidjson::Value &symbol, LSPSymbolInformation *parent)> parseSymbol = [&](const rapidjson::Value &symbol,
-                                                                                                        LSPSymbolInformation *parent) {
+    std::function<void(const rapidjson::Value &symbol, int parent)> parseSymbol = [&](const rapidjson::Value &symbol, int parent) {
         const auto &location = GetJsonObjectForKey(symbol, MEMBER_LOCATION);
         LSPRange range;
         if (symbol.HasMember(MEMBER_RANGE)) {
@@ -712,7 +834,7 @@ static std::list<LSPSymbolInformation> parseDocumentSymbols(const rapidjson::Val
         }
 
         // if flat list, try to find parent by name
-        if (!parent) {
+        if (parent < 0) {
             QString container = GetStringValue(symbol, "containerName");
             auto it = index.find(container);
             // default to last inserted
@@ -721,34 +843,33 @@ static std::list<LSPSymbolInformation> parseDocumentSymbols(const rapidjson::Val
             }
             // but prefer a containing range
             while (it != index.end() && it.key() == container) {
-                if (it.value()->range.contains(range)) {
+                if (table.symbol(it.value()).range.contains(range)) {
                     parent = it.value();
                     break;
                 }
                 ++it;
             }
         }
-        auto list = parent ? &parent->children : &ret;
         if (isPositionValid(range.start()) && isPositionValid(range.end())) {
             QString name = GetStringValue(symbol, "name");
             auto kind = (LSPSymbolKind)GetIntValue(symbol, MEMBER_KIND);
             QString detail = GetStringValue(symbol, MEMBER_DETAIL);
 
-            list->push_back({name, kind, range, detail});
-            index.insert(name, &list->back());
+            const int added = table.add(parent, name, kind, range, detail);
+            index.insert(name, added);
             // proceed recursively
             const auto &children = GetJsonArrayForKey(symbol, "children");
             for (const auto &child : children.GetArray()) {
-                parseSymbol(child, &list->back());
+                parseSymbol(child, added);
             }
         }
     };
 
     const auto symInfos = result.GetArray();
     for (const auto &info : symInfos) {
-        parseSymbol(info, nullptr);
+        parseSymbol(info, -1);
     }
-    return ret;
+    return table.take();
 }
 
 static QList<LSPLocation> parseDocumentLocation(const rapidjson::Value &result)
@@ -788,6 +909,10 @@ static LSPCompletionItem parseCompletionItem(const rapidjson::Value &item)
     if (sortText.isEmpty()) {
         sortText = label;
     }
+    auto filterText = GetStringValue(item, "filterText");
+    if (filterText.isEmpty()) {
+        filterText = label;
+    }
     auto insertText = GetStringValue(item, "insertText");
     LSPTextEdit lspTextEdit;
     const auto &textEdit = GetJsonObjectForKey(item, "textEdit");
@@ -822,21 +947,23 @@ static LSPCompletionItem parseCompletionItem(const rapidjson::Value &item)
             .detail = detail,
             .documentation = doc,
             .sortText = sortText,
+            .filterText = filterText,
             .insertText = insertText,
             .additionalTextEdits = additionalTextEdits,
             .textEdit = lspTextEdit,
             .data = data};
 }
 
-static QList<LSPCompletionItem> parseDocumentCompletion(const rapidjson::Value &result)
+static LSPCompletionList parseDocumentCompletion(const rapidjson::Value &result)
 {
-    QList<LSPCompletionItem> ret;
+    LSPCompletionList ret;
     const rapidjson::Value *items = &result;
 
     // might be CompletionList
     auto &subItems = GetJsonArrayForKey(result, "items");
     if (!result.IsArray()) {
         items = &subItems;
+        ret.isIncomplete = GetBoolValue(result, "isIncomplete");
     }
 
     if (!items->IsArray()) {
@@ -845,8 +972,9 @@ static QList<LSPCompletionItem> parseDocumentCompletion(const rapidjson::Value &
     }
 
     const auto array = items->GetArray();
+    ret.items.reserve(array.Size());
     for (const auto &item : array) {
-        ret.push_back(parseCompletionItem(item));
+        ret.items.push_back(parseCompletionItem(item));
     }
     return ret;
 }
@@ -1059,6 +1187,11 @@ static QJsonArray supportedSemanticTokenTypes()
                        QStringLiteral("regexp"),    QStringLiteral("operator")});
 }
 
+static QJsonArray supportedSemanticTokenModifiers()
+{
+    return QJsonArray({QStringLiteral("readonly"), QStringLiteral("static"), QStringLiteral("deprecated"), QStringLiteral("defaultLibrary")});
+}
+
 /**
  * Used for both delta and full
  */
@@ -1149,6 +1282,61 @@ static std::vector<LSPInlayHint> parseInlayHints(const rapidjson::Value &result)
     return ret;
 }
 
+static LSPCallHierarchyItem parseCallHierarchyItem(const rapidjson::Value &item)
+{
+    LSPCallHierarchyItem ret;
+    ret.name = GetStringValue(item, "name");
+    ret.kind = (LSPSymbolKind)GetIntValue(item, MEMBER_KIND, (int)LSPSymbolKind::Function);
+    ret.detail = GetStringValue(item, MEMBER_DETAIL);
+    ret.uri = Utils::normalizeUrl(QUrl(GetStringValue(item, MEMBER_URI)));
+    ret.range = parseRange(GetJsonObjectForKey(item, MEMBER_RANGE));
+    ret.selectionRange = parseRange(GetJsonObjectForKey(item, "selectionRange"));
+    if (auto it = item.FindMember("data"); it != item.MemberEnd()) {
+        ret.data = rapidJsonStringify(it->value);
+    }
+    return ret;
+}
+
+static QList<LSPCallHierarchyItem> parseCallHierarchyItems(const rapidjson::Value &result)
+{
+    QList<LSPCallHierarchyItem> ret;
+    if (!result.IsArray()) {
+        return ret;
+    }
+    for (const auto &item : result.GetArray()) {
+        ret.push_back(parseCallHierarchyItem(item));
+    }
+    return ret;
+}
+
+// the other end of each call is found in @p itemKey ("from" or "to")
+static QList<LSPCallHierarchyCall> parseCallHierarchyCalls(const rapidjson::Value &result, std::string_view itemKey)
+{
+    QList<LSPCallHierarchyCall> ret;
+    if (!result.IsArray()) {
+        return ret;
+    }
+    for (const auto &call : result.GetArray()) {
+        LSPCallHierarchyCall c;
+        c.item = parseCallHierarchyItem(GetJsonObjectForKey(call, itemKey));
+        for (const auto &range : GetJsonArrayForKey(call, "fromRanges").GetArray()) {
+            c.fromRanges.push_back(parseRange(range));
+        }
+        ret.push_back(std::move(c));
+    }
+    return ret;
+}
+
+static QList<LSPCallHierarchyCall> parseCallHierarchyIncomingCalls(const rapidjson::Value &result)
+{
+    return parseCallHierarchyCalls(result, "from");
+}
+
+static QList<LSPCallHierarchyCall> parseCallHierarchyOutgoingCalls(const rapidjson::Value &result)
+{
+    return parseCallHierarchyCalls(result, "to");
+}
+
 static LSPPublishDiagnosticsParams parseDiagnostics(const rapidjson::Value &result)
 {
     LSPPublishDiagnosticsParams ret;
@@ -1166,6 +1354,54 @@ static LSPPublishDiagnosticsParams parseDiagnostics(const rapidjson::Value &resu
     return ret;
 }
 
+// full or unchanged report, the uri is only part of workspace reports
+static LSPDiagnosticReport parseDiagnosticReport(const rapidjson::Value &result)
+{
+    LSPDiagnosticReport ret;
+    if (!result.IsObject()) {
+        return ret;
+    }
+
+    auto uri = GetStringValue(result, MEMBER_URI);
+    if (!uri.isEmpty()) {
+        ret.uri = QUrl(uri);
+    }
+    ret.unchanged = GetStringValue(result, MEMBER_KIND) == QLatin1String("unchanged");
+    ret.resultId = GetStringValue(result, "resultId");
+    if (!ret.unchanged) {
+        ret.diagnostics = parseDiagnosticsArray(GetJsonArrayForKey(result, "items"));
+    }
+    return ret;
+}
+
+static LSPDocumentDiagnosticReport parseDocumentDiagnosticReport(const rapidjson::Value &result)
+{
+    LSPDocumentDiagnosticReport ret;
+    static_cast<LSPDiagnosticReport &>(ret) = parseDiagnosticReport(result);
+
+    const auto &related = GetJsonObjectForKey(result, "relatedDocuments");
+    for (const auto &doc : related.GetObject()) {
+        auto report = parseDiagnosticReport(doc.value);
+        report.uri = QUrl(QString::fromUtf8(doc.name.GetString(), doc.name.GetStringLength()));
+        ret.relatedDocuments.push_back(report);
+    }
+    return ret;
+}
+
+// final result as well as partial ones
+static LSPWorkspaceDiagnosticReport parseWorkspaceDiagnosticReport(const rapidjson::Value &result)
+{
+    LSPWorkspaceDiagnosticReport ret;
+    const auto &items = GetJsonArrayForKey(result, "items");
+    for (const auto &item : items.GetArray()) {
+        auto report = parseDiagnosticReport(item);
+        if (report.uri.isValid()) {
+            ret.push_back(report);
+        }
+    }
+    return ret;
+}
+
 static LSPApplyWorkspaceEditParams parseApplyWorkspaceEditParams(const rapidjson::Value &result)
 {
     LSPApplyWorkspaceEditParams ret;
@@ -1230,21 +1466,17 @@ static LSPWorkDoneProgressParams parseWorkDone(const rapidjson::Value &json)
     return parseProgress<LSPWorkDoneProgressValue>(json);
 }
 
-static std::vector<LSPSymbolInformation> parseWorkspaceSymbols(const rapidjson::Value &result)
+static LSPSymbolTable parseWorkspaceSymbols(const rapidjson::Value &result)
 {
-    std::vector<LSPSymbolInformation> symbols;
+    SymbolTableBuilder table;
     if (!result.IsArray()) {
-        return symbols;
+        return table.take();
     }
 
-    auto res = result.GetArray();
-
-    symbols.reserve(res.Size());
-
-    std::transform(res.begin(), res.end(), std::back_inserter(symbols), [](const rapidjson::Value &jv) {
-        LSPSymbolInformation symInfo;
+    for (const auto &jv : result.GetArray()) {
         if (!jv.IsObject()) {
-            return symInfo;
+            table.add(-1, QString(), LSPSymbolKind::File, LSPRange());
+            continue;
         }
         auto symbol = jv.GetObject();
 
@@ -1257,19 +1489,17 @@ static std::vector<LSPSymbolInformation> parseWorkspaceSymbols(const rapidjson::
         if (!containerName.isEmpty()) {
             containerName.append(QStringLiteral("::"));
         }
-        symInfo.name = containerName + GetStringValue(symbol, "name");
-        symInfo.kind = (LSPSymbolKind)GetIntValue(symbol, MEMBER_KIND);
-        symInfo.range = location.range;
-        symInfo.url = location.uri;
+        table.add(-1, containerName + GetStringValue(symbol, "name"), (LSPSymbolKind)GetIntValue(symbol, MEMBER_KIND), location.range, {}, location.uri);
         auto scoreIt = symbol.FindMember("score");
         if (scoreIt != symbol.MemberEnd()) {
-            symInfo.score = scoreIt->value.GetDouble();
+            table.last().score = scoreIt->value.GetDouble();
         }
-        symInfo.tags = (LSPSymbolTag)GetIntValue(symbol, "tags");
-        return symInfo;
-    });
+        table.last().tags = (LSPSymbolTag)GetIntValue(symbol, "tags");
+    }
 
-    std::sort(symbols.begin(), symbols.end(), [](const LSPSymbolInformation &l, const LSPSymbolInformation &r) {
+    // all top-level, no children to keep track of
+    auto symbols = table.take();
+    std::sort(symbols.symbols.begin(), symbols.symbols.end(), [](const LSPSymbolTable::Symbol &l, const LSPSymbolTable::Symbol &r) {
         return l.score > r.score;
     });
 
@@ -1278,6 +1508,7 @@ static std::vector<LSPSymbolInformation> parseWorkspaceSymbols(const rapidjson::
 
 using GenericReplyType = rapidjson::Value;
 using GenericReplyHandler = ReplyHandler<GenericReplyType>;
+using BatchReplyHandler = std::function<void(int, const GenericReplyType &)>;
 
 class LSPClientServer::LSPClientServerPrivate
 {
@@ -1307,6 +1538,15 @@ class LSPClientServer::LSPClientServerPrivate
     // registered reply handlers
     // (result handler, error result handler)
     QHash<int, std::pair<GenericReplyHandler, GenericReplyHandler>> m_handlers;
+    // partial result handlers by token, along with the id of their request
+    QHash<QString, std::pair<int, GenericReplyHandler>> m_partialResultHandlers;
+    // requests sent together, by the id handed out for all of them
+    struct Batch {
+        std::vector<int> ids;
+        int pending = 0;
+    };
+    QHash<int, Batch> m_batches;
+    int m_partialResultToken = 0;
     // pending request responses
     static constexpr int MAX_REQUESTS = 5;
     QVariantList m_requests{MAX_REQUESTS + 1};
@@ -1366,7 +1606,19 @@ public:
 
     int cancel(int reqid)
     {
-        if (m_handlers.remove(reqid)) {
+        if (auto it = m_batches.find(reqid); it != m_batches.end()) {
+            const auto ids = std::move(it->ids);
+            m_batches.erase(it);
+            for (int id : ids) {
+                cancel(id);
+            }
+        } else if (m_handlers.remove(reqid)) {
+            for (auto it = m_partialResultHandlers.begin(); it != m_partialResultHandlers.end(); ++it) {
+                if (it->first == reqid) {
+                    m_partialResultHandlers.erase(it);
+                    break;
+                }
+            }
             auto params = QJsonObject{{QLatin1String(MEMBER_ID), reqid}};
             write(init_request(QStringLiteral("$/cancelRequest"), params));
         }
@@ -1588,6 +1840,7 @@ private:
             qCInfo(LSPCLIENT) << "shutting down" << m_server;
             // cancel all pending
             m_handlers.clear();
+            m_batches.clear();
             // shutdown sequence
             send(init_request(QStringLiteral("shutdown")));
             // maybe we will get/see reply on the above, maybe not
@@ -1640,7 +1893,7 @@ private:
                                        }
                                   },
                                   {QStringLiteral("tokenTypes"), supportedSemanticTokenTypes()},
-                                  {QStringLiteral("tokenModifiers"), QJsonArray()},
+                                  {QStringLiteral("tokenModifiers"), supportedSemanticTokenModifiers()},
                                   {QStringLiteral("formats"), QJsonArray({QStringLiteral("relative")})},
         };
         QJsonObject capabilities{{QStringLiteral("textDocument"),
@@ -1670,6 +1923,13 @@ private:
                                             }},
                                             {QStringLiteral("inlayHint"), QJsonObject{
                                                 {QStringLiteral("dynamicRegistration"), false}
+                                            }},
+                                            {QStringLiteral("callHierarchy"), QJsonObject{
+                                                {QStringLiteral("dynamicRegistration"), false}
+                                            }},
+                                            {QStringLiteral("diagnostic"), QJsonObject{
+                                                {QStringLiteral("dynamicRegistration"), false},
+                                                {QStringLiteral("relatedDocumentSupport"), true}
                                             }}
                                         },
                                   },
@@ -1684,11 +1944,13 @@ private:
                                         }
                                   }
                                 };
+        QJsonObject workspace{{QStringLiteral("diagnostics"), QJsonObject{{QStringLiteral("refreshSupport"), true}}}};
         // only declare workspace support if folders so specified
         const auto &folders = m_config.folders;
         if (folders) {
-            capabilities[QStringLiteral("workspace")] = QJsonObject{{QStringLiteral("workspaceFolders"), true}};
+            workspace[QStringLiteral("workspaceFolders")] = true;
         }
+        capabilities[QStringLiteral("workspace")] = workspace;
         // NOTE a typical server does not use root all that much,
         // other than for some corner case (in) requests
         QJsonObject params{{QStringLiteral("processId"), QCoreApplication::applicationPid()},
@@ -1836,6 +2098,37 @@ public:
         return send(init_request(QStringLiteral("textDocument/selectionRange"), params), h);
     }
 
+    // one request of @p method per position, written out back to back so they reach the server
+    // as one burst; @p h gets the index of the position along with each reply
+    // the returned handle cancels all of them
+    RequestHandle positionsRequest(const QString &method, const QUrl &document, const QList<LSPPosition> &positions, const BatchReplyHandler &h)
+    {
+        RequestHandle ret;
+        ret.m_server = q;
+        if (m_state != State::Running || positions.isEmpty()) {
+            return ret;
+        }
+
+        // the batch id is never sent, it only stands for the requests below
+        const int batchId = ++m_id;
+        Batch batch;
+        batch.pending = int(positions.size());
+        for (int i = 0; i < positions.size(); ++i) {
+            auto rh = [this, batchId, i, h](const GenericReplyType &reply) {
+                auto it = m_batches.find(batchId);
+                if (it != m_batches.end() && --it->pending == 0) {
+                    m_batches.erase(it);
+                }
+                h(i, reply);
+            };
+            auto params = textDocumentPositionParams(document, positions[i]);
+            batch.ids.push_back(send(init_request(method, params), rh).m_id);
+        }
+        m_batches.insert(batchId, std::move(batch));
+        ret.m_id = batchId;
+        return ret;
+    }
+
     RequestHandle clangdSwitchSourceHeader(const QUrl &document, const GenericReplyHandler &h)
     {
         auto params = QJsonObject{{QLatin1String(MEMBER_URI), encodeUrl(document)}};
@@ -1905,11 +2198,73 @@ public:
         return send(init_request(QStringLiteral("textDocument/semanticTokens/full"), params), h);
     }
 
-    RequestHandle documentInlayHint(const QUrl &document, const LSPRange &range, const GenericReplyHandler &h)
+    RequestHandle documentInlayHint(const QUrl &document, const LSPRange &range, const GenericReplyHandler &h, const GenericReplyHandler &eh)
     {
         auto params = textDocumentParams(document);
         params[QLatin1String(MEMBER_RANGE)] = to_json(range);
-        return send(init_request(QStringLiteral("textDocument/inlayHint"), params), h);
+        return send(init_request(QStringLiteral("textDocument/inlayHint"), params), h, eh);
+    }
+
+    RequestHandle prepareCallHierarchy(const QUrl &document, const LSPPosition &pos, const GenericReplyHandler &h)
+    {
+        auto params = textDocumentPositionParams(document, pos);
+        return send(init_request(QStringLiteral("textDocument/prepareCallHierarchy"), params), h);
+    }
+
+    RequestHandle callHierarchyCalls(const QString &method, const LSPCallHierarchyItem &item, const GenericReplyHandler &h, const GenericReplyHandler &eh)
+    {
+        QJsonObject params{{QStringLiteral("item"), to_json(item)}};
+        return send(init_request(method, params), h, eh);
+    }
+
+    RequestHandle documentDiagnostic(const QUrl &document, const QString &previousResultId, const GenericReplyHandler &h, const GenericReplyHandler &eh)
+    {
+        auto params = textDocumentParams(document);
+        const auto &identifier = m_capabilities.diagnosticProvider.identifier;
+        if (!identifier.isEmpty()) {
+            params[QStringLiteral("identifier")] = identifier;
+        }
+        if (!previousResultId.isEmpty()) {
+            params[QLatin1String(MEMBER_PREVIOUS_RESULT_ID)] = previousResultId;
+        }
+        return send(init_request(QStringLiteral("textDocument/diagnostic"), params), h, eh);
+    }
+
+    RequestHandle workspaceDiagnostic(const QList<LSPPreviousResultId> &previousResultIds,
+                                      const GenericReplyHandler &partial,
+                                      const GenericReplyHandler &h,
+                                      const GenericReplyHandler &eh)
+    {
+        if (!h) {
+            return RequestHandle();
+        }
+
+        QJsonArray ids;
+        for (const auto &id : previousResultIds) {
+            ids.push_back(QJsonObject{{QLatin1String(MEMBER_URI), encodeUrl(id.uri)}, {QStringLiteral("value"), id.value}});
+        }
+        const auto token = QStringLiteral("partial-%1").arg(++m_partialResultToken);
+        QJsonObject params{{QStringLiteral("previousResultIds"), ids}, {QStringLiteral("partialResultToken"), token}};
+        const auto &identifier = m_capabilities.diagnosticProvider.identifier;
+        if (!identifier.isEmpty()) {
+            params[QStringLiteral("identifier")] = identifier;
+        }
+
+        // partial results stop with the reply
+        auto done = [this, token](const GenericReplyHandler &handler) -> GenericReplyHandler {
+            if (!handler) {
+                return nullptr;
+            }
+            return [this, token, handler](const GenericReplyType &m) {
+                m_partialResultHandlers.remove(token);
+                handler(m);
+            };
+        };
+        auto ret = send(init_request(QStringLiteral("workspace/diagnostic"), params), done(h), done(eh));
+        if (partial && ret.m_id >= 0) {
+            m_partialResultHandlers[token] = {ret.m_id, partial};
+        }
+        return ret;
     }
 
     void executeCommand(const LSPCommand &command)
@@ -1991,7 +2346,14 @@ public:
         } else if (isObj && method == "window/logMessage") {
             Q_EMIT q->logMessage(parseMessage(obj));
         } else if (isObj && method == "$/progress") {
-            Q_EMIT q->workDoneProgress(parseWorkDone(obj));
+            auto it = m_partialResultHandlers.find(GetStringValue(obj, "token"));
+            if (it != m_partialResultHandlers.end()) {
+                // copy, the handler might well issue new requests
+                const auto handler = it->second;
+                handler(GetJsonValueForKey(obj, "value"));
+            } else {
+                Q_EMIT q->workDoneProgress(parseWorkDone(obj));
+            }
         } else {
             qCWarning(LSPCLIENT) << "discarding notification" << method.data() << ", params is object:" << isObj;
         }
@@ -2066,6 +2428,10 @@ public:
             // e.g. typst-lsp, see https://invent.kde.org/utilities/kate/-/issues/108
             auto h = prepareResponse(msgId);
             h(QJsonValue());
+        } else if (method == QLatin1String("workspace/diagnostic/refresh")) {
+            auto h = prepareResponse(msgId);
+            h(QJsonValue());
+            Q_EMIT q->diagnosticsRefresh();
         } else if (method == QLatin1String("window/showMessageRequest")) {
             auto actions = GetJsonArrayForKey(params, MEMBER_ACTIONS).GetArray();
             QList<LSPMessageRequestAction> v;
@@ -2109,6 +2475,65 @@ make_handler(const ReplyHandler<ReplyType> &h, const QObject *context, typename
     };
 }
 
+// replies to a positions request, gathered and handed out in the order of the positions
+template<typename ReplyType>
+static LSPClientServer::RequestHandle batchRequest(LSPClientServer::LSPClientServerPrivate *d,
+                                                   const QString &method,
+                                                   const QUrl &document,
+                                                   const QList<LSPPosition> &positions,
+                                                   const QObject *context,
+                                                   const ReplyHandler<QList<ReplyType>> &h,
+                                                   ReplyType (*c)(const GenericReplyType &))
+{
+    struct State {
+        QList<ReplyType> replies;
+        // for each position, the index of its reply
+        QList<int> replyIndex;
+        int pending = 0;
+        QElapsedTimer timer;
+        // sum of the round trips, roughly what asking one after another would take
+        qint64 latencySum = 0;
+    };
+    auto state = std::make_shared<State>();
+
+    // the same position is only asked about once
+    QList<LSPPosition> unique;
+    QHash<qint64, int> seen;
+    for (const auto &pos : positions) {
+        const qint64 key = (qint64(pos.line()) << 32) | quint32(pos.column());
+        auto it = seen.find(key);
+        if (it == seen.end()) {
+            it = seen.insert(key, int(unique.size()));
+            unique.push_back(pos);
+        }
+        state->replyIndex.push_back(*it);
+    }
+    state->replies.resize(unique.size());
+    state->pending = int(unique.size());
+    state->timer.start();
+
+    QPointer<const QObject> ctx(context);
+    auto rh = [state, ctx, h, c, method](int index, const GenericReplyType &reply) {
+        state->replies[index] = c(reply);
+        state->latencySum += state->timer.elapsed();
+        if (--state->pending > 0) {
+            return;
+        }
+        qCDebug(LSPCLIENT) << method << "batch of" << state->replyIndex.size() << "positions sent" << state->replies.size() << "requests, took"
+                           << state->timer.elapsed() << "ms instead of" << state->latencySum << "ms one after another";
+        if (!ctx) {
+            return;
+        }
+        QList<ReplyType> results;
+        results.reserve(state->replyIndex.size());
+        for (int i : std::as_const(state->replyIndex)) {
+            results.push_back(state->replies[i]);
+        }
+        h(results);
+    };
+    return d->positionsRequest(method, document, unique, rh);
+}
+
 LSPClientServer::LSPClientServer(const QStringList &server, const QUrl &root, const QString &langId, const QJsonValue &init, ExtraServerConfig config)
     : d(new LSPClientServerPrivate(this, server, root, langId, init, std::move(config)))
 {
@@ -2231,6 +2656,12 @@ LSPClientServer::selectionRange(const QUrl &document, const QList<LSPPosition> &
     return d->selectionRange(document, positions, make_handler(h, context, parseSelectionRanges));
 }
 
+LSPClientServer::RequestHandle
+LSPClientServer::documentHoverBatch(const QUrl &document, const QList<LSPPosition> &positions, const QObject *context, const DocumentHoverBatchReplyHandler &h)
+{
+    return batchRequest(d, QStringLiteral("textDocument/hover"), document, positions, context, h, parseHover);
+}
+
 LSPClientServer::RequestHandle LSPClientServer::clangdSwitchSourceHeader(const QUrl &document, const QObject *context, const SwitchSourceHeaderHandler &h)
 {
     return d->clangdSwitchSourceHeader(document, make_handler(h, context, parseClangdSwitchSourceHeader));
@@ -2320,9 +2751,67 @@ LSPClientServer::documentSemanticTokensRange(const QUrl &document, const LSPRang
 }
 
 LSPClientServer::RequestHandle
-LSPClientServer::documentInlayHint(const QUrl &document, const LSPRange &range, const QObject *context, const InlayHintsReplyHandler &h)
+LSPClientServer::documentInlayHint(const QUrl &document,
+                                   const LSPRange &range,
+                                   const QObject *context,
+                                   const InlayHintsReplyHandler &h,
+                                   const ErrorReplyHandler &eh)
+{
+    return d->documentInlayHint(document, range, make_handler(h, context, parseInlayHints), make_handler(eh, context, parseResponseError));
+}
+
+LSPClientServer::RequestHandle
+LSPClientServer::prepareCallHierarchy(const QUrl &document, const LSPPosition &pos, const QObject *context, const CallHierarchyItemsReplyHandler &h)
+{
+    return d->prepareCallHierarchy(document, pos, make_handler(h, context, parseCallHierarchyItems));
+}
+
+LSPClientServer::RequestHandle
+LSPClientServer::callHierarchyIncomingCalls(const LSPCallHierarchyItem &item,
+                                            const QObject *context,
+                                            const CallHierarchyCallsReplyHandler &h,
+                                            const ErrorReplyHandler &eh)
+{
+    return d->callHierarchyCalls(QStringLiteral("callHierarchy/incomingCalls"),
+                                 item,
+                                 make_handler(h, context, parseCallHierarchyIncomingCalls),
+                                 make_handler(eh, context, parseResponseError));
+}
+
+LSPClientServer::RequestHandle
+LSPClientServer::callHierarchyOutgoingCalls(const LSPCallHierarchyItem &item,
+                                            const QObject *context,
+                                            const CallHierarchyCallsReplyHandler &h,
+                                            const ErrorReplyHandler &eh)
+{
+    return d->callHierarchyCalls(QStringLiteral("callHierarchy/outgoingCalls"),
+                                 item,
+                                 make_handler(h, context, parseCallHierarchyOutgoingCalls),
+                                 make_handler(eh, context, parseResponseError));
+}
+
+LSPClientServer::RequestHandle LSPClientServer::documentDiagnostic(const QUrl &document,
+                                                                   const QString &previousResultId,
+                                                                   const QObject *context,
+                                                                   const DocumentDiagnosticReplyHandler &h,
+                                                                   const ErrorReplyHandler &eh)
+{
+    return d->documentDiagnostic(document,
+                                 previousResultId,
+                                 make_handler(h, context, parseDocumentDiagnosticReport),
+                                 make_handler(eh, context, parseResponseError));
+}
+
+LSPClientServer::RequestHandle LSPClientServer::workspaceDiagnostic(const QList<LSPPreviousResultId> &previousResultIds,
+                                                                    const QObject *context,
+                                                                    const WorkspaceDiagnosticReplyHandler &partial,
+                                                                    const WorkspaceDiagnosticReplyHandler &h,
+                                                                    const ErrorReplyHandler &eh)
 {
-    return d->documentInlayHint(document, range, make_handler(h, context, parseInlayHints));
+    return d->workspaceDiagnostic(previousResultIds,
+                                  make_handler(partial, context, parseWorkspaceDiagnosticReport),
+                                  make_handler(h, context, parseWorkspaceDiagnosticReport),
+                                  make_handler(eh, context, parseResponseError));
 }
 
 void LSPClientServer::executeCommand(const LSPCommand &command)
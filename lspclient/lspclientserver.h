@@ -52,11 +52,11 @@ template<typename T>
 using ReplyHandler = std::function<void(const T &)>;
 
 using ErrorReplyHandler = ReplyHandler<LSPResponseError>;
-using DocumentSymbolsReplyHandler = ReplyHandler<std::list<LSPSymbolInformation>>;
+using DocumentSymbolsReplyHandler = ReplyHandler<LSPSymbolTable>;
 using DocumentDefinitionReplyHandler = ReplyHandler<QList<LSPLocation>>;
 using DocumentHighlightReplyHandler = ReplyHandler<QList<LSPDocumentHighlight>>;
 using DocumentHoverReplyHandler = ReplyHandler<LSPHover>;
-using DocumentCompletionReplyHandler = ReplyHandler<QList<LSPCompletionItem>>;
+using DocumentCompletionReplyHandler = ReplyHandler<LSPCompletionList>;
 using DocumentCompletionResolveReplyHandler = ReplyHandler<LSPCompletionItem>;
 using SignatureHelpReplyHandler = ReplyHandler<LSPSignatureHelp>;
 using FormattingReplyHandler = ReplyHandler<QList<LSPTextEdit>>;
@@ -68,9 +68,14 @@ using SwitchSourceHeaderHandler = ReplyHandler<QString>;
 using MemoryUsageHandler = ReplyHandler<QString>;
 using ExpandMacroHandler = ReplyHandler<LSPExpandedMacro>;
 using SemanticTokensDeltaReplyHandler = ReplyHandler<LSPSemanticTokensDelta>;
-using WorkspaceSymbolsReplyHandler = ReplyHandler<std::vector<LSPSymbolInformation>>;
+using WorkspaceSymbolsReplyHandler = ReplyHandler<LSPSymbolTable>;
 using SelectionRangeReplyHandler = ReplyHandler<QList<std::shared_ptr<LSPSelectionRange>>>;
+using DocumentHoverBatchReplyHandler = ReplyHandler<QList<LSPHover>>;
 using InlayHintsReplyHandler = ReplyHandler<std::vector<LSPInlayHint>>;
+using CallHierarchyItemsReplyHandler = ReplyHandler<QList<LSPCallHierarchyItem>>;
+using CallHierarchyCallsReplyHandler = ReplyHandler<QList<LSPCallHierarchyCall>>;
+using DocumentDiagnosticReplyHandler = ReplyHandler<LSPDocumentDiagnosticReport>;
+using WorkspaceDiagnosticReplyHandler = ReplyHandler<LSPWorkspaceDiagnosticReport>;
 
 class LSPClientPlugin;
 
@@ -161,6 +166,8 @@ public:
     RequestHandle documentCompletionResolve(const LSPCompletionItem &c, const QObject *context, const DocumentCompletionResolveReplyHandler &h);
     RequestHandle signatureHelp(const QUrl &document, const LSPPosition &pos, const QObject *context, const SignatureHelpReplyHandler &h);
     RequestHandle selectionRange(const QUrl &document, const QList<LSPPosition> &positions, const QObject *context, const SelectionRangeReplyHandler &h);
+    // one request per position, sent together in one go; replies in the order of the positions
+    RequestHandle documentHoverBatch(const QUrl &document, const QList<LSPPosition> &positions, const QObject *context, const DocumentHoverBatchReplyHandler &h);
     // clangd specific
     RequestHandle clangdSwitchSourceHeader(const QUrl &document, const QObject *context, const SwitchSourceHeaderHandler &h);
     RequestHandle clangdMemoryUsage(const QObject *context, const MemoryUsageHandler &h);
@@ -194,7 +201,34 @@ public:
 
     RequestHandle documentSemanticTokensRange(const QUrl &document, const LSPRange &range, const QObject *context, const SemanticTokensDeltaReplyHandler &h);
 
-    RequestHandle documentInlayHint(const QUrl &document, const LSPRange &range, const QObject *context, const InlayHintsReplyHandler &h);
+    RequestHandle documentInlayHint(const QUrl &document,
+                                    const LSPRange &range,
+                                    const QObject *context,
+                                    const InlayHintsReplyHandler &h,
+                                    const ErrorReplyHandler &eh = nullptr);
+
+    RequestHandle prepareCallHierarchy(const QUrl &document, const LSPPosition &pos, const QObject *context, const CallHierarchyItemsReplyHandler &h);
+    RequestHandle callHierarchyIncomingCalls(const LSPCallHierarchyItem &item,
+                                             const QObject *context,
+                                             const CallHierarchyCallsReplyHandler &h,
+                                             const ErrorReplyHandler &eh = nullptr);
+    RequestHandle callHierarchyOutgoingCalls(const LSPCallHierarchyItem &item,
+                                             const QObject *context,
+                                             const CallHierarchyCallsReplyHandler &h,
+                                             const ErrorReplyHandler &eh = nullptr);
+
+    // pull diagnostics, unchanged reports are cheap if the previous result id is passed along
+    RequestHandle documentDiagnostic(const QUrl &document,
+                                     const QString &previousResultId,
+                                     const QObject *context,
+                                     const DocumentDiagnosticReplyHandler &h,
+                                     const ErrorReplyHandler &eh = nullptr);
+    // partial results are passed to @p partial as they arrive, the rest to @p h
+    RequestHandle workspaceDiagnostic(const QList<LSPPreviousResultId> &previousResultIds,
+                                      const QObject *context,
+                                      const WorkspaceDiagnosticReplyHandler &partial,
+                                      const WorkspaceDiagnosticReplyHandler &h,
+                                      const ErrorReplyHandler &eh = nullptr);
 
     void executeCommand(const LSPCommand &command);
 
@@ -219,6 +253,8 @@ Q_SIGNALS:
     void logMessage(const LSPLogMessageParams &);
     void publishDiagnostics(const LSPPublishDiagnosticsParams &);
     void workDoneProgress(const LSPWorkDoneProgressParams &);
+    // pulled diagnostics are outdated
+    void diagnosticsRefresh();
 
     // request = signal
     void applyEdit(const LSPApplyWorkspaceEditParams &req, const ApplyEditReplyHandler &h, bool &handled);
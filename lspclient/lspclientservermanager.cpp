@@ -13,6 +13,7 @@
 #include "hostprocess.h"
 #include "ktexteditor_utils.h"
 #include "lspclient_debug.h"
+#include "workspacesymbolindex.h"
 
 #include <KLocalizedString>
 #include <KTextEditor/Application>
@@ -253,6 +254,15 @@ class LSPClientServerManagerImpl : public LSPClientServerManager
         bool modified : 1;
         // used for incremental update (if non-empty)
         QList<LSPTextDocumentContentChangeEvent> changes;
+        // pending pull diagnostics request
+        LSPClientServer::RequestHandle diagnosticsRequest = {};
+    };
+
+    // pull diagnostics state of a server
+    struct DiagnosticsPull {
+        // result id of the last report by document
+        QHash<QUrl, QString> resultIds;
+        LSPClientServer::RequestHandle workspaceRequest;
     };
 
     LSPClientPlugin *m_plugin;
@@ -262,6 +272,7 @@ class LSPClientServerManagerImpl : public LSPClientServerManager
     // root -> (mode -> server)
     QMap<QUrl, QMap<QString, ServerInfo>> m_servers;
     QHash<KTextEditor::Document *, DocumentInfo> m_docs;
+    quint64 m_workspaceRevision = 0;
     bool m_incrementalSync = false;
     LSPClientCapabilities m_clientCapabilities;
 
@@ -279,6 +290,15 @@ class LSPClientServerManagerImpl : public LSPClientServerManager
     // variable to avoid warning more than once
     QSet<QString> m_failedToFindServers;
 
+    // pull diagnostics, batched up while typing
+    QTimer m_diagnosticsTimer;
+    QSet<KTextEditor::Document *> m_diagnosticsPending;
+    QSet<LSPClientServer *> m_workspaceDiagnosticsPending;
+    QHash<LSPClientServer *, DiagnosticsPull> m_diagnosticsPull;
+
+    // local workspace symbols by root path
+    QHash<QString, std::shared_ptr<WorkspaceSymbolIndex>> m_symbolIndexes;
+
 public:
     LSPClientServerManagerImpl(LSPClientPlugin *plugin)
         : m_plugin(plugin)
@@ -286,6 +306,10 @@ public:
         connect(plugin, &LSPClientPlugin::update, this, &self_type::updateServerConfig);
         QTimer::singleShot(100, this, &self_type::updateServerConfig);
 
+        m_diagnosticsTimer.setSingleShot(true);
+        m_diagnosticsTimer.setInterval(500);
+        connect(&m_diagnosticsTimer, &QTimer::timeout, this, &self_type::pullDiagnostics);
+
         // stay tuned on project situation
         auto app = KTextEditor::Editor::instance()->application();
         auto h = [this](const QString &name, KTextEditor::Plugin *plugin) {
@@ -491,20 +515,65 @@ public:
         return it != m_docs.end() ? it->version : -1;
     }
 
+    quint64 workspaceRevision() const override
+    {
+        return m_workspaceRevision;
+    }
+
+    void workspaceChanged() override
+    {
+        ++m_workspaceRevision;
+    }
+
+    void sync(LSPClientServer *server) override
+    {
+        for (auto it = m_docs.begin(); it != m_docs.end(); ++it) {
+            if (it->server.get() == server) {
+                update(it.key(), false);
+            }
+        }
+    }
+
     LSPClientRevisionSnapshot *snapshot(LSPClientServer *server) override
     {
+        // sync server to latest revision that will be recorded
+        sync(server);
         auto result = new LSPClientRevisionSnapshotImpl;
         for (auto it = m_docs.begin(); it != m_docs.end(); ++it) {
             if (it->server.get() == server) {
-                // sync server to latest revision that will be recorded
-                update(it.key(), false);
                 result->add(it.key());
             }
         }
         return result;
     }
 
+    std::shared_ptr<WorkspaceSymbolIndex> symbolIndex(KTextEditor::Document *doc) override
+    {
+        const auto path = doc ? doc->url().toLocalFile() : QString();
+        if (path.isEmpty()) {
+            return nullptr;
+        }
+        // innermost root
+        std::shared_ptr<WorkspaceSymbolIndex> ret;
+        for (const auto &index : std::as_const(m_symbolIndexes)) {
+            const auto &root = index->root();
+            if (path.startsWith(root + QLatin1Char('/')) && (!ret || root.size() > ret->root().size())) {
+                ret = index;
+            }
+        }
+        return ret;
+    }
+
 private:
+    // source files of languages we know how to index without a server
+    static QStringList indexedFilePatterns(const QString &langId)
+    {
+        if (langId == QLatin1String("julia")) {
+            return {QStringLiteral("*.jl")};
+        }
+        return {};
+    }
+
     void showMessage(const QString &msg, KTextEditor::Message::MessageType level)
     {
         // inform interested view(er) which will decide how/where to show
@@ -521,6 +590,8 @@ private:
             }
             // controlling server here, so disable usual state tracking response
             disconnect(server.get(), nullptr, this, nullptr);
+            m_diagnosticsPull.remove(server.get());
+            m_workspaceDiagnosticsPending.remove(server.get());
             for (auto it = m_docs.begin(); it != m_docs.end();) {
                 auto &item = it.value();
                 if (item.server == server) {
@@ -599,6 +670,8 @@ private:
                     server->didChangeWorkspaceFolders(folders, {});
                 }
             }
+            // documents opened before are not pulled yet
+            scheduleDiagnostics(server);
             // clear for normal operation
             Q_EMIT serverChanged();
         } else if (server->state() == LSPClientServer::State::None) {
@@ -742,6 +815,15 @@ private:
         // in either case, let configuration explicitly specify this
         bool useWorkspace = serverConfig.value(QStringLiteral("useWorkspace")).toBool(!rootpath ? true : false);
 
+        // index the project, but not some directory we ended up in by default
+        if (rootpath && !rootpath->isEmpty() && *rootpath != QDir::homePath() && !m_symbolIndexes.contains(*rootpath)) {
+            if (const auto patterns = indexedFilePatterns(langId); !patterns.isEmpty()) {
+                auto index = std::make_shared<WorkspaceSymbolIndex>(*rootpath, patterns);
+                connect(index.get(), &WorkspaceSymbolIndex::filesChanged, this, &LSPClientServerManagerImpl::workspaceChanged);
+                m_symbolIndexes.insert(*rootpath, std::move(index));
+            }
+        }
+
         // last fallback: home directory
         if (!rootpath) {
             rootpath = QDir::homePath();
@@ -886,6 +968,7 @@ private:
                 connect(server.get(), &LSPClientServer::workDoneProgress, this, &self_type::onWorkDoneProgress);
                 connect(server.get(), &LSPClientServer::workspaceFolders, this, &self_type::onWorkspaceFolders, Qt::UniqueConnection);
                 connect(server.get(), &LSPClientServer::showMessageRequest, this, &self_type::showMessageRequest);
+                connect(server.get(), &LSPClientServer::diagnosticsRefresh, this, &self_type::onDiagnosticsRefresh);
             }
         }
         // set out param value
@@ -967,6 +1050,7 @@ private:
                                 .open = false,
                                 .modified = false,
                                 .changes = {}});
+            scheduleDiagnostics(doc);
             connect(doc, &KTextEditor::Document::highlightingModeChanged, this, &self_type::untrack, Qt::UniqueConnection);
             connect(doc, &KTextEditor::Document::aboutToClose, this, &self_type::untrack, Qt::UniqueConnection);
             connect(doc, &KTextEditor::Document::destroyed, this, &self_type::untrack, Qt::UniqueConnection);
@@ -989,9 +1073,12 @@ private:
                 // release server side (use url as registered with)
                 (it->server)->didClose(it->url);
                 it->open = false;
+                ++m_workspaceRevision;
             }
             if (remove) {
                 disconnect(it.key(), nullptr, this, nullptr);
+                it->diagnosticsRequest.cancel();
+                m_diagnosticsPending.remove(it.key());
                 it = m_docs.erase(it);
             }
         }
@@ -1029,10 +1116,15 @@ private:
             if (it->open) {
                 if (it->modified || force) {
                     (it->server)->didChange(it->url, it->version, (it->changes.empty()) ? doc->text() : QString(), it->changes);
+                    ++m_workspaceRevision;
                 }
             } else {
                 (it->server)->didOpen(it->url, it->version, documentLanguageId(doc), doc->text());
                 it->open = true;
+                // unmodified content is what the server could already see on disk
+                if (doc->isModified()) {
+                    ++m_workspaceRevision;
+                }
             }
             it->modified = false;
             it->changes.clear();
@@ -1058,6 +1150,7 @@ private:
         auto it = m_docs.find(doc);
         if (it != m_docs.end()) {
             it->modified = true;
+            scheduleDiagnostics(doc);
         }
     }
 
@@ -1117,6 +1210,7 @@ private:
 
     void onDocumentSaved(KTextEditor::Document *doc, bool saveAs)
     {
+        ++m_workspaceRevision;
         if (!saveAs) {
             auto it = m_docs.find(doc);
             if (it != m_docs.end() && it->server) {
@@ -1125,7 +1219,179 @@ private:
                 if (saveOptions) {
                     server->didSave(doc->url(), saveOptions->includeText ? doc->text() : QString());
                 }
+                // the server knows the symbols of the saved file better than our parser
+                if (auto index = symbolIndex(doc); index && server->capabilities().documentSymbolProvider) {
+                    std::weak_ptr<WorkspaceSymbolIndex> windex = index;
+                    auto h = [windex, path = doc->url().toLocalFile()](const LSPSymbolTable &symbols) {
+                        if (auto index = windex.lock()) {
+                            index->setSymbols(path, symbols);
+                        }
+                    };
+                    server->documentSymbols(doc->url(), this, h);
+                }
+                // other documents may depend on this one
+                if (server->capabilities().diagnosticProvider.interFileDependencies) {
+                    scheduleDiagnostics(server.get());
+                } else if (server->capabilities().diagnosticProvider.workspaceDiagnostics) {
+                    m_workspaceDiagnosticsPending.insert(server.get());
+                    m_diagnosticsTimer.start();
+                }
+            }
+        }
+    }
+
+    static bool pullsDiagnostics(LSPClientServer *server)
+    {
+        return server && server->state() == LSPClientServer::State::Running && server->capabilities().diagnosticProvider.provider;
+    }
+
+    void scheduleDiagnostics(KTextEditor::Document *doc)
+    {
+        auto it = m_docs.find(doc);
+        if (it != m_docs.end() && pullsDiagnostics(it->server.get())) {
+            m_diagnosticsPending.insert(doc);
+            m_diagnosticsTimer.start();
+        }
+    }
+
+    // all documents of the server and the workspace
+    void scheduleDiagnostics(LSPClientServer *server)
+    {
+        if (!pullsDiagnostics(server)) {
+            return;
+        }
+        for (auto it = m_docs.begin(); it != m_docs.end(); ++it) {
+            if (it->server.get() == server) {
+                m_diagnosticsPending.insert(it.key());
+            }
+        }
+        if (server->capabilities().diagnosticProvider.workspaceDiagnostics) {
+            m_workspaceDiagnosticsPending.insert(server);
+        }
+        m_diagnosticsTimer.start();
+    }
+
+    void onDiagnosticsRefresh()
+    {
+        scheduleDiagnostics(qobject_cast<LSPClientServer *>(sender()));
+    }
+
+    void pullDiagnostics()
+    {
+        // the server handles requests in order, so visible documents come first
+        std::vector<KTextEditor::Document *> docs;
+        docs.reserve(m_diagnosticsPending.size());
+        const auto mainWindows = KTextEditor::Editor::instance()->application()->mainWindows();
+        for (auto mainWindow : mainWindows) {
+            const auto views = mainWindow->views();
+            for (auto view : views) {
+                if (view->isVisible() && m_diagnosticsPending.remove(view->document())) {
+                    docs.push_back(view->document());
+                }
+            }
+        }
+        docs.insert(docs.end(), m_diagnosticsPending.cbegin(), m_diagnosticsPending.cend());
+        m_diagnosticsPending.clear();
+
+        for (auto doc : docs) {
+            pullDocumentDiagnostics(doc);
+        }
+
+        const auto servers = std::exchange(m_workspaceDiagnosticsPending, {});
+        for (auto server : servers) {
+            pullWorkspaceDiagnostics(server);
+        }
+    }
+
+    // server cancelled the request, but asks for it to be sent again
+    static bool retrigger(const LSPResponseError &error)
+    {
+        if (error.code != LSPErrorCode::ServerCancelled) {
+            return false;
+        }
+        const auto data = QJsonDocument::fromJson(error.data).object();
+        return data.value(QStringLiteral("retriggerRequest")).toBool(true);
+    }
+
+    void pullDocumentDiagnostics(KTextEditor::Document *doc)
+    {
+        auto it = m_docs.find(doc);
+        if (it == m_docs.end() || !pullsDiagnostics(it->server.get())) {
+            return;
+        }
+
+        // server needs to have the current text
+        update(it, false);
+
+        // superseded by this one
+        it->diagnosticsRequest.cancel();
+
+        auto server = it->server.get();
+        const auto url = it->url;
+        auto h = [this, server, url](const LSPDocumentDiagnosticReport &report) {
+            applyDiagnosticReport(server, url, report);
+            for (const auto &related : report.relatedDocuments) {
+                applyDiagnosticReport(server, related.uri, related);
+            }
+        };
+        auto eh = [this, doc = QPointer<KTextEditor::Document>(doc)](const LSPResponseError &error) {
+            if (doc && retrigger(error)) {
+                scheduleDiagnostics(doc);
+            }
+        };
+        it->diagnosticsRequest = server->documentDiagnostic(url, m_diagnosticsPull[server].resultIds.value(url), this, h, eh);
+    }
+
+    void pullWorkspaceDiagnostics(LSPClientServer *server)
+    {
+        if (!pullsDiagnostics(server) || !server->capabilities().diagnosticProvider.workspaceDiagnostics) {
+            return;
+        }
+
+        auto &pull = m_diagnosticsPull[server];
+        pull.workspaceRequest.cancel();
+
+        QList<LSPPreviousResultId> previousResultIds;
+        previousResultIds.reserve(pull.resultIds.size());
+        for (auto it = pull.resultIds.cbegin(); it != pull.resultIds.cend(); ++it) {
+            previousResultIds.push_back({.uri = it.key(), .value = it.value()});
+        }
+
+        // partial results arrive while the server works through the workspace
+        auto h = [this, server](const LSPWorkspaceDiagnosticReport &reports) {
+            // open documents are pulled on their own, with their current text
+            QSet<QUrl> open;
+            for (const auto &info : std::as_const(m_docs)) {
+                if (info.server.get() == server && info.open) {
+                    open.insert(info.url);
+                }
+            }
+            for (const auto &report : reports) {
+                if (!open.contains(report.uri)) {
+                    applyDiagnosticReport(server, report.uri, report);
+                }
+            }
+        };
+        auto eh = [this, server](const LSPResponseError &error) {
+            if (retrigger(error)) {
+                m_workspaceDiagnosticsPending.insert(server);
+                m_diagnosticsTimer.start();
             }
+        };
+        pull.workspaceRequest = server->workspaceDiagnostic(previousResultIds, this, h, h, eh);
+    }
+
+    void applyDiagnosticReport(LSPClientServer *server, const QUrl &url, const LSPDiagnosticReport &report)
+    {
+        auto &resultIds = m_diagnosticsPull[server].resultIds;
+        if (!report.resultId.isEmpty()) {
+            resultIds[url] = report.resultId;
+        } else {
+            resultIds.remove(url);
+        }
+        // nothing changed, nothing to do
+        if (!report.unchanged) {
+            Q_EMIT serverDiagnostics(server, {.uri = url, .diagnostics = report.diagnostics});
         }
     }
 
@@ -23,6 +23,7 @@ class MovingInterface;
 
 
 class LSPClientRevisionSnapshot;
+class WorkspaceSymbolIndex;
 
 /*
  * A helper class that manages LSP servers in relation to a KTextDocument.
@@ -56,10 +57,23 @@ public:
     // latest sync'ed revision of doc (-1 if N/A)
     virtual qint64 revision(KTextEditor::Document *doc) = 0;
 
+    // changes whenever any document content is sent to or released from a server,
+    // results spanning several files stay valid as long as this does
+    virtual quint64 workspaceRevision() const = 0;
+
+    // content changed behind the back of any server, e.g. files edited on disk
+    virtual void workspaceChanged() = 0;
+
+    // send pending changes of all documents of server
+    virtual void sync(LSPClientServer *server) = 0;
+
     // lock all relevant documents' current revision and sync that to server
     // locks are released when returned snapshot is delete'd
     virtual LSPClientRevisionSnapshot *snapshot(LSPClientServer *server) = 0;
 
+    // local symbol index of the project doc belongs to, if any
+    virtual std::shared_ptr<WorkspaceSymbolIndex> symbolIndex(KTextEditor::Document *doc) = 0;
+
     // helper method providing descriptive label for a server
     static QString serverDescription(LSPClientServer *server)
     {
@@ -78,6 +92,8 @@ Q_SIGNALS:
     void serverShowMessage(LSPClientServer *server, const LSPShowMessageParams &);
     void serverLogMessage(LSPClientServer *server, const LSPShowMessageParams &);
     void serverWorkDoneProgress(LSPClientServer *server, const LSPWorkDoneProgressParams &);
+    // diagnostics pulled from a server, same as the ones it publishes
+    void serverDiagnostics(LSPClientServer *server, const LSPPublishDiagnosticsParams &);
     void showMessageRequest(const LSPShowMessageParams &message,
                             const QList<LSPMessageRequestAction> &actions,
                             const std::function<void()> chooseNothing,
@@ -6,8 +6,8 @@
 */
 
 #include "lspclientsymbolview.h"
+#include "fuzzyscorer.h"
 
-#include <KFuzzyMatcher>
 #include <KLineEdit>
 #include <KLocalizedString>
 #include <QSortFilterProxyModel>
@@ -31,6 +31,7 @@
 #include <drawing_utils.h>
 #include <memory>
 #include <utility>
+#include <vector>
 
 class MenuButtonHeaderView : public QHeaderView
 {
@@ -130,8 +131,10 @@ Q_SIGNALS:
 // TODO: Make this globally available in shared/
 enum SymbolViewRoles {
     SymbolRange = Qt::UserRole,
-    ScoreRole,
-    IsPlaceholder
+    IsPlaceholder,
+    // identify a symbol across updates of the outline
+    SymbolKind,
+    SymbolName
 };
 
 class LSPClientViewTrackerImpl : public LSPClientViewTracker
@@ -228,9 +231,26 @@ public:
     {
         beginResetModel();
         m_pattern = string;
+        updateScores(sourceModel());
         endResetModel();
     }
 
+    void setSourceModel(QAbstractItemModel *model) override
+    {
+        // filtering starts right away
+        updateScores(model);
+        QSortFilterProxyModel::setSourceModel(model);
+    }
+
+    // the source model has been updated in place
+    void sourceUpdated()
+    {
+        if (!m_pattern.isEmpty()) {
+            updateScores(sourceModel());
+            invalidate();
+        }
+    }
+
 protected:
     bool lessThan(const QModelIndex &sourceLeft, const QModelIndex &sourceRight) const override
     {
@@ -239,9 +259,7 @@ protected:
             return QSortFilterProxyModel::lessThan(sourceLeft, sourceRight);
         }
 
-        const int l = sourceLeft.data(SymbolViewRoles::ScoreRole).toInt();
-        const int r = sourceRight.data(SymbolViewRoles::ScoreRole).toInt();
-        return l < r;
+        return m_scores.value(sourceLeft) < m_scores.value(sourceRight);
     }
 
     bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override
@@ -250,15 +268,45 @@ protected:
             return true;
         }
 
-        const auto idx = sourceModel()->index(sourceRow, 0, sourceParent);
-        const QString symbol = idx.data().toString();
-        const auto res = KFuzzyMatcher::match(m_pattern, symbol);
-        sourceModel()->setData(idx, res.score, SymbolViewRoles::ScoreRole);
-        return res.matched;
+        return m_scores.contains(sourceModel()->index(sourceRow, 0, sourceParent));
     }
 
 private:
+    // score all symbols of the tree in one go rather than row by row
+    void updateScores(QAbstractItemModel *model)
+    {
+        m_scores.clear();
+        if (!model || m_pattern.isEmpty()) {
+            return;
+        }
+
+        std::vector<QModelIndex> indexes;
+        QStringList symbols;
+        std::vector<QModelIndex> parents{QModelIndex()};
+        while (!parents.empty()) {
+            const auto parent = parents.back();
+            parents.pop_back();
+            for (int row = 0, rows = model->rowCount(parent); row < rows; ++row) {
+                const auto idx = model->index(row, 0, parent);
+                indexes.push_back(idx);
+                symbols.push_back(idx.data().toString());
+                if (model->hasChildren(idx)) {
+                    parents.push_back(idx);
+                }
+            }
+        }
+
+        const auto matches = FuzzyScorer::topMatches(m_pattern, symbols);
+        m_scores.reserve(matches.size());
+        for (const auto &m : matches) {
+            m_scores.insert(indexes[m.index], m.score);
+        }
+    }
+
     QString m_pattern;
+    // matching symbols, valid as long as the source model does not change,
+    // see sourceUpdated()
+    QHash<QModelIndex, int> m_scores;
 };
 
 class SymbolViewProxyModel : public QIdentityProxyModel
@@ -454,7 +502,22 @@ public:
         }
     }
 
-    void makeNodes(const std::list<LSPSymbolInformation> &symbols, bool tree, bool show_detail, QStandardItemModel *model, QStandardItem *parent, bool &details)
+    // an outline entry, before it is turned into model items
+    struct OutlineNode {
+        const LSPSymbolTable::Symbol *symbol = nullptr;
+        QString name;
+        const QIcon *icon = nullptr;
+        QString text;
+        std::vector<OutlineNode> children;
+    };
+
+    void collectNodes(const LSPSymbolTable &table,
+                      std::span<const LSPSymbolTable::Symbol> symbols,
+                      bool tree,
+                      bool show_detail,
+                      const QIcon *parentIcon,
+                      std::vector<OutlineNode> &nodes,
+                      bool &details)
     {
         initIcons();
 
@@ -465,7 +528,7 @@ public:
             case LSPSymbolKind::Module:
             case LSPSymbolKind::Namespace:
             case LSPSymbolKind::Package:
-                if (symbol.children.empty()) {
+                if (symbol.childCount == 0) {
                     continue;
                 }
                 icon = &m_icon_pkg;
@@ -492,52 +555,156 @@ public:
             default:
                 // skip local variable
                 // property, field, etc unlikely in such case anyway
-                if (parent && parent->icon().cacheKey() == m_icon_function.cacheKey()) {
+                if (parentIcon == &m_icon_function) {
                     continue;
                 }
                 icon = &m_icon_var;
             }
 
-            auto node = new QStandardItem();
-            auto line = new QStandardItem();
-            if (parent && tree) {
-                parent->appendRow({node, line});
+            const auto &name = table.name(symbol);
+            const auto &symbolDetail = table.detail(symbol);
+            if (!symbolDetail.isEmpty()) {
+                details = true;
+            }
+            auto detail = show_detail && !symbolDetail.isEmpty() ? QStringLiteral(" [%1]").arg(symbolDetail) : QString();
+            OutlineNode node{.symbol = &symbol, .name = name, .icon = icon, .text = name + detail, .children = {}};
+            // recurse children
+            if (tree) {
+                collectNodes(table, table.children(symbol), tree, show_detail, icon, node.children, details);
+                nodes.push_back(std::move(node));
             } else {
-                model->appendRow({node, line});
+                nodes.push_back(std::move(node));
+                collectNodes(table, table.children(symbol), tree, show_detail, icon, nodes, details);
             }
+        }
+    }
 
-            if (!symbol.detail.isEmpty()) {
-                details = true;
+    static void updateRow(QStandardItem *node, QStandardItem *line, const OutlineNode &n)
+    {
+        const auto &symbol = *n.symbol;
+        // setData only notifies actual changes, icons do not compare though
+        node->setText(n.text);
+        if (node->icon().cacheKey() != n.icon->cacheKey()) {
+            node->setIcon(*n.icon);
+        }
+        node->setData(QVariant::fromValue<KTextEditor::Range>(symbol.range), SymbolViewRoles::SymbolRange);
+        node->setData(int(symbol.kind), SymbolViewRoles::SymbolKind);
+        node->setData(n.name, SymbolViewRoles::SymbolName);
+        static const QChar prefix = QChar::fromLatin1('0');
+        line->setText(QStringLiteral("%1").arg(symbol.range.start().line(), 7, 10, prefix));
+    }
+
+    static QList<QStandardItem *> makeRow(const OutlineNode &n)
+    {
+        auto node = new QStandardItem();
+        auto line = new QStandardItem();
+        updateRow(node, line, n);
+        for (const auto &child : n.children) {
+            node->appendRow(makeRow(child));
+        }
+        return {node, line};
+    }
+
+    /**
+     * Make the children of @p parent match @p nodes with as few changes as possible.
+     * Symbols are identified by kind and name (within their parent), the ones that remain
+     * are updated in place, so expansion and selection in the view are kept.
+     */
+    static void applyNodes(QStandardItem *parent, const std::vector<OutlineNode> &nodes)
+    {
+        // pair up existing rows and nodes in order, so overloads match up as well
+        using Key = std::pair<int, QString>;
+        QHash<Key, QList<int>> oldRows;
+        const int oldCount = parent->rowCount();
+        for (int row = 0; row < oldCount; ++row) {
+            const auto child = parent->child(row);
+            oldRows[{child->data(SymbolViewRoles::SymbolKind).toInt(), child->data(SymbolViewRoles::SymbolName).toString()}].push_back(row);
+        }
+
+        std::vector<QStandardItem *> matched(nodes.size(), nullptr);
+        std::vector<bool> keep(oldCount, false);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            auto it = oldRows.find({int(nodes[i].symbol->kind), nodes[i].name});
+            if (it != oldRows.end() && !it->isEmpty()) {
+                const int row = it->takeFirst();
+                matched[i] = parent->child(row);
+                keep[row] = true;
             }
-            auto detail = show_detail && !symbol.detail.isEmpty() ? QStringLiteral(" [%1]").arg(symbol.detail) : QString();
-            node->setText(symbol.name + detail);
-            node->setIcon(*icon);
-            node->setData(QVariant::fromValue<KTextEditor::Range>(symbol.range), SymbolViewRoles::SymbolRange);
-            static const QChar prefix = QChar::fromLatin1('0');
-            line->setText(QStringLiteral("%1").arg(symbol.range.start().line(), 7, 10, prefix));
-            // recurse children
-            makeNodes(symbol.children, tree, show_detail, model, node, details);
+        }
+
+        // drop vanished symbols, adjacent ones at once
+        for (int row = oldCount; row > 0;) {
+            if (keep[row - 1]) {
+                --row;
+                continue;
+            }
+            int first = row - 1;
+            while (first > 0 && !keep[first - 1]) {
+                --first;
+            }
+            parent->removeRows(first, row - first);
+            row = first;
+        }
+
+        // now the remaining rows are in the old order, add the new ones in between
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const int row = int(i);
+            auto node = matched[i];
+            if (!node) {
+                parent->insertRow(row, makeRow(nodes[i]));
+                continue;
+            }
+            if (node->row() != row) {
+                // servers hardly ever reorder symbols, just move it (and lose its expansion)
+                parent->insertRow(row, parent->takeRow(node->row()));
+            }
+            updateRow(node, parent->child(row, 1), nodes[i]);
+            applyNodes(node, nodes[i].children);
         }
     }
 
-    void onDocumentSymbols(const std::list<LSPSymbolInformation> &outline)
+    void onDocumentSymbols(const LSPSymbolTable &outline)
     {
         onDocumentSymbolsOrProblem(outline, QString(), true);
     }
 
-    void onDocumentSymbolsOrProblem(const std::list<LSPSymbolInformation> &outline, const QString &problem = QString(), bool cache = false)
+    void onDocumentSymbolsOrProblem(const LSPSymbolTable &outline, const QString &problem = QString(), bool cache = false)
     {
         if (!m_symbols) {
             return;
         }
 
+        // if we have some problem, just report that, else construct model
+        bool details = false;
+        std::vector<OutlineNode> nodes;
+        if (problem.isEmpty()) {
+            collectNodes(outline, outline.roots(), m_treeOn->isChecked(), m_detailsOn->isChecked(), nullptr, nodes, details);
+        }
+
+        // update an earlier outline of the document rather than starting over,
+        // rebuilding all items of a large module on every change is slow and flickers
+        if (problem.isEmpty() && cache) {
+            Q_ASSERT(!m_models.isEmpty());
+            if (auto model = m_models[0].model) {
+                applyNodes(model->invisibleRootItem(), nodes);
+                model->invisibleRootItem()->setData(details);
+                if (model == m_outline) {
+                    m_filterModel.sourceUpdated();
+                    modelUpdated();
+                } else {
+                    setModel(model);
+                }
+                return;
+            }
+        }
+
         // construct new model for data
         auto newModel = std::make_shared<QStandardItemModel>();
 
-        // if we have some problem, just report that, else construct model
-        bool details = false;
         if (problem.isEmpty()) {
-            makeNodes(outline, m_treeOn->isChecked(), m_detailsOn->isChecked(), newModel.get(), nullptr, details);
+            for (const auto &node : nodes) {
+                newModel->appendRow(makeRow(node));
+            }
             if (cache) {
                 // last request has been placed at head of model list
                 Q_ASSERT(!m_models.isEmpty());
@@ -584,13 +751,21 @@ public:
         // no need to show internal info
         m_symbols->setColumnHidden(1, true);
 
+        modelUpdated();
+
+        m_identityModel->setSourceModel(m_outline.get());
+    }
+
+    // sync the view with changed content of the current outline model
+    void modelUpdated()
+    {
         // handle auto-expansion
         if (m_expandOn->isChecked()) {
             m_symbols->expandAll();
         }
 
         // recover detail info from model data
-        bool details = newModel->invisibleRootItem()->data().toBool();
+        bool details = m_outline->invisibleRootItem()->data().toBool();
 
         // disable detail setting if no such info available
         // (as an indication there is nothing to show anyway)
@@ -598,8 +773,6 @@ public:
 
         // current item tracking
         updateCurrentTreeItem();
-
-        m_identityModel->setSourceModel(m_outline.get());
     }
 
     void refresh(bool clear, bool allow_cache = true, int retry = 0)
@@ -6,8 +6,20 @@
 
 #include "lspclientutils.h"
 
+#include <KLocalizedString>
 #include <KTextEditor/Document>
 
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringDecoder>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <optional>
+
 LSPRange transformRange(const QUrl &url, const LSPClientRevisionSnapshot &snapshot, const LSPRange &range)
 {
     KTextEditor::Document *doc;
@@ -21,6 +33,203 @@ LSPRange transformRange(const QUrl &url, const LSPClientRevisionSnapshot &snapsh
     return result;
 }
 
+namespace
+{
+// a stretch of a that is replaced by a stretch of b
+struct DiffHunk {
+    int aStart = 0;
+    int aCount = 0;
+    int bStart = 0;
+    int bCount = 0;
+};
+}
+
+/**
+ * Myers' diff of sequences a and b of length @p n and @p m, with @p equal comparing a[i] to b[j].
+ * @return hunks turning a into b in order, nothing if that would take more than @p maxD steps
+ */
+template<typename Equal>
+static std::optional<std::vector<DiffHunk>> diff(int n, int m, const Equal &equal, int maxD)
+{
+    // what is the same at either end is usually most of it
+    int prefix = 0;
+    while (prefix < n && prefix < m && equal(prefix, prefix)) {
+        ++prefix;
+    }
+    int suffix = 0;
+    while (suffix < n - prefix && suffix < m - prefix && equal(n - 1 - suffix, m - 1 - suffix)) {
+        ++suffix;
+    }
+    const int N = n - prefix - suffix;
+    const int M = m - prefix - suffix;
+
+    // furthest x on each diagonal k = x - y, and per step d those of the step before
+    const int limit = std::min(N + M, maxD);
+    const int offset = limit + 1;
+    std::vector<int> v(2 * offset + 1, 0);
+    std::vector<std::vector<int>> trace;
+    int D = -1;
+    for (int d = 0; d <= limit && D < 0; ++d) {
+        trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? v[offset + k + 1] : v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < N && y < M && equal(prefix + x, prefix + y)) {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if (x >= N && y >= M) {
+                D = d;
+                break;
+            }
+        }
+    }
+    if (D < 0) {
+        return std::nullopt;
+    }
+
+    // walk back, one deletion or insertion per step
+    struct Step {
+        int x;
+        int y;
+        bool insert;
+    };
+    std::vector<Step> steps;
+    int x = N, y = M;
+    for (int d = D; d > 0; --d) {
+        const auto &prev = trace[d];
+        auto at = [&prev, d](int k) {
+            return prev[k + d];
+        };
+        const int k = x - y;
+        const int prevK = (k == -d || (k != d && at(k - 1) < at(k + 1))) ? k + 1 : k - 1;
+        const int prevX = at(prevK);
+        const int prevY = prevX - prevK;
+        steps.push_back({.x = prevX, .y = prevY, .insert = prevK == k + 1});
+        x = prevX;
+        y = prevY;
+    }
+
+    std::vector<DiffHunk> hunks;
+    for (auto it = steps.rbegin(); it != steps.rend(); ++it) {
+        const int sx = prefix + it->x;
+        const int sy = prefix + it->y;
+        if (hunks.empty() || hunks.back().aStart + hunks.back().aCount != sx || hunks.back().bStart + hunks.back().bCount != sy) {
+            hunks.push_back({.aStart = sx, .aCount = 0, .bStart = sy, .bCount = 0});
+        }
+        ++(it->insert ? hunks.back().bCount : hunks.back().aCount);
+    }
+    return hunks;
+}
+
+namespace
+{
+struct TextEdit {
+    LSPRange range;
+    QString newText;
+};
+}
+
+// beyond this, a plain replacement is about as good
+static constexpr int MaxLineDiff = 1000;
+static constexpr int MaxCharDiff = 200;
+
+/**
+ * The edits that turn @p text, found at @p range, into @p newText,
+ * changing lines only where they differ and within a line only what differs.
+ */
+static std::vector<TextEdit> minimalEdits(const LSPRange &range, const QString &text, const QString &newText)
+{
+    // every line ends in a newline, the last one virtually so
+    auto lineStarts = [](const QString &s) {
+        std::vector<qsizetype> starts{0};
+        for (qsizetype i = 0; i < s.size(); ++i) {
+            if (s[i] == QLatin1Char('\n')) {
+                starts.push_back(i + 1);
+            }
+        }
+        starts.push_back(s.size() + 1);
+        return starts;
+    };
+    const auto aStarts = lineStarts(text);
+    const auto bStarts = lineStarts(newText);
+    auto line = [](const QString &s, const std::vector<qsizetype> &starts, int i) {
+        return QStringView(s).sliced(starts[i], starts[i + 1] - starts[i] - 1);
+    };
+
+    const int n = int(aStarts.size()) - 1;
+    const int m = int(bStarts.size()) - 1;
+    const auto hunks = diff(
+        n,
+        m,
+        [&](int i, int j) {
+            return line(text, aStarts, i) == line(newText, bStarts, j);
+        },
+        MaxLineDiff);
+    if (!hunks) {
+        return {{.range = range, .newText = newText}};
+    }
+
+    auto position = [&range, &aStarts](qsizetype offset) {
+        const int l = int(std::upper_bound(aStarts.begin(), aStarts.end(), offset) - aStarts.begin()) - 1;
+        const int column = int(offset - aStarts[l]);
+        return LSPPosition(range.start().line() + l, l == 0 ? range.start().column() + column : column);
+    };
+    std::vector<TextEdit> edits;
+    auto addEdit = [&](qsizetype start, qsizetype end, QString replacement) {
+        // mind the virtual newline at the very end
+        if (end > text.size()) {
+            if (!replacement.isEmpty()) {
+                replacement.chop(1);
+                --end;
+                if (start > end) {
+                    start = end;
+                    replacement.prepend(QLatin1Char('\n'));
+                }
+            } else {
+                --start;
+                --end;
+            }
+        }
+        edits.push_back({.range = {position(start), position(end)}, .newText = replacement});
+    };
+
+    for (const auto &h : *hunks) {
+        // a line changed in place is likely a small change within it
+        if (h.aCount == h.bCount) {
+            for (int l = 0; l < h.aCount; ++l) {
+                const auto a = line(text, aStarts, h.aStart + l);
+                const auto b = line(newText, bStarts, h.bStart + l);
+                const auto chars = diff(
+                    int(a.size()),
+                    int(b.size()),
+                    [&a, &b](int i, int j) {
+                        return a[i] == b[j];
+                    },
+                    MaxCharDiff);
+                const auto lineStart = aStarts[h.aStart + l];
+                if (!chars) {
+                    addEdit(lineStart, lineStart + a.size(), b.toString());
+                    continue;
+                }
+                for (const auto &c : *chars) {
+                    addEdit(lineStart + c.aStart, lineStart + c.aStart + c.aCount, b.sliced(c.bStart, c.bCount).toString());
+                }
+            }
+        } else {
+            const auto bStart = bStarts[h.bStart];
+            const auto bEnd = std::min(bStarts[h.bStart + h.bCount], newText.size() + 1);
+            auto replacement = newText.mid(bStart, bEnd - bStart);
+            if (h.bCount > 0 && bStarts[h.bStart + h.bCount] > newText.size()) {
+                replacement.append(QLatin1Char('\n'));
+            }
+            addEdit(aStarts[h.aStart], aStarts[h.aStart + h.aCount], replacement);
+        }
+    }
+    return edits;
+}
+
 void applyEdits(KTextEditor::Document *doc, const LSPClientRevisionSnapshot *snapshot, const QList<LSPTextEdit> &edits)
 {
     // NOTE:
@@ -28,11 +237,13 @@ void applyEdits(KTextEditor::Document *doc, const LSPClientRevisionSnapshot *sna
     // e.g. send one edit for the whole document rather than 'surgical edits'
     // and that even when requesting format for a limited selection
     // ... but then we are but a client and do as we are told
-    // all-in-all a low priority feature
+    // ... though only what actually differs is changed, so as not to disturb
+    // all that is tied to the text (moving ranges, highlighting, sync)
 
     // all coordinates in edits are wrt original document,
     // so create moving ranges that will adjust to preceding edits as they are applied
     QList<KTextEditor::MovingRange *> ranges;
+    QStringList texts;
     for (const auto &edit : edits) {
         KTextEditor::Range editRange = edit.range;
         // Some servers use values like INT_MAX to say they want to apply an edit to
@@ -43,8 +254,15 @@ void applyEdits(KTextEditor::Document *doc, const LSPClientRevisionSnapshot *sna
         }
 
         auto range = snapshot ? transformRange(doc->url(), *snapshot, editRange) : editRange;
-        KTextEditor::MovingRange *mr = doc->newMovingRange(range);
-        ranges.append(mr);
+        if (range.isValid() && (!range.onSingleLine() || edit.newText.contains(QLatin1Char('\n')))) {
+            for (const auto &e : minimalEdits(range, doc->text(range), edit.newText)) {
+                ranges.append(doc->newMovingRange(e.range));
+                texts.append(e.newText);
+            }
+        } else {
+            ranges.append(doc->newMovingRange(range));
+            texts.append(edit.newText);
+        }
     }
 
     // now make one transaction (a.o. for one undo) and apply in sequence
@@ -53,10 +271,160 @@ void applyEdits(KTextEditor::Document *doc, const LSPClientRevisionSnapshot *sna
         for (int i = 0; i < ranges.length(); ++i) {
             auto range = ranges.at(i)->toRange();
             if (range.isValid()) {
-                doc->replaceText(range, edits.at(i).newText);
+                doc->replaceText(range, texts.at(i));
             }
         }
     }
 
     qDeleteAll(ranges);
 }
+
+// @p edits applied to @p text, all positions relative to the original, nothing if edits overlap
+static std::optional<QString> applyTextEdits(const QString &text, const QList<LSPTextEdit> &edits)
+{
+    std::vector<qsizetype> lineStarts{0};
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        if (text[i] == QLatin1Char('\n')) {
+            lineStarts.push_back(i + 1);
+        }
+    }
+    // like a document, positions past the end snap to it
+    auto offset = [&text, &lineStarts](const LSPPosition &pos) -> qsizetype {
+        if (pos.line() < 0 || pos.line() >= qsizetype(lineStarts.size())) {
+            return pos.line() < 0 ? 0 : text.size();
+        }
+        const auto start = lineStarts[pos.line()];
+        auto end = pos.line() + 1 < qsizetype(lineStarts.size()) ? lineStarts[pos.line() + 1] - 1 : text.size();
+        if (end > start && text[end - 1] == QLatin1Char('\r')) {
+            --end;
+        }
+        return start + std::clamp<qsizetype>(pos.column(), 0, end - start);
+    };
+
+    struct Replacement {
+        qsizetype start;
+        qsizetype end;
+        const QString *text;
+    };
+    std::vector<Replacement> replacements;
+    replacements.reserve(edits.size());
+    for (const auto &edit : edits) {
+        if (edit.range.isValid()) {
+            replacements.push_back({.start = offset(edit.range.start()), .end = offset(edit.range.end()), .text = &edit.newText});
+        }
+    }
+    // inserts at the same position stay in given order
+    std::stable_sort(replacements.begin(), replacements.end(), [](const Replacement &a, const Replacement &b) {
+        return a.start < b.start;
+    });
+
+    QString result;
+    result.reserve(text.size());
+    qsizetype pos = 0;
+    for (const auto &r : replacements) {
+        if (r.start < pos || r.end < r.start) {
+            return std::nullopt;
+        }
+        result.append(QStringView(text).sliced(pos, r.start - pos));
+        result.append(*r.text);
+        pos = r.end;
+    }
+    result.append(QStringView(text).sliced(pos));
+    return result;
+}
+
+namespace
+{
+struct FileEdit {
+    QString path;
+    const QList<QList<LSPTextEdit>> *edits = nullptr;
+    // journal, to put it back if needed
+    QByteArray original;
+    QDateTime modified;
+    QByteArray content;
+    QString error;
+};
+}
+
+static bool writeFile(const QString &path, const QByteArray &content, QString &error)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size() || !file.commit()) {
+        error = i18n("Could not write %1: %2", path, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+QString applyFileEdits(const QHash<QUrl, QList<QList<LSPTextEdit>>> &edits)
+{
+    std::vector<FileEdit> files;
+    files.reserve(edits.size());
+    for (auto it = edits.begin(); it != edits.end(); ++it) {
+        if (!it.key().isLocalFile()) {
+            return i18n("Cannot edit %1, not a local file", it.key().toDisplayString());
+        }
+        files.push_back({.path = it.key().toLocalFile(), .edits = &it.value(), .original = {}, .modified = {}, .content = {}, .error = {}});
+    }
+
+    // read and edit
+    static const QByteArray bom("\xEF\xBB\xBF");
+    QtConcurrent::blockingMap(files, [](FileEdit &f) {
+        QFile file(f.path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            f.error = i18n("Could not read %1: %2", f.path, file.errorString());
+            return;
+        }
+        f.original = file.readAll();
+        f.modified = QFileInfo(file).lastModified();
+
+        auto toUtf16 = QStringDecoder(QStringDecoder::Utf8);
+        QString text = toUtf16(f.original);
+        if (toUtf16.hasError()) {
+            f.error = i18n("Cannot edit %1, not UTF-8 encoded", f.path);
+            return;
+        }
+        for (const auto &edits : *f.edits) {
+            auto result = applyTextEdits(text, edits);
+            if (!result) {
+                f.error = i18n("Cannot edit %1, overlapping edits", f.path);
+                return;
+            }
+            text = std::move(*result);
+        }
+        f.content = (f.original.startsWith(bom) ? bom : QByteArray()) + text.toUtf8();
+    });
+    for (const auto &f : files) {
+        if (!f.error.isEmpty()) {
+            return f.error;
+        }
+    }
+
+    // write, each file replaced at once
+    QtConcurrent::blockingMap(files, [](FileEdit &f) {
+        if (QFileInfo(f.path).lastModified() != f.modified) {
+            f.error = i18n("%1 was modified meanwhile", f.path);
+        } else if (f.content != f.original) {
+            writeFile(f.path, f.content, f.error);
+        }
+    });
+    QString error;
+    for (const auto &f : files) {
+        if (!f.error.isEmpty()) {
+            error = f.error;
+            break;
+        }
+    }
+    if (error.isEmpty()) {
+        return {};
+    }
+
+    // undo what was written
+    for (auto &f : files) {
+        QString ignored;
+        if (f.error.isEmpty() && f.content != f.original && !writeFile(f.path, f.original, ignored)) {
+            qWarning() << "failed to restore" << f.path;
+        }
+    }
+    return error;
+}
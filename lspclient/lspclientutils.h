@@ -11,3 +11,12 @@
 LSPRange transformRange(const QUrl &url, const LSPClientRevisionSnapshot &snapshot, const LSPRange &range);
 
 void applyEdits(KTextEditor::Document *doc, const LSPClientRevisionSnapshot *snapshot, const QList<LSPTextEdit> &edits);
+
+/**
+ * Apply @p edits to files directly on disk, all or nothing, for files not open in an editor.
+ * Files are read and edited in parallel, each written to a temporary file that replaces it.
+ * Should any file fail, those already replaced are restored to their original content.
+ * Each file gets its lists of edits in turn, every list relative to the text left by the one before.
+ * @return why it failed, empty if all went fine
+ */
+QString applyFileEdits(const QHash<QUrl, QList<QList<LSPTextEdit>>> &edits);
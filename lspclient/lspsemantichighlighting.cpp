@@ -236,7 +236,7 @@ void SemanticHighlighter::highlight(KTextEditor::View *view, const SemanticToken
         const uint32_t deltaStart = data[i + 1];
         const uint32_t len = data[i + 2];
         const uint32_t type = data[i + 3];
-        // auto mod = data[i + 4];
+        const uint32_t mod = data[i + 4];
 
         if (deltaLine == 0) {
             start += deltaStart;
@@ -247,7 +247,7 @@ void SemanticHighlighter::highlight(KTextEditor::View *view, const SemanticToken
         // QString text = doc->line(currentLine);
         // text = text.mid(start, len);
 
-        auto attribute = legend->attributeForTokenType(type);
+        const auto &attribute = legend->attributeForToken(type, mod);
         if (!attribute) {
             continue;
         }
@@ -268,7 +268,7 @@ void SemanticHighlighter::highlight(KTextEditor::View *view, const SemanticToken
             range.reset(doc->newMovingRange(r));
             range->setZDepth(-91000.0);
             range->setRange(r);
-            range->setAttribute(std::move(attribute));
+            range->setAttribute(attribute);
         }
         movingRanges.push_back(std::move(range));
     }
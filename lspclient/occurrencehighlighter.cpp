@@ -0,0 +1,165 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#include "occurrencehighlighter.h"
+
+#include "lspclientservermanager.h"
+
+#include <KSyntaxHighlighting/Theme>
+#include <KTextEditor/Attribute>
+#include <KTextEditor/Document>
+#include <KTextEditor/Editor>
+#include <KTextEditor/View>
+#include <ktexteditor_version.h>
+
+// how long the cursor rests before asking
+static constexpr int requestDelay = 300;
+static constexpr int maxCachedHighlights = 64;
+
+OccurrenceHighlighter::OccurrenceHighlighter(std::shared_ptr<LSPClientServerManager> serverManager, QObject *parent)
+    : QObject(parent)
+    , m_serverManager(std::move(serverManager))
+    , m_cache(maxCachedHighlights)
+{
+    m_requestTimer.setSingleShot(true);
+    m_requestTimer.callOnTimeout(this, &OccurrenceHighlighter::sendRequest);
+}
+
+OccurrenceHighlighter::~OccurrenceHighlighter()
+{
+    setActiveView(nullptr);
+}
+
+void OccurrenceHighlighter::setActiveView(KTextEditor::View *view)
+{
+    if (view == m_view) {
+        return;
+    }
+
+    if (m_view) {
+        disconnect(m_view, &KTextEditor::View::cursorPositionChanged, this, &OccurrenceHighlighter::cursorMoved);
+        disconnect(m_view->document(), nullptr, this, nullptr);
+    }
+    m_requestTimer.stop();
+    m_handle.cancel();
+    clear();
+    m_current = {};
+
+    m_view = view;
+    if (!view) {
+        // only the current document's can be of use later on
+        m_cache.clear();
+        return;
+    }
+
+    auto doc = view->document();
+    connect(view, &KTextEditor::View::cursorPositionChanged, this, &OccurrenceHighlighter::cursorMoved);
+    connect(doc, &KTextEditor::Document::aboutToInvalidateMovingInterfaceContent, this, &OccurrenceHighlighter::clear);
+#if KTEXTEDITOR_VERSION < QT_VERSION_CHECK(6, 9, 0)
+    connect(doc, &KTextEditor::Document::aboutToDeleteMovingInterfaceContent, this, &OccurrenceHighlighter::clear);
+#endif
+    connect(doc, &KTextEditor::Document::aboutToClose, this, [this] {
+        setActiveView(nullptr);
+    });
+    cursorMoved();
+}
+
+void OccurrenceHighlighter::cursorMoved()
+{
+    if (!m_view) {
+        return;
+    }
+
+    auto doc = m_view->document();
+    const Key key{.doc = doc, .revision = doc->revision(), .range = doc->wordRangeAt(m_view->cursorPosition())};
+    if (key == m_current) {
+        return;
+    }
+    m_current = key;
+    m_requestTimer.stop();
+    m_handle.cancel();
+
+    if (!key.range.isValid() || key.range.isEmpty()) {
+        paint({});
+    } else if (auto highlights = m_cache.object(key)) {
+        paint(*highlights);
+    } else {
+        m_requestTimer.start(requestDelay);
+    }
+}
+
+void OccurrenceHighlighter::sendRequest()
+{
+    if (!m_view) {
+        return;
+    }
+    auto server = m_serverManager->findServer(m_view, false);
+    if (!server || !server->capabilities().documentHighlightProvider) {
+        return;
+    }
+
+    auto doc = m_view->document();
+    const auto key = m_current;
+    auto h = [this, key](const QList<LSPDocumentHighlight> &highlights) {
+        if (!m_view || m_view->document() != key.doc || key.doc->revision() != key.revision) {
+            return;
+        }
+        // other occurrences will show the same
+        m_cache.insert(key, new QList<LSPDocumentHighlight>(highlights));
+        for (const auto &hl : highlights) {
+            const Key other{.doc = key.doc, .revision = key.revision, .range = key.doc->wordRangeAt(hl.range.start())};
+            if (other.range == hl.range && !(other == key)) {
+                m_cache.insert(other, new QList<LSPDocumentHighlight>(highlights));
+            }
+        }
+        if (key == m_current) {
+            paint(highlights);
+        }
+    };
+    m_handle = server->documentHighlight(doc->url(), m_view->cursorPosition(), this, h);
+}
+
+void OccurrenceHighlighter::paint(const QList<LSPDocumentHighlight> &highlights)
+{
+    if (!m_view) {
+        return;
+    }
+
+    const auto theme = KTextEditor::Editor::instance()->theme();
+    KTextEditor::Attribute::Ptr readAttr(new KTextEditor::Attribute);
+    readAttr->setBackground(QColor::fromRgba(theme.editorColor(KSyntaxHighlighting::Theme::SearchHighlight)));
+    KTextEditor::Attribute::Ptr writeAttr(new KTextEditor::Attribute);
+    writeAttr->setBackground(QColor::fromRgba(theme.editorColor(KSyntaxHighlighting::Theme::ReplaceHighlight)));
+
+    auto doc = m_view->document();
+    size_t i = 0;
+    for (const auto &hl : highlights) {
+        if (!hl.range.isValid() || hl.range.isEmpty()) {
+            continue;
+        }
+        if (i == m_ranges.size()) {
+            m_ranges.emplace_back(doc->newMovingRange(hl.range));
+            m_ranges.back()->setZDepth(-90000.0);
+            m_ranges.back()->setAttributeOnlyForViews(true);
+        } else {
+            m_ranges[i]->setRange(hl.range);
+        }
+        m_ranges[i]->setAttribute(hl.kind == LSPDocumentHighlightKind::Write ? writeAttr : readAttr);
+        ++i;
+    }
+    // spare ones are kept out of the way
+    for (size_t j = i; j < m_paintedRanges; ++j) {
+        m_ranges[j]->setRange(KTextEditor::Range::invalid());
+    }
+    m_paintedRanges = i;
+}
+
+void OccurrenceHighlighter::clear()
+{
+    m_ranges.clear();
+    m_paintedRanges = 0;
+}
+
+#include "moc_occurrencehighlighter.cpp"
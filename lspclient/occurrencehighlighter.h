@@ -0,0 +1,76 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#pragma once
+
+#include "lspclientprotocol.h"
+#include "lspclientserver.h"
+
+#include <QCache>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+
+#include <KTextEditor/MovingRange>
+
+#include <memory>
+#include <vector>
+
+namespace KTextEditor
+{
+class View;
+class Document;
+}
+
+class LSPClientServerManager;
+
+/**
+ * Highlights the other occurrences of the symbol at the cursor once it rests,
+ * with writes set apart from reads.
+ *
+ * Replies are kept by document revision and identifier, so moving the cursor within
+ * an identifier or to one of its occurrences does not ask the server again.
+ */
+class OccurrenceHighlighter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit OccurrenceHighlighter(std::shared_ptr<LSPClientServerManager> serverManager, QObject *parent = nullptr);
+    ~OccurrenceHighlighter() override;
+
+    // view to follow, nullptr to stop
+    void setActiveView(KTextEditor::View *view);
+
+private:
+    struct Key {
+        KTextEditor::Document *doc = nullptr;
+        qint64 revision = -1;
+        KTextEditor::Range range;
+
+        bool operator==(const Key &other) const = default;
+    };
+    friend size_t qHash(const Key &key, size_t seed)
+    {
+        return qHashMulti(seed, key.doc, key.revision, key.range.start().line(), key.range.start().column(), key.range.end().column());
+    }
+
+    void cursorMoved();
+    void sendRequest();
+    void paint(const QList<LSPDocumentHighlight> &highlights);
+    // drops the moving ranges, which belong to the current document
+    Q_SLOT void clear();
+
+    std::shared_ptr<LSPClientServerManager> m_serverManager;
+    QPointer<KTextEditor::View> m_view;
+    QTimer m_requestTimer;
+    LSPClientServer::RequestHandle m_handle;
+    // identifier asked about or shown last
+    Key m_current;
+    QCache<Key, QList<LSPDocumentHighlight>> m_cache;
+
+    // painted ranges come first, the rest are kept for reuse
+    std::vector<std::unique_ptr<KTextEditor::MovingRange>> m_ranges;
+    size_t m_paintedRanges = 0;
+};
@@ -27,6 +27,7 @@ enum {
     VarParamAttr,
     ConstantAttr,
     KeywordAttr,
+    BuiltInAttr,
 };
 
 void SemanticTokensLegend::themeChange(KTextEditor::Editor *e)
@@ -140,11 +141,24 @@ void SemanticTokensLegend::themeChange(KTextEditor::Editor *e)
     fixedAttrs[TypeAttr]->setSelectedForeground(tps);
     fixedAttrs[TypeAttr]->setFontBold(theme.isBold(Style::DataType));
     fixedAttrs[TypeAttr]->setFontItalic(theme.isItalic(Style::DataType));
+
+    QColor bi = QColor::fromRgba(theme.textColor(Style::BuiltIn));
+    QColor bis = QColor::fromRgba(theme.selectedTextColor(Style::BuiltIn));
+    if (!fixedAttrs[BuiltInAttr]) {
+        fixedAttrs[BuiltInAttr] = new KTextEditor::Attribute();
+    }
+    fixedAttrs[BuiltInAttr]->setForeground(bi);
+    fixedAttrs[BuiltInAttr]->setSelectedForeground(bis);
+    fixedAttrs[BuiltInAttr]->setFontBold(theme.isBold(Style::BuiltIn));
+    fixedAttrs[BuiltInAttr]->setFontItalic(theme.isItalic(Style::BuiltIn));
+
+    // combined attributes are copies, rebuild them for the new theme
+    refresh();
 }
 
-void SemanticTokensLegend::initialize(const std::vector<QString> &types)
+void SemanticTokensLegend::initialize(const std::vector<QString> &types, const std::vector<QString> &modifiers)
 {
-    std::vector<TokenType> tokenTypes(types.size());
+    tokenTypes.resize(types.size());
     int i = 0;
     for (const auto &type : types) {
         if (type == QStringLiteral("type"))
@@ -197,44 +211,92 @@ void SemanticTokensLegend::initialize(const std::vector<QString> &types)
             tokenTypes[i] = TokenType::Unsupported;
         i++;
     }
-    refresh(tokenTypes);
+
+    // modifiers are sent as a bitset, bit n => modifiers[n]
+    modifierMasks = {};
+    for (size_t bit = 0; bit < modifiers.size() && bit < 32; ++bit) {
+        const auto &modifier = modifiers[bit];
+        if (modifier == QStringLiteral("readonly"))
+            modifierMasks[Readonly] |= 1u << bit;
+        else if (modifier == QStringLiteral("static"))
+            modifierMasks[Static] |= 1u << bit;
+        else if (modifier == QStringLiteral("deprecated"))
+            modifierMasks[Deprecated] |= 1u << bit;
+        else if (modifier == QStringLiteral("defaultLibrary"))
+            modifierMasks[DefaultLibrary] |= 1u << bit;
+    }
+
+    refresh();
 }
 
-void SemanticTokensLegend::refresh(const std::vector<TokenType> &tokenTypes)
+void SemanticTokensLegend::refresh()
 {
-    sharedAttrs.resize(tokenTypes.size());
+    attrTable.assign(tokenTypes.size() * ModifierCombinations, {});
     for (size_t i = 0; i < tokenTypes.size(); ++i) {
-        switch (tokenTypes.at(i)) {
-        case Type:
-        case Class:
-        case Interface:
-        case Struct:
-        case Enum:
-            sharedAttrs[i] = fixedAttrs[TypeAttr];
-            break;
-        case Namespace:
-            sharedAttrs[i] = fixedAttrs[KeywordAttr];
-            break;
-        case TypeParameter:
-        case Parameter:
-            sharedAttrs[i] = fixedAttrs[VarParamAttr];
-            break;
-        case Macro:
-            sharedAttrs[i] = fixedAttrs[MacroAttr];
-            break;
-        case Function:
-        case Method:
-            sharedAttrs[i] = fixedAttrs[FuncAttr];
-            break;
-        case EnumMember:
-            sharedAttrs[i] = fixedAttrs[ConstantAttr];
-            break;
-        case Comment:
-            sharedAttrs[i] = fixedAttrs[CommentAttr];
-            break;
-            // Only these for now
-        default:
-            sharedAttrs[i] = {};
+        const TokenType type = tokenTypes.at(i);
+        for (size_t mods = 0; mods < ModifierCombinations; ++mods) {
+            const bool readonly = mods & (1 << Readonly);
+            const bool defaultLibrary = mods & (1 << DefaultLibrary);
+
+            KTextEditor::Attribute::Ptr attr;
+            switch (type) {
+            case Type:
+            case Class:
+            case Interface:
+            case Struct:
+            case Enum:
+                attr = defaultLibrary ? fixedAttrs[BuiltInAttr] : fixedAttrs[TypeAttr];
+                break;
+            case Namespace:
+                attr = fixedAttrs[KeywordAttr];
+                break;
+            case TypeParameter:
+            case Parameter:
+                attr = fixedAttrs[VarParamAttr];
+                break;
+            case Macro:
+                attr = fixedAttrs[MacroAttr];
+                break;
+            case Function:
+            case Method:
+                attr = defaultLibrary ? fixedAttrs[BuiltInAttr] : fixedAttrs[FuncAttr];
+                break;
+            case EnumMember:
+                attr = fixedAttrs[ConstantAttr];
+                break;
+            case Variable:
+            case Property:
+                // e.g., Julia const globals and Base constants like `pi`
+                if (defaultLibrary) {
+                    attr = fixedAttrs[BuiltInAttr];
+                } else if (readonly) {
+                    attr = fixedAttrs[ConstantAttr];
+                }
+                break;
+            case Comment:
+                attr = fixedAttrs[CommentAttr];
+                break;
+                // Only these for now
+            default:
+                break;
+            }
+
+            const bool isStatic = mods & (1 << Static);
+            const bool deprecated = mods & (1 << Deprecated);
+            // modifiers only restyle a highlighted token, never start highlighting one
+            if (attr && (isStatic || deprecated)) {
+                // don't touch the shared attribute
+                KTextEditor::Attribute::Ptr combined(new KTextEditor::Attribute(*attr));
+                if (isStatic) {
+                    combined->setFontItalic(true);
+                }
+                if (deprecated) {
+                    combined->setFontStrikeOut(true);
+                }
+                attr = combined;
+            }
+
+            attrTable[i * ModifierCombinations + mods] = std::move(attr);
         }
     }
 }
@@ -9,6 +9,8 @@
 
 #include <KTextEditor/Attribute>
 
+#include <array>
+
 namespace KTextEditor
 {
 class Editor;
@@ -42,26 +44,54 @@ class SemanticTokensLegend : public QObject
         Namespace
     };
 
+    /**
+     * Token modifiers that change the attribute of a token. Every other
+     * modifier the server announces is ignored when looking up attributes.
+     */
+    enum TokenModifier {
+        Readonly = 0,
+        Static,
+        Deprecated,
+        DefaultLibrary,
+        ModifierCount
+    };
+
+    static constexpr size_t ModifierCombinations = size_t(1) << ModifierCount;
+
 public:
     explicit SemanticTokensLegend(QObject *parent = nullptr);
 
     /**
      * Called from LSP Server when capabilities are recieved
      */
-    void initialize(const std::vector<QString> &types);
+    void initialize(const std::vector<QString> &types, const std::vector<QString> &modifiers = {});
 
-    KTextEditor::Attribute::Ptr attributeForTokenType(size_t idx) const
+    /**
+     * Attribute for a token with type index @p type and modifier bitset @p modifiers
+     * as sent by the server. This is called for every visible token, so the attributes
+     * for all (type, modifiers) combinations are precomputed in refresh().
+     */
+    const KTextEditor::Attribute::Ptr &attributeForToken(uint32_t type, uint32_t modifiers) const
     {
-        if (idx >= sharedAttrs.size()) {
-            return {};
+        static const KTextEditor::Attribute::Ptr null;
+        if (type >= tokenTypes.size()) {
+            return null;
+        }
+        size_t mods = 0;
+        for (size_t i = 0; i < ModifierCount; ++i) {
+            mods |= size_t((modifiers & modifierMasks[i]) != 0) << i;
         }
-        return sharedAttrs.at(idx);
+        return attrTable[type * ModifierCombinations + mods];
     }
 
 private:
     Q_SLOT void themeChange(KTextEditor::Editor *e);
-    void refresh(const std::vector<TokenType> &m_tokenTypes);
+    void refresh();
 
-    std::vector<KTextEditor::Attribute::Ptr> sharedAttrs;
-    KTextEditor::Attribute::Ptr fixedAttrs[7];
+    std::vector<TokenType> tokenTypes;
+    // server modifier bit(s) for each TokenModifier, 0 if not announced
+    std::array<uint32_t, ModifierCount> modifierMasks = {};
+    // tokenTypes.size() * ModifierCombinations entries
+    std::vector<KTextEditor::Attribute::Ptr> attrTable;
+    KTextEditor::Attribute::Ptr fixedAttrs[8];
 };
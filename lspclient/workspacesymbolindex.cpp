@@ -0,0 +1,660 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: MIT
+*/
+
+#include "workspacesymbolindex.h"
+#include "fuzzyscorer.h"
+#include "lspclient_debug.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+#include <span>
+#include <utility>
+
+static constexpr quint32 IndexMagic = 0x4a4c5358;
+// bump when the layout below changes
+static constexpr quint32 IndexVersion = 1;
+// do not wander off into huge trees, e.g. a home directory
+static constexpr int MaxIndexedFiles = 20000;
+
+/**
+ * On disk layout, all in native byte order and suitably aligned for mapping:
+ * header, files, symbols, trigrams (sorted), postings (sorted per trigram), strings (UTF-16).
+ */
+struct IndexHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 fileCount;
+    quint32 symbolCount;
+    quint32 trigramCount;
+    quint32 postingCount;
+    quint32 stringSize;
+    quint32 reserved;
+};
+
+struct IndexFileRecord {
+    quint32 path;
+    quint32 pathLength;
+    qint64 mtime;
+    quint32 firstSymbol;
+    quint32 symbolCount;
+};
+
+struct IndexSymbolRecord {
+    quint32 name;
+    quint32 nameLength;
+    quint32 file;
+    quint32 line;
+    quint32 column;
+    quint32 kind;
+};
+
+struct IndexTrigramRecord {
+    quint64 trigram;
+    quint32 firstPosting;
+    quint32 postingCount;
+};
+
+static quint64 trigram(const QChar *c)
+{
+    return (quint64(c[0].unicode()) << 32) | (quint64(c[1].unicode()) << 16) | c[2].unicode();
+}
+
+// distinct trigrams of the case folded @p text
+static std::vector<quint64> trigrams(const QString &text)
+{
+    const auto folded = text.toCaseFolded();
+    std::vector<quint64> ret;
+    for (qsizetype i = 0; i + 2 < folded.size(); ++i) {
+        ret.push_back(trigram(folded.constData() + i));
+    }
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+    return ret;
+}
+
+// a mapped index file, immutable once loaded and so safe to share with worker threads
+class IndexSnapshot
+{
+public:
+    static std::shared_ptr<const IndexSnapshot> open(const QString &fileName)
+    {
+        auto snapshot = std::make_shared<IndexSnapshot>(fileName);
+        if (!snapshot->load()) {
+            return nullptr;
+        }
+        return snapshot;
+    }
+
+    explicit IndexSnapshot(const QString &fileName)
+        : m_file(fileName)
+    {
+    }
+
+    QStringView string(quint32 offset, quint32 length) const
+    {
+        return QStringView(strings + offset, length);
+    }
+
+    QString path(const IndexFileRecord &file) const
+    {
+        return string(file.path, file.pathLength).toString();
+    }
+
+    std::span<const quint32> postings(quint64 trigram) const
+    {
+        const auto end = trigrams + header->trigramCount;
+        auto it = std::lower_bound(trigrams, end, trigram, [](const IndexTrigramRecord &r, quint64 t) {
+            return r.trigram < t;
+        });
+        if (it == end || it->trigram != trigram) {
+            return {};
+        }
+        return {postingList + it->firstPosting, it->postingCount};
+    }
+
+    const IndexHeader *header = nullptr;
+    const IndexFileRecord *files = nullptr;
+    const IndexSymbolRecord *symbols = nullptr;
+    const IndexTrigramRecord *trigrams = nullptr;
+    const quint32 *postingList = nullptr;
+    const QChar *strings = nullptr;
+
+private:
+    bool load()
+    {
+        if (!m_file.open(QIODevice::ReadOnly) || m_file.size() < qint64(sizeof(IndexHeader))) {
+            return false;
+        }
+        const uchar *data = m_file.map(0, m_file.size());
+        if (!data) {
+            return false;
+        }
+        header = reinterpret_cast<const IndexHeader *>(data);
+        if (header->magic != IndexMagic || header->version != IndexVersion) {
+            return false;
+        }
+        const qint64 size = sizeof(IndexHeader) + qint64(header->fileCount) * sizeof(IndexFileRecord) + qint64(header->symbolCount) * sizeof(IndexSymbolRecord)
+            + qint64(header->trigramCount) * sizeof(IndexTrigramRecord) + qint64(header->postingCount) * sizeof(quint32) + qint64(header->stringSize) * sizeof(QChar);
+        if (size != m_file.size()) {
+            return false;
+        }
+        files = reinterpret_cast<const IndexFileRecord *>(header + 1);
+        symbols = reinterpret_cast<const IndexSymbolRecord *>(files + header->fileCount);
+        trigrams = reinterpret_cast<const IndexTrigramRecord *>(symbols + header->symbolCount);
+        postingList = reinterpret_cast<const quint32 *>(trigrams + header->trigramCount);
+        strings = reinterpret_cast<const QChar *>(postingList + header->postingCount);
+        return validate();
+    }
+
+    // a damaged file should not take us down
+    bool validate() const
+    {
+        const auto inStrings = [this](quint32 offset, quint32 length) {
+            return quint64(offset) + length <= header->stringSize;
+        };
+        for (quint32 i = 0; i < header->fileCount; ++i) {
+            const auto &f = files[i];
+            if (!inStrings(f.path, f.pathLength) || quint64(f.firstSymbol) + f.symbolCount > header->symbolCount) {
+                return false;
+            }
+        }
+        for (quint32 i = 0; i < header->symbolCount; ++i) {
+            const auto &s = symbols[i];
+            if (!inStrings(s.name, s.nameLength) || s.file >= header->fileCount) {
+                return false;
+            }
+        }
+        for (quint32 i = 0; i < header->trigramCount; ++i) {
+            const auto &t = trigrams[i];
+            if (quint64(t.firstPosting) + t.postingCount > header->postingCount) {
+                return false;
+            }
+        }
+        return std::all_of(postingList, postingList + header->postingCount, [this](quint32 p) {
+            return p < header->symbolCount;
+        });
+    }
+
+    QFile m_file;
+};
+
+// files of @p base that did not change, followed by the @p changed ones
+static bool writeSnapshot(const QString &fileName, const std::shared_ptr<const IndexSnapshot> &base, const WorkspaceSymbolIndex::FileMap &changed)
+{
+    std::vector<IndexFileRecord> files;
+    std::vector<IndexSymbolRecord> symbols;
+    QHash<quint64, std::vector<quint32>> postings;
+    QString strings;
+
+    auto addString = [&strings](QStringView s) {
+        const quint32 offset = strings.size();
+        strings.append(s);
+        return offset;
+    };
+    auto addSymbol = [&](QStringView name, quint32 kind, quint32 line, quint32 column) {
+        const quint32 index = symbols.size();
+        symbols.push_back({.name = addString(name), .nameLength = quint32(name.size()), .file = quint32(files.size()), .line = line, .column = column, .kind = kind});
+        for (auto t : trigrams(name.toString())) {
+            postings[t].push_back(index);
+        }
+    };
+
+    if (base) {
+        for (quint32 i = 0; i < base->header->fileCount; ++i) {
+            const auto &file = base->files[i];
+            const auto path = base->path(file);
+            if (changed.contains(path)) {
+                continue;
+            }
+            IndexFileRecord record{.path = addString(path), .pathLength = file.pathLength, .mtime = file.mtime, .firstSymbol = quint32(symbols.size()), .symbolCount = 0};
+            for (quint32 s = file.firstSymbol; s < file.firstSymbol + file.symbolCount; ++s) {
+                const auto &symbol = base->symbols[s];
+                addSymbol(base->string(symbol.name, symbol.nameLength), symbol.kind, symbol.line, symbol.column);
+            }
+            record.symbolCount = symbols.size() - record.firstSymbol;
+            files.push_back(record);
+        }
+    }
+    for (auto it = changed.cbegin(); it != changed.cend(); ++it) {
+        if (it->removed) {
+            continue;
+        }
+        IndexFileRecord record{.path = addString(it.key()), .pathLength = quint32(it.key().size()), .mtime = it->mtime, .firstSymbol = quint32(symbols.size()), .symbolCount = 0};
+        for (const auto &symbol : it->symbols) {
+            addSymbol(symbol.name, quint32(symbol.kind), symbol.line, symbol.column);
+        }
+        record.symbolCount = symbols.size() - record.firstSymbol;
+        files.push_back(record);
+    }
+
+    std::vector<IndexTrigramRecord> trigramRecords;
+    trigramRecords.reserve(postings.size());
+    for (auto it = postings.cbegin(); it != postings.cend(); ++it) {
+        trigramRecords.push_back({.trigram = it.key(), .firstPosting = 0, .postingCount = quint32(it->size())});
+    }
+    std::sort(trigramRecords.begin(), trigramRecords.end(), [](const IndexTrigramRecord &l, const IndexTrigramRecord &r) {
+        return l.trigram < r.trigram;
+    });
+    std::vector<quint32> postingList;
+    for (auto &record : trigramRecords) {
+        record.firstPosting = postingList.size();
+        const auto &list = postings[record.trigram];
+        postingList.insert(postingList.end(), list.begin(), list.end());
+    }
+
+    const IndexHeader header{.magic = IndexMagic,
+                             .version = IndexVersion,
+                             .fileCount = quint32(files.size()),
+                             .symbolCount = quint32(symbols.size()),
+                             .trigramCount = quint32(trigramRecords.size()),
+                             .postingCount = quint32(postingList.size()),
+                             .stringSize = quint32(strings.size()),
+                             .reserved = 0};
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    auto write = [&file](const void *data, qint64 size) {
+        file.write(static_cast<const char *>(data), size);
+    };
+    write(&header, sizeof(header));
+    write(files.data(), files.size() * sizeof(IndexFileRecord));
+    write(symbols.data(), symbols.size() * sizeof(IndexSymbolRecord));
+    write(trigramRecords.data(), trigramRecords.size() * sizeof(IndexTrigramRecord));
+    write(postingList.data(), postingList.size() * sizeof(quint32));
+    write(strings.constData(), strings.size() * sizeof(QChar));
+    return file.commit();
+}
+
+static qint64 modificationTime(const QFileInfo &info)
+{
+    return info.lastModified().toMSecsSinceEpoch();
+}
+
+static WorkspaceSymbolIndex::FileSymbols parseFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {.removed = true};
+    }
+    return {.mtime = modificationTime(QFileInfo(file)), .symbols = WorkspaceSymbolIndex::parse(QString::fromUtf8(file.readAll()))};
+}
+
+struct ScanResult {
+    WorkspaceSymbolIndex::FileMap files;
+    QSet<QString> dirs;
+};
+
+// parse whatever is new or changed compared to what is indexed already
+static ScanResult scanRoot(const QString &root,
+                           const QStringList &nameFilters,
+                           const std::shared_ptr<const IndexSnapshot> &snapshot,
+                           const WorkspaceSymbolIndex::FileMap &changed)
+{
+    QHash<QString, qint64> indexed;
+    if (snapshot) {
+        for (quint32 i = 0; i < snapshot->header->fileCount; ++i) {
+            indexed.insert(snapshot->path(snapshot->files[i]), snapshot->files[i].mtime);
+        }
+    }
+    for (auto it = changed.cbegin(); it != changed.cend(); ++it) {
+        if (it->removed) {
+            indexed.remove(it.key());
+        } else {
+            indexed.insert(it.key(), it->mtime);
+        }
+    }
+
+    ScanResult ret;
+    QSet<QString> seen;
+    // hidden directories and symlinks are skipped, directories are kept to tell what a deleted path was
+    QDirIterator it(root, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext() && seen.size() < MaxIndexedFiles) {
+        const auto path = it.next();
+        const auto info = it.fileInfo();
+        if (info.isDir()) {
+            ret.dirs.insert(path);
+            continue;
+        }
+        if (!QDir::match(nameFilters, info.fileName())) {
+            continue;
+        }
+        seen.insert(path);
+        if (indexed.value(path, -1) != modificationTime(info)) {
+            ret.files.insert(path, parseFile(path));
+        }
+    }
+    // if we stopped early there is no telling what is gone
+    if (!it.hasNext()) {
+        for (auto i = indexed.cbegin(); i != indexed.cend(); ++i) {
+            if (!seen.contains(i.key())) {
+                ret.files.insert(i.key(), {.removed = true});
+            }
+        }
+    }
+    return ret;
+}
+
+WorkspaceSymbolIndex::WorkspaceSymbolIndex(const QString &root, const QStringList &nameFilters, QObject *parent)
+    : QObject(parent)
+    , m_root(root)
+    , m_nameFilters(nameFilters)
+{
+    const auto hash = QCryptographicHash::hash(root.toUtf8(), QCryptographicHash::Sha1).toHex();
+    m_indexFile = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/lspclient/symbols/%1.idx").arg(QString::fromLatin1(hash));
+    m_snapshot = IndexSnapshot::open(m_indexFile);
+
+    // batch up changes, e.g. a checkout touches many files at once
+    m_parseTimer.setSingleShot(true);
+    m_parseTimer.setInterval(500);
+    connect(&m_parseTimer, &QTimer::timeout, this, &WorkspaceSymbolIndex::parseChanged);
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(5000);
+    connect(&m_saveTimer, &QTimer::timeout, this, &WorkspaceSymbolIndex::save);
+
+    m_watch.addDir(root, KDirWatch::WatchFiles | KDirWatch::WatchSubDirs);
+    connect(&m_watch, &KDirWatch::dirty, this, &WorkspaceSymbolIndex::fileChanged);
+    connect(&m_watch, &KDirWatch::created, this, &WorkspaceSymbolIndex::entryCreated);
+    connect(&m_watch, &KDirWatch::deleted, this, &WorkspaceSymbolIndex::entryDeleted);
+
+    scan();
+}
+
+// whatever is not written yet is picked up by the scan next time
+WorkspaceSymbolIndex::~WorkspaceSymbolIndex() = default;
+
+void WorkspaceSymbolIndex::scan()
+{
+    m_rescan = false;
+    QtConcurrent::run(scanRoot, m_root, m_nameFilters, m_snapshot, m_changed).then(this, [this](const ScanResult &result) {
+        m_dirs = result.dirs;
+        merge(result.files);
+    });
+}
+
+// below a hidden directory, e.g. .git, which the scan skips as well
+bool WorkspaceSymbolIndex::isHidden(const QString &path) const
+{
+    const auto parts = QStringView(path).mid(m_root.size()).split(QLatin1Char('/'), Qt::SkipEmptyParts);
+    return std::any_of(parts.begin(), parts.end(), [](QStringView part) {
+        return part.startsWith(QLatin1Char('.'));
+    });
+}
+
+void WorkspaceSymbolIndex::fileChanged(const QString &path)
+{
+    // directories are dirty whenever an entry changes, the entries tell themselves
+    if (!QDir::match(m_nameFilters, QFileInfo(path).fileName()) || isHidden(path)) {
+        return;
+    }
+    m_dirty.insert(path);
+    m_parseTimer.start();
+}
+
+void WorkspaceSymbolIndex::entryCreated(const QString &path)
+{
+    if (isHidden(path)) {
+        return;
+    }
+    if (QFileInfo(path).isDir()) {
+        // new or renamed directory, its files are unknown
+        m_rescan = true;
+        m_parseTimer.start();
+    } else {
+        fileChanged(path);
+    }
+}
+
+void WorkspaceSymbolIndex::entryDeleted(const QString &path)
+{
+    // it is gone, so only what the scan saw tells whether it was a directory
+    if (m_dirs.contains(path)) {
+        m_rescan = true;
+        m_parseTimer.start();
+    } else {
+        fileChanged(path);
+    }
+}
+
+void WorkspaceSymbolIndex::parseChanged()
+{
+    Q_EMIT filesChanged();
+    if (m_rescan) {
+        m_dirty.clear();
+        scan();
+        return;
+    }
+    auto parse = [](const QSet<QString> &paths) {
+        FileMap files;
+        for (const auto &path : paths) {
+            files.insert(path, parseFile(path));
+        }
+        return files;
+    };
+    QtConcurrent::run(parse, std::exchange(m_dirty, {})).then(this, [this](const FileMap &files) {
+        merge(files);
+    });
+}
+
+void WorkspaceSymbolIndex::merge(const FileMap &files)
+{
+    if (files.isEmpty()) {
+        return;
+    }
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        // the server knows better, unless the file changed since
+        auto known = m_changed.constFind(it.key());
+        if (known != m_changed.cend() && known->fromServer && !it->fromServer && !it->removed && known->mtime >= it->mtime) {
+            continue;
+        }
+        auto file = it.value();
+        file.generation = ++m_generation;
+        m_changed.insert(it.key(), std::move(file));
+    }
+    m_saveTimer.start();
+}
+
+void WorkspaceSymbolIndex::save()
+{
+    // one at a time, the next one goes when this one is done
+    if (m_saving) {
+        return;
+    }
+    m_saving = true;
+    QtConcurrent::run(writeSnapshot, m_indexFile, m_snapshot, m_changed).then(this, [this, written = m_changed](bool ok) {
+        m_saving = false;
+        auto snapshot = ok ? IndexSnapshot::open(m_indexFile) : nullptr;
+        if (!snapshot) {
+            qCWarning(LSPCLIENT) << "failed to write symbol index" << m_indexFile;
+            return;
+        }
+        m_snapshot = snapshot;
+        // keep what changed while writing
+        for (auto it = written.cbegin(); it != written.cend(); ++it) {
+            auto current = m_changed.constFind(it.key());
+            if (current != m_changed.cend() && current->generation == it->generation) {
+                m_changed.erase(current);
+            }
+        }
+        if (!m_changed.isEmpty()) {
+            m_saveTimer.start();
+        }
+    });
+}
+
+void WorkspaceSymbolIndex::setSymbols(const QString &path, const LSPSymbolTable &symbols)
+{
+    FileSymbols file{.mtime = modificationTime(QFileInfo(path)), .fromServer = true};
+    for (const auto &symbol : symbols.symbols) {
+        // skip the locals of functions
+        bool local = false;
+        for (int parent = symbol.parent; parent >= 0 && !local; parent = symbols.symbols[parent].parent) {
+            const auto kind = symbols.symbols[parent].kind;
+            local = kind == LSPSymbolKind::Function || kind == LSPSymbolKind::Method || kind == LSPSymbolKind::Constructor;
+        }
+        if (!local) {
+            file.symbols.push_back({.name = symbols.name(symbol), .kind = symbol.kind, .line = symbol.range.start().line(), .column = symbol.range.start().column()});
+        }
+    }
+    merge({{path, file}});
+}
+
+LSPSymbolTable WorkspaceSymbolIndex::find(const QString &pattern, int limit) const
+{
+    if (pattern.size() < MinPatternLength) {
+        return {};
+    }
+
+    struct Hit {
+        QString path;
+        LSPSymbolKind kind;
+        int line;
+        int column;
+    };
+    std::vector<Hit> hits;
+    QStringList names;
+
+    if (const auto snapshot = m_snapshot.get()) {
+        const auto &header = *snapshot->header;
+        // files replaced since, looked up once per file
+        std::vector<qint8> replaced(header.fileCount, -1);
+        auto consider = [&](quint32 index) {
+            const auto &symbol = snapshot->symbols[index];
+            const auto name = snapshot->string(symbol.name, symbol.nameLength);
+            if (!name.contains(pattern, Qt::CaseInsensitive)) {
+                return;
+            }
+            const auto &file = snapshot->files[symbol.file];
+            auto &r = replaced[symbol.file];
+            if (r < 0) {
+                r = m_changed.contains(snapshot->path(file));
+            }
+            if (!r) {
+                hits.push_back({snapshot->path(file), LSPSymbolKind(symbol.kind), int(symbol.line), int(symbol.column)});
+                names.push_back(name.toString());
+            }
+        };
+
+        // symbols having all trigrams of the pattern, rarest trigram first
+        std::vector<std::span<const quint32>> lists;
+        for (auto t : trigrams(pattern)) {
+            lists.push_back(snapshot->postings(t));
+        }
+        std::sort(lists.begin(), lists.end(), [](const auto &l, const auto &r) {
+            return l.size() < r.size();
+        });
+        std::vector<quint32> candidates(lists.front().begin(), lists.front().end());
+        for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+            std::vector<quint32> common;
+            std::set_intersection(candidates.begin(), candidates.end(), lists[i].begin(), lists[i].end(), std::back_inserter(common));
+            candidates = std::move(common);
+        }
+        for (auto index : candidates) {
+            consider(index);
+        }
+    }
+
+    for (auto it = m_changed.cbegin(); it != m_changed.cend(); ++it) {
+        for (const auto &symbol : it->symbols) {
+            if (symbol.name.contains(pattern, Qt::CaseInsensitive)) {
+                hits.push_back({it.key(), symbol.kind, symbol.line, symbol.column});
+                names.push_back(symbol.name);
+            }
+        }
+    }
+
+    LSPSymbolTable table;
+    table.strings.push_back(QString());
+    table.urls.push_back(QUrl());
+    QHash<QString, int> urls;
+    for (const auto &m : FuzzyScorer::topMatches(pattern, names, limit)) {
+        const auto &hit = hits[m.index];
+        auto url = urls.constFind(hit.path);
+        if (url == urls.cend()) {
+            table.urls.push_back(QUrl::fromLocalFile(hit.path));
+            url = urls.insert(hit.path, table.urls.size() - 1);
+        }
+        table.strings.push_back(names[m.index]);
+        const LSPPosition pos(hit.line, hit.column);
+        table.symbols.push_back({.range = {pos, pos}, .name = int(table.strings.size() - 1), .url = url.value(), .kind = hit.kind});
+    }
+    table.rootCount = table.symbols.size();
+    return table;
+}
+
+std::vector<WorkspaceSymbolIndex::Symbol> WorkspaceSymbolIndex::parse(const QString &text)
+{
+    static const QString name = QStringLiteral(R"(([\p{L}_][\p{L}\p{N}_!]*))");
+    // explicit definitions, possibly nested or behind macros such as @inline
+    static const QRegularExpression definition(
+        QStringLiteral(R"(^\s*(?:@\w+\s+)*(?:(module|baremodule)|(?:mutable\s+)?(struct)|(abstract)\s+type|(primitive)\s+type|(function)|(macro))\s+(?:[\w.]+\.)?)")
+            + name,
+        QRegularExpression::UseUnicodePropertiesOption);
+    // only at top-level to leave out locals: f(x) = ..., const c = ...
+    static const QRegularExpression shortFunction(QStringLiteral(R"(^(?:[\w.]+\.)?)") + name + QStringLiteral(R"((?:\{[^}]*\})?\(.*\)\s*(?:where\b.*)?=(?![=>]))"),
+                                                  QRegularExpression::UseUnicodePropertiesOption);
+    static const QRegularExpression constant(QStringLiteral(R"(^const\s+)") + name, QRegularExpression::UseUnicodePropertiesOption);
+
+    std::vector<Symbol> symbols;
+    bool inComment = false;
+    bool inString = false;
+    const auto lines = text.split(QLatin1Char('\n'));
+    for (int line = 0; line < lines.size(); ++line) {
+        const auto &l = lines[line];
+        // skip block comments and docstrings
+        if (inComment) {
+            inComment = !l.contains(QLatin1String("=#"));
+            continue;
+        }
+        const bool oddQuotes = l.count(QLatin1String("\"\"\"")) % 2;
+        if (inString) {
+            inString = !oddQuotes;
+            continue;
+        }
+        if (oddQuotes) {
+            inString = true;
+            continue;
+        }
+        if (l.trimmed().startsWith(QLatin1String("#="))) {
+            inComment = !l.contains(QLatin1String("=#"));
+            continue;
+        }
+
+        if (const auto def = definition.match(l); def.hasMatch()) {
+            LSPSymbolKind kind = LSPSymbolKind::Function;
+            QString symbolName = def.captured(7);
+            if (def.hasCaptured(1)) {
+                kind = LSPSymbolKind::Module;
+            } else if (def.hasCaptured(2) || def.hasCaptured(4)) {
+                kind = LSPSymbolKind::Struct;
+            } else if (def.hasCaptured(3)) {
+                kind = LSPSymbolKind::Interface;
+            } else if (def.hasCaptured(6)) {
+                symbolName.prepend(QLatin1Char('@'));
+            }
+            symbols.push_back({.name = symbolName, .kind = kind, .line = line, .column = int(def.capturedStart(7))});
+        } else if (const auto fun = shortFunction.match(l); fun.hasMatch()) {
+            symbols.push_back({.name = fun.captured(1), .kind = LSPSymbolKind::Function, .line = line, .column = int(fun.capturedStart(1))});
+        } else if (const auto con = constant.match(l); con.hasMatch()) {
+            symbols.push_back({.name = con.captured(1), .kind = LSPSymbolKind::Constant, .line = line, .column = int(con.capturedStart(1))});
+        }
+    }
+    return symbols;
+}
+
+#include "moc_workspacesymbolindex.cpp"
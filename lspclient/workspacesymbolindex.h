@@ -0,0 +1,108 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include "lspclientprotocol.h"
+
+#include <KDirWatch>
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+
+#include <memory>
+#include <vector>
+
+class IndexSnapshot;
+
+/**
+ * Symbols of the source files below a project root, so goto-symbol can answer
+ * without waiting for the server, which may be busy indexing or not running at all.
+ *
+ * Files are parsed in the background and the result is kept on disk, memory mapped,
+ * along with a trigram index of the symbol names. Files changed since are kept in
+ * memory until they are written out again. The root is watched for changes.
+ */
+class WorkspaceSymbolIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Symbol {
+        QString name;
+        LSPSymbolKind kind = LSPSymbolKind::Function;
+        int line = 0;
+        int column = 0;
+    };
+
+    struct FileSymbols {
+        qint64 mtime = 0;
+        // symbols reported by a server take precedence over parsed ones
+        bool fromServer = false;
+        bool removed = false;
+        // to tell whether it changed again while being written out
+        quint64 generation = 0;
+        std::vector<Symbol> symbols;
+    };
+    // by local file path
+    using FileMap = QHash<QString, FileSymbols>;
+
+    WorkspaceSymbolIndex(const QString &root, const QStringList &nameFilters, QObject *parent = nullptr);
+    ~WorkspaceSymbolIndex() override;
+
+    const QString &root() const
+    {
+        return m_root;
+    }
+
+    // shorter patterns have no trigram to look up and would scan every symbol
+    static constexpr int MinPatternLength = 3;
+
+    /**
+     * Symbols whose name contains @p pattern (case insensitive), ranked by fuzzy score.
+     * @return at most @p limit symbols, all top-level, best first, none if @p pattern is shorter than MinPatternLength
+     */
+    LSPSymbolTable find(const QString &pattern, int limit) const;
+
+    // symbols of @p path as reported by a server
+    void setSymbols(const QString &path, const LSPSymbolTable &symbols);
+
+    // line based scan for Julia definitions, used for files no server has told us about
+    static std::vector<Symbol> parse(const QString &text);
+
+Q_SIGNALS:
+    // files below the root changed on disk
+    void filesChanged();
+
+private:
+    void scan();
+    bool isHidden(const QString &path) const;
+    void fileChanged(const QString &path);
+    void entryCreated(const QString &path);
+    void entryDeleted(const QString &path);
+    void parseChanged();
+    void merge(const FileMap &files);
+    void save();
+
+    QString m_root;
+    QStringList m_nameFilters;
+    QString m_indexFile;
+    std::shared_ptr<const IndexSnapshot> m_snapshot;
+    // files changed since the snapshot was written
+    FileMap m_changed;
+    quint64 m_generation = 0;
+
+    KDirWatch m_watch;
+    // directories below the root as of the last scan
+    QSet<QString> m_dirs;
+    QSet<QString> m_dirty;
+    bool m_rescan = false;
+    QTimer m_parseTimer;
+    QTimer m_saveTimer;
+    bool m_saving = false;
+};